@@ -0,0 +1,49 @@
+#version 450
+#extension GL_EXT_nonuniform_qualifier : require
+layout(location = 0) out vec4 outColor;
+layout(location = 0) in vec3 fragColor;
+layout(location = 1) in vec2 texCoord;
+layout(location = 2) flat in uint materialIndex;
+
+// same layout as Material.hpp, texture indices are slots of textures[]. -1 : none
+struct Material {
+	int diffTexIdx;
+	int specTexIdx;
+	int bumpMapIdx;
+	int normalMapIdx;
+	int emissionMapIdx;
+	int opacityMapIdx;
+	int roughnessMapIdx;
+	int metalnessMapIdx;
+	int ambOcclMapIdx;
+};
+layout(std430, set = 1, binding = 0) readonly buffer Materials {
+	Material materials[];
+};
+layout(set = 1, binding = 2) uniform sampler2D textures[];
+
+// MaterialFeature bits of Material.hpp. a variant pipeline specializes it and the unused paths compile away,
+// the generic pipeline keeps MATERIAL_FEATURES_DYNAMIC and decides per fragment
+layout(constant_id = 0) const uint MATERIAL_FEATURES = 0x80000000u;
+const uint MATERIAL_FEATURE_DIFFUSE_MAP = 1u;
+const uint MATERIAL_FEATURE_ALPHA_TEST = 2u;
+const uint MATERIAL_FEATURE_EMISSION_MAP = 4u;
+const uint MATERIAL_FEATURES_DYNAMIC = 0x80000000u;
+bool HasFeature(uint feature, int texIdx) {
+	if ((MATERIAL_FEATURES & MATERIAL_FEATURES_DYNAMIC) != 0u) return texIdx >= 0;
+	return (MATERIAL_FEATURES & feature) != 0u;
+}
+
+void main(){
+	Material material = materials[materialIndex];
+	if (HasFeature(MATERIAL_FEATURE_ALPHA_TEST, material.opacityMapIdx)) {
+		if (texture(textures[nonuniformEXT(material.opacityMapIdx)], texCoord).r < 0.5f) discard;
+	}
+	outColor = vec4(1.0f);
+	if (HasFeature(MATERIAL_FEATURE_DIFFUSE_MAP, material.diffTexIdx)) {
+		outColor = texture(textures[nonuniformEXT(material.diffTexIdx)], texCoord);
+	}
+	if (HasFeature(MATERIAL_FEATURE_EMISSION_MAP, material.emissionMapIdx)) {
+		outColor.rgb += texture(textures[nonuniformEXT(material.emissionMapIdx)], texCoord).rgb;
+	}
+}
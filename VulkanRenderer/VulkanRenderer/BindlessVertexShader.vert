@@ -0,0 +1,36 @@
+#version 450
+layout(location = 0) out vec3 fragColor;
+layout(location = 1) out vec2 texCoord;
+layout(location = 2) flat out uint materialIndex;
+layout(binding = 0) uniform UniformBufferObject{
+	mat4 model;
+	mat4 view;
+	mat4 proj;
+} ubo;
+layout(push_constant) uniform DrawPushConstants{
+	mat4 model;
+	uint materialIndex;
+} draw;
+// Utils::DrawData
+struct DrawData {
+	mat4 transform;
+	uint materialIndex;
+};
+layout(std430, set = 1, binding = 1) readonly buffer Draws { DrawData draws[]; };
+
+layout(location = 0) in vec3 inPosition;
+layout(location = 1) in vec3 inNormal;
+layout(location = 2) in vec2 inTexCoord;
+void main(){
+	// DRAW_FROM_INSTANCE : indirect draw, firstInstance is the slot of its node transform and material
+	mat4 world = draw.model;
+	materialIndex = draw.materialIndex;
+	if (draw.materialIndex == 0xFFFFFFFFu) {
+		DrawData data = draws[gl_InstanceIndex];
+		world = draw.model * data.transform;
+		materialIndex = data.materialIndex;
+	}
+	gl_Position = ubo.proj * ubo.view * world * vec4(inPosition,1.0f);
+	fragColor = vec3(inNormal);
+	texCoord = inTexCoord;
+}
@@ -3,6 +3,11 @@ layout(location = 0) out vec4 outColor;
 layout(location = 0) in vec3 fragColor;
 layout(location = 1) in vec2 texCoord;
 layout(binding = 1) uniform sampler2D diff; 
+// MaterialFeature bits of Material.hpp, only the diffuse map is bound without bindless materials
+layout(constant_id = 0) const uint MATERIAL_FEATURES = 0x80000000u;
+const uint MATERIAL_FEATURE_DIFFUSE_MAP = 1u;
+const uint MATERIAL_FEATURES_DYNAMIC = 0x80000000u;
 void main(){
-	outColor = texture(diff,texCoord);
+	if ((MATERIAL_FEATURES & (MATERIAL_FEATURE_DIFFUSE_MAP | MATERIAL_FEATURES_DYNAMIC)) != 0u) outColor = texture(diff,texCoord);
+	else outColor = vec4(1.0f);
 }
\ No newline at end of file
@@ -6,12 +6,16 @@ layout(binding = 0) uniform UniformBufferObject{
 	mat4 view;
 	mat4 proj;
 } ubo;
+layout(push_constant) uniform DrawPushConstants{
+	mat4 model;
+	uint materialIndex;
+} draw;
 
 layout(location = 0) in vec3 inPosition;
 layout(location = 1) in vec3 inNormal;
 layout(location = 2) in vec2 inTexCoord;
 void main(){
-	gl_Position = ubo.proj * ubo.view * ubo.model * vec4(inPosition,1.0f);
+	gl_Position = ubo.proj * ubo.view * draw.model * vec4(inPosition,1.0f);
 	fragColor = vec3(inNormal);
 	texCoord = inTexCoord;
 }
\ No newline at end of file
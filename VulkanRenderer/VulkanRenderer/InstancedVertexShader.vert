@@ -0,0 +1,27 @@
+#version 450
+layout(location = 0) out vec3 fragColor;
+layout(location = 1) out vec2 texCoord;
+layout(location = 2) flat out uint materialIndex;
+layout(binding = 0) uniform UniformBufferObject{
+	mat4 model;
+	mat4 view;
+	mat4 proj;
+} ubo;
+layout(push_constant) uniform DrawPushConstants{
+	mat4 model;
+	uint materialIndex;
+} draw;
+
+layout(location = 0) in vec3 inPosition;
+layout(location = 1) in vec3 inNormal;
+layout(location = 2) in vec2 inTexCoord;
+// InstanceData, binding 1 advances once per instance
+layout(location = 3) in mat4 instanceTransform;
+layout(location = 7) in uint instanceMaterial;
+void main(){
+	gl_Position = ubo.proj * ubo.view * instanceTransform * draw.model * vec4(inPosition,1.0f);
+	fragColor = vec3(inNormal);
+	texCoord = inTexCoord;
+	// NO_MATERIAL_OVERRIDE : keep the mesh's own material
+	materialIndex = instanceMaterial == 0xFFFFFFFFu ? draw.materialIndex : instanceMaterial;
+}
@@ -1,6 +1,16 @@
 #pragma once
 #ifndef MATERIAL_HPP
 #define MATERIAL_HPP
+#include <cstdint>
+
+// bits of the MATERIAL_FEATURES specialization constant(constant_id 0) of the fragment shaders
+enum MaterialFeature : uint32_t {
+	MATERIAL_FEATURE_DIFFUSE_MAP = 1u << 0,
+	MATERIAL_FEATURE_ALPHA_TEST = 1u << 1, // opacity map, fragments below 0.5 are discarded
+	MATERIAL_FEATURE_EMISSION_MAP = 1u << 2,
+	MATERIAL_FEATURES_DYNAMIC = 1u << 31, // generic pipeline, every feature is looked up per fragment
+};
+
 struct  Material{
 	int diffTexIdx = -1;
 	int specTexIdx = -1;
@@ -11,5 +21,13 @@ struct  Material{
 	int roughnessMapIdx = -1;
 	int metalnessMapIdx = -1;
 	int ambOcclMapIdx = -1;
+	// MaterialFeature bits of the textures it has, the key of its pipeline variant
+	uint32_t GetFeatures() const {
+		uint32_t features = 0;
+		if (diffTexIdx >= 0) features |= MATERIAL_FEATURE_DIFFUSE_MAP;
+		if (opacityMapIdx >= 0) features |= MATERIAL_FEATURE_ALPHA_TEST;
+		if (emissionMapIdx >= 0) features |= MATERIAL_FEATURE_EMISSION_MAP;
+		return features;
+	}
 };
 #endif // !MATERIAL_HPP
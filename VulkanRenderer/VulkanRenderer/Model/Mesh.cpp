@@ -1,8 +1,20 @@
 #include "Mesh.hpp"
 
 void Mesh::Draw(VkCommandBuffer commandBuffer) {
-	VkDeviceSize offsets[] = { 0 };
-	vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertexBuffer, offsets);
-	vkCmdBindIndexBuffer(commandBuffer, indexBuffer, 0, VK_INDEX_TYPE_UINT32);
-	vkCmdDrawIndexed(commandBuffer,static_cast<uint32_t>(indices.size()),1,0,0,0);
+	if (!geometry.IsValid()) return;
+	vkCmdDrawIndexed(commandBuffer, geometry.indexCount, 1, geometry.firstIndex, geometry.firstVertex, 0);
+}
+
+void Mesh::DrawInstanced(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, const glm::mat4& model, uint32_t instanceCount) {
+	if (!geometry.IsValid() || instanceCount == 0) return;
+	Utils::DrawPushConstants pushConstants{ model, materialSlot };
+	vkCmdPushConstants(commandBuffer, pipelineLayout, Utils::DrawPushConstants::stages, 0, sizeof(pushConstants), &pushConstants);
+	vkCmdDrawIndexed(commandBuffer, geometry.indexCount, instanceCount, geometry.firstIndex, geometry.firstVertex, 0);
+}
+
+void Mesh::Draw(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, const glm::mat4& model) {
+	if (!geometry.IsValid()) return;
+	Utils::DrawPushConstants pushConstants{ model, materialSlot };
+	vkCmdPushConstants(commandBuffer, pipelineLayout, Utils::DrawPushConstants::stages, 0, sizeof(pushConstants), &pushConstants);
+	Draw(commandBuffer);
 }
\ No newline at end of file
@@ -8,6 +8,7 @@
 #include <vector>
 #include "Material.hpp"
 #include "Renderer.h"
+#include "Tools/UploadBatch.hpp"
 struct Vertex
 {
 	glm::vec3 position;
@@ -43,50 +44,76 @@ struct Vertex
 	}
 };
 
+// per instance vertex data of binding 1, read by InstancedVertexShader(Model::DrawInstanced)
+struct InstanceData
+{
+	glm::mat4 transform = glm::mat4(1.0f); // applied after the model matrix
+	uint32_t materialIndex = NO_MATERIAL_OVERRIDE; // bindless material slot replacing the mesh's
+	static const uint32_t NO_MATERIAL_OVERRIDE = UINT32_MAX;
+	static VkVertexInputBindingDescription GetBindingDescription() {
+		VkVertexInputBindingDescription bindingDescription{};
+		bindingDescription.binding = 1;
+		bindingDescription.stride = sizeof(InstanceData);
+		bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+		return bindingDescription;
+	}
+	// a mat4 attribute takes a location per column
+	static std::array<VkVertexInputAttributeDescription, 5> GetAttributeDescriptons() {
+		std::array<VkVertexInputAttributeDescription, 5> attributeDescription{};
+		for (uint32_t i = 0; i < 4; i++) {
+			attributeDescription[i].binding = 1;
+			attributeDescription[i].location = 3 + i;
+			attributeDescription[i].format = VK_FORMAT_R32G32B32A32_SFLOAT;
+			attributeDescription[i].offset = static_cast<uint32_t>(offsetof(InstanceData, transform) + sizeof(glm::vec4) * i);
+		}
+		attributeDescription[4].binding = 1;
+		attributeDescription[4].location = 7;
+		attributeDescription[4].format = VK_FORMAT_R32_UINT;
+		attributeDescription[4].offset = offsetof(InstanceData, materialIndex);
+		return attributeDescription;
+	}
+};
+
 class Mesh {
 public:
-	Mesh(std::vector<Vertex> _vertices, std::vector<unsigned int> _indices, Material _material) :vertices(_vertices), indices(_indices), material(_material) {
-		VkDeviceSize bufferSize = sizeof(vertices[0]) * vertices.size();
-		CreateBuffer(vertices.data(), bufferSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,vertexBuffer, vertexBufferMemory, "vertexBuffer");
-		bufferSize = sizeof(indices[0]) * indices.size();
-		CreateBuffer(indices.data(), bufferSize, VK_BUFFER_USAGE_INDEX_BUFFER_BIT,indexBuffer, indexBufferMemory, "indexBuffer");
+	Mesh(std::vector<Vertex> _vertices, std::vector<unsigned int> _indices, Material _material, UploadBatch& batch) :vertices(_vertices), indices(_indices), material(_material) {
+		CreateGeometry(vertices.data(), static_cast<uint32_t>(vertices.size()), indices.data(), static_cast<uint32_t>(indices.size()), batch);
 	}
+	// uploads straight from _vertices/_indices(e.g. a mapped mesh cache) without keeping a cpu copy.
+	Mesh(const Vertex* _vertices, uint32_t vertexCount, const unsigned int* _indices, uint32_t indexCount, Material _material, UploadBatch& batch) :material(_material) {
+		CreateGeometry(_vertices, vertexCount, _indices, indexCount, batch);
+	}
+	// the geometry pool must be bound(GeometryPool::Bind) before drawing.
 	void Draw(VkCommandBuffer commandBuffer);
+	// pushes model and materialSlot as Utils::DrawPushConstants first. pipelineLayout needs DrawPushConstants::GetRange().
+	void Draw(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, const glm::mat4& model);
+	// same with instanceCount instances of the InstanceData bound at binding 1
+	void DrawInstanced(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, const glm::mat4& model, uint32_t instanceCount);
+	// empty for meshes loaded from a mesh cache
+	const std::vector<Vertex>& GetVertices() const { return vertices; }
+	const std::vector<unsigned int>& GetIndices() const { return indices; }
+	const GeometryAllocation& GetGeometry() const { return geometry; }
 public:
-	Material material;
+	Material material;		// texture indices of the model
+	uint32_t materialSlot = 0; // material of Renderer::bindlessTable
+	Utils::AABB bounds; // mesh space, Model::sceneGraph's node places it in the model
+	uint32_t node = 0; // node of Model::sceneGraph the mesh hangs under
+	uint32_t drawSlot = 0; // Utils::DrawData of Renderer::bindlessTable, firstInstance of its indirect command
+	PipelineHandle pipeline = NO_PIPELINE; // variant for material.GetFeatures()(Renderer::RequestMaterialPipeline), set when the mesh is published
 private:
 	std::vector<Vertex>			vertices;
 	std::vector<unsigned int>	indices;
-	VkBuffer vertexBuffer = VK_NULL_HANDLE;
-	VkDeviceMemory vertexBufferMemory = VK_NULL_HANDLE;
-	VkBuffer indexBuffer = VK_NULL_HANDLE;
-	VkDeviceMemory indexBufferMemory = VK_NULL_HANDLE;
+	GeometryAllocation geometry; // range of Renderer::geometryPool
 
 private:
-	//latter, need to implement single buffer(vertex + index)
-	template <typename T>
-	inline void CreateBuffer(T* src, VkDeviceSize bufferSize, VkBufferUsageFlagBits usages, VkBuffer& outBuffer, VkDeviceMemory& outBufferMemory, std::string purpose = "") {
+	inline void CreateGeometry(const Vertex* src, uint32_t vertexCount, const unsigned int* srcIndices, uint32_t indexCount, UploadBatch& batch) {
 		Renderer* instance = Renderer::GetInstance();
 		if (instance == nullptr) {
-			printf("Fail to create %s Buffer. Please create Renderer instance or call Renderer::init()\n", purpose.c_str());
+			printf("Fail to create geometry. Please create Renderer instance or call Renderer::init()\n");
 			return;
 		}
-		VkBuffer stagingBuffer;
-		VkDeviceMemory stagingBufferMemory;
-		Utils::CreateBuffer(instance->device, instance->physicalDevice, bufferSize,
-			VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-			stagingBuffer, stagingBufferMemory, VK_SHARING_MODE_EXCLUSIVE
-		);
-		void* data;
-		vkMapMemory(instance->device, stagingBufferMemory, 0, bufferSize, 0, &data);
-		memcpy(data, src, (size_t)bufferSize);
-		vkUnmapMemory(instance->device, stagingBufferMemory);
-
-		Utils::CreateBuffer(instance->device, instance->physicalDevice, bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | usages, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, outBuffer, outBufferMemory);
-		Utils::CopyBuffer(instance->device, instance->commandPool, instance->graphicsQueue, stagingBuffer, outBuffer, bufferSize);
-
-		vkDestroyBuffer(instance->device, stagingBuffer, nullptr);
-		vkFreeMemory(instance->device, stagingBufferMemory, nullptr);
+		geometry = instance->geometryPool.Allocate(vertexCount, indexCount);
+		instance->geometryPool.Upload(batch, geometry, src, srcIndices);
 	}
 };
 #endif // !Mesh_HPP
@@ -0,0 +1,219 @@
+#include "MeshCache.hpp"
+#include <fstream>
+#include <filesystem>
+#include <unordered_map>
+#include <cstdio>
+
+namespace {
+	const uint64_t BLOB_ALIGNMENT = 16;
+	inline uint64_t AlignUp(uint64_t value, uint64_t alignment) {
+		return (value + alignment - 1) / alignment * alignment;
+	}
+}
+
+namespace MeshCache {
+	std::string GetCachePath(const std::string& fn) {
+		return fn + ".meshcache";
+	}
+
+	uint64_t HashFile(const std::string& fn, uint64_t* outSize) {
+		MappedFile file;
+		if (!file.Open(fn)) return 0;
+		if (outSize != nullptr) *outSize = file.GetSize();
+		uint64_t hash = 14695981039346656037ull;
+		const unsigned char* bytes = reinterpret_cast<const unsigned char*>(file.GetData());
+		for (size_t i = 0; i < file.GetSize(); i++) {
+			hash ^= bytes[i];
+			hash *= 1099511628211ull;
+		}
+		return hash;
+	}
+
+	std::array<int*, 9> GetTextureSlots(Material& material) {
+		static_assert(sizeof(Material) == 9 * sizeof(int), "every texture index of Material must be listed here");
+		return { &material.diffTexIdx, &material.specTexIdx, &material.bumpMapIdx, &material.normalMapIdx, &material.emissionMapIdx,
+			&material.opacityMapIdx, &material.roughnessMapIdx, &material.metalnessMapIdx, &material.ambOcclMapIdx };
+	}
+
+	bool Reader::Open(const std::string& cachePath, uint64_t sourceHash) {
+		if (sourceHash == 0 || !file.Open(cachePath)) return false;
+		const char* data = file.GetData();
+		uint64_t size = file.GetSize();
+		if (size < sizeof(FileHeader)) return false;
+		header = reinterpret_cast<const FileHeader*>(data);
+		if (header->magic != MAGIC || header->version != VERSION || header->vertexStride != sizeof(Vertex) || header->materialSize != sizeof(Material)) {
+			printf("Mesh cache %s is outdated\n", cachePath.c_str());
+			return false;
+		}
+		if (header->sourceHash != sourceHash) {
+			printf("Mesh cache %s doesn't match its source\n", cachePath.c_str());
+			return false;
+		}
+		uint64_t tableEnd = sizeof(FileHeader) + header->meshCount * sizeof(MeshRecord) + header->textureCount * sizeof(TextureRecord) + header->nodeCount * sizeof(NodeRecord) +
+			header->dependencyCount * sizeof(DependencyRecord);
+		if (tableEnd > header->stringOffset || header->stringOffset + header->stringSize > size ||
+			header->vertexOffset + header->vertexCount * sizeof(Vertex) > size || header->indexOffset + header->indexCount * sizeof(uint32_t) > size) {
+			printf("Mesh cache %s is truncated\n", cachePath.c_str());
+			return false;
+		}
+		meshes = reinterpret_cast<const MeshRecord*>(data + sizeof(FileHeader));
+		textures = reinterpret_cast<const TextureRecord*>(meshes + header->meshCount);
+		nodes = reinterpret_cast<const NodeRecord*>(textures + header->textureCount);
+		const DependencyRecord* dependencies = reinterpret_cast<const DependencyRecord*>(nodes + header->nodeCount);
+		strings = data + header->stringOffset;
+		vertices = reinterpret_cast<const Vertex*>(data + header->vertexOffset);
+		indices = reinterpret_cast<const uint32_t*>(data + header->indexOffset);
+		for (uint32_t i = 0; i < header->meshCount; i++) {
+			if (static_cast<uint64_t>(meshes[i].firstVertex) + meshes[i].vertexCount > header->vertexCount ||
+				static_cast<uint64_t>(meshes[i].firstIndex) + meshes[i].indexCount > header->indexCount || meshes[i].node >= header->nodeCount) {
+				printf("Mesh cache %s is corrupted\n", cachePath.c_str());
+				return false;
+			}
+			Material material = meshes[i].material;
+			for (int* slot : GetTextureSlots(material)) {
+				if (*slot >= 0 && static_cast<uint32_t>(*slot) >= header->textureCount) {
+					printf("Mesh cache %s is corrupted\n", cachePath.c_str());
+					return false;
+				}
+			}
+		}
+		for (uint32_t i = 0; i < header->textureCount; i++) {
+			if (static_cast<uint64_t>(textures[i].pathOffset) + textures[i].pathLength > header->stringSize) {
+				printf("Mesh cache %s is corrupted\n", cachePath.c_str());
+				return false;
+			}
+		}
+		//depth first, so a parent always comes before its children
+		for (uint32_t i = 0; i < header->nodeCount; i++) {
+			if ((nodes[i].parent != SceneGraph::NO_NODE && nodes[i].parent >= i) ||
+				static_cast<uint64_t>(nodes[i].nameOffset) + nodes[i].nameLength > header->stringSize) {
+				printf("Mesh cache %s is corrupted\n", cachePath.c_str());
+				return false;
+			}
+		}
+		for (uint32_t i = 0; i < header->dependencyCount; i++) {
+			if (static_cast<uint64_t>(dependencies[i].pathOffset) + dependencies[i].pathLength > header->stringSize) {
+				printf("Mesh cache %s is corrupted\n", cachePath.c_str());
+				return false;
+			}
+			std::string path(strings + dependencies[i].pathOffset, dependencies[i].pathLength);
+			uint64_t size = 0;
+			uint64_t hash = HashFile(path, &size);
+			if (hash == 0 || hash != dependencies[i].hash || size != dependencies[i].size) {
+				printf("Mesh cache %s doesn't match %s\n", cachePath.c_str(), path.c_str());
+				return false;
+			}
+		}
+		return true;
+	}
+
+	TextureRef Reader::GetTexture(uint32_t idx) const {
+		TextureRef ref;
+		ref.path.assign(strings + textures[idx].pathOffset, textures[idx].pathLength);
+		ref.sRGB = textures[idx].sRGB != 0;
+		ref.genMipmap = textures[idx].genMipmap != 0;
+		return ref;
+	}
+
+	void Writer::AddMesh(const std::vector<Vertex>& _vertices, const std::vector<unsigned int>& _indices, const Material& material, const Utils::AABB& bounds, uint32_t node) {
+		MeshRecord record;
+		record.firstVertex = static_cast<uint32_t>(vertices.size());
+		record.vertexCount = static_cast<uint32_t>(_vertices.size());
+		record.firstIndex = static_cast<uint32_t>(indices.size());
+		record.indexCount = static_cast<uint32_t>(_indices.size());
+		record.material = material;
+		record.bounds = bounds;
+		record.node = node;
+		meshes.push_back(record);
+		vertices.insert(vertices.end(), _vertices.begin(), _vertices.end());
+		indices.insert(indices.end(), _indices.begin(), _indices.end());
+	}
+
+	void Writer::AddNode(uint32_t parent, const glm::mat4& local, const std::string& name) {
+		NodeRecord record;
+		record.parent = parent;
+		record.local = local;
+		nodes.push_back(record);
+		nodeNames.push_back(name);
+	}
+
+	bool Writer::Save(const std::string& cachePath, uint64_t sourceHash, const std::vector<TextureRef>& modelTextures, const std::vector<std::string>& dependencies) {
+		if (sourceHash == 0) return false;
+		//only the textures the meshes use, in first use order
+		std::vector<TextureRecord> textureRecords;
+		std::string strings;
+		std::unordered_map<int, int> remap;
+		for (MeshRecord& mesh : meshes) {
+			for (int* slot : GetTextureSlots(mesh.material)) {
+				if (*slot < 0) continue;
+				auto it = remap.find(*slot);
+				if (it == remap.end()) {
+					const TextureRef& ref = modelTextures[*slot];
+					TextureRecord record;
+					record.pathOffset = static_cast<uint32_t>(strings.size());
+					record.pathLength = static_cast<uint32_t>(ref.path.size());
+					record.sRGB = ref.sRGB ? 1 : 0;
+					record.genMipmap = ref.genMipmap ? 1 : 0;
+					strings += ref.path;
+					it = remap.emplace(*slot, static_cast<int>(textureRecords.size())).first;
+					textureRecords.push_back(record);
+				}
+				*slot = it->second;
+			}
+		}
+		for (size_t i = 0; i < nodes.size(); i++) {
+			nodes[i].nameOffset = static_cast<uint32_t>(strings.size());
+			nodes[i].nameLength = static_cast<uint32_t>(nodeNames[i].size());
+			strings += nodeNames[i];
+		}
+		std::vector<DependencyRecord> dependencyRecords(dependencies.size());
+		for (size_t i = 0; i < dependencies.size(); i++) {
+			DependencyRecord& record = dependencyRecords[i];
+			record.hash = HashFile(dependencies[i], &record.size);
+			//an unreadable dependency would never match, don't write a cache that can't be used
+			if (record.hash == 0) return false;
+			record.pathOffset = static_cast<uint32_t>(strings.size());
+			record.pathLength = static_cast<uint32_t>(dependencies[i].size());
+			strings += dependencies[i];
+		}
+
+		FileHeader header;
+		header.meshCount = static_cast<uint32_t>(meshes.size());
+		header.textureCount = static_cast<uint32_t>(textureRecords.size());
+		header.nodeCount = static_cast<uint32_t>(nodes.size());
+		header.dependencyCount = static_cast<uint32_t>(dependencyRecords.size());
+		header.sourceHash = sourceHash;
+		header.stringOffset = sizeof(FileHeader) + meshes.size() * sizeof(MeshRecord) + textureRecords.size() * sizeof(TextureRecord) + nodes.size() * sizeof(NodeRecord) +
+			dependencyRecords.size() * sizeof(DependencyRecord);
+		header.stringSize = strings.size();
+		header.vertexOffset = AlignUp(header.stringOffset + header.stringSize, BLOB_ALIGNMENT);
+		header.vertexCount = vertices.size();
+		header.indexOffset = AlignUp(header.vertexOffset + vertices.size() * sizeof(Vertex), BLOB_ALIGNMENT);
+		header.indexCount = indices.size();
+
+		std::string tempPath = cachePath + ".tmp";
+		{
+			std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+			if (!out.is_open()) return false;
+			const char zeros[BLOB_ALIGNMENT] = {};
+			out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+			out.write(reinterpret_cast<const char*>(meshes.data()), meshes.size() * sizeof(MeshRecord));
+			out.write(reinterpret_cast<const char*>(textureRecords.data()), textureRecords.size() * sizeof(TextureRecord));
+			out.write(reinterpret_cast<const char*>(nodes.data()), nodes.size() * sizeof(NodeRecord));
+			out.write(reinterpret_cast<const char*>(dependencyRecords.data()), dependencyRecords.size() * sizeof(DependencyRecord));
+			out.write(strings.data(), strings.size());
+			out.write(zeros, header.vertexOffset - (header.stringOffset + header.stringSize));
+			out.write(reinterpret_cast<const char*>(vertices.data()), vertices.size() * sizeof(Vertex));
+			out.write(zeros, header.indexOffset - (header.vertexOffset + vertices.size() * sizeof(Vertex)));
+			out.write(reinterpret_cast<const char*>(indices.data()), indices.size() * sizeof(uint32_t));
+			if (!out.good()) return false;
+		}
+		std::error_code error;
+		std::filesystem::rename(tempPath, cachePath, error);
+		if (error) {
+			std::filesystem::remove(tempPath, error);
+			return false;
+		}
+		return true;
+	}
+}
@@ -0,0 +1,125 @@
+#pragma once
+#ifndef MESHCACHE_HPP
+#define MESHCACHE_HPP
+#include <string>
+#include <vector>
+#include <array>
+#include <cstdint>
+#include "Mesh.hpp"
+#include "Material.hpp"
+#include "SceneGraph.hpp"
+#include "Tools/MappedFile.hpp"
+
+// binary copy of an imported model, written next to the asset(<asset>.meshcache).
+// warm loads map it and upload vertex/index data straight from the mapping, assimp is skipped.
+// layout : FileHeader | MeshRecord[meshCount] | TextureRecord[textureCount] | NodeRecord[nodeCount] | DependencyRecord[dependencyCount] | strings | vertices | indices
+namespace MeshCache {
+	const uint32_t MAGIC = 0x434D4B56; // "VKMC"
+	const uint32_t VERSION = 4;		   // bump when the layout, Vertex or Material changes
+
+	struct FileHeader {
+		uint32_t magic = MAGIC;
+		uint32_t version = VERSION;
+		uint32_t vertexStride = sizeof(Vertex);
+		uint32_t materialSize = sizeof(Material);
+		uint32_t meshCount = 0;
+		uint32_t textureCount = 0;
+		uint32_t nodeCount = 0;
+		uint32_t dependencyCount = 0;
+		uint64_t sourceHash = 0;
+		uint64_t stringOffset = 0;
+		uint64_t stringSize = 0;
+		uint64_t vertexOffset = 0;
+		uint64_t vertexCount = 0;
+		uint64_t indexOffset = 0;
+		uint64_t indexCount = 0;
+	};
+
+	struct MeshRecord {
+		uint32_t firstVertex = 0;
+		uint32_t vertexCount = 0;
+		uint32_t firstIndex = 0;
+		uint32_t indexCount = 0;
+		Utils::AABB bounds;
+		Material material;	// texture indices point into the texture records
+		uint32_t node = 0;	// node record the mesh hangs under
+	};
+
+	struct TextureRecord {
+		uint32_t pathOffset = 0; // into the string blob
+		uint32_t pathLength = 0;
+		uint32_t sRGB = 0;
+		uint32_t genMipmap = 0;
+	};
+
+	// scene graph node, stored depth first like SceneGraph
+	struct NodeRecord {
+		uint32_t parent = SceneGraph::NO_NODE;
+		uint32_t nameOffset = 0; // into the string blob
+		uint32_t nameLength = 0;
+		uint32_t padding = 0;
+		glm::mat4 local;
+	};
+
+	// a file the importer read besides the source(.bin buffers of a gltf, the .mtl of an obj)
+	struct DependencyRecord {
+		uint32_t pathOffset = 0; // into the string blob
+		uint32_t pathLength = 0;
+		uint64_t size = 0;
+		uint64_t hash = 0; // HashFile
+	};
+
+	struct TextureRef {
+		std::string path;
+		bool sRGB = false;
+		bool genMipmap = true;
+	};
+
+	std::string GetCachePath(const std::string& fn);
+	// 64 bit FNV-1a of the file. 0 if it can't be read.
+	uint64_t HashFile(const std::string& fn, uint64_t* outSize = nullptr);
+	std::array<int*, 9> GetTextureSlots(Material& material);
+
+	class Reader {
+	public:
+		// false when the cache is missing, from another version or built from a different source,
+		// or when a dependency changed since it was written.
+		bool Open(const std::string& cachePath, uint64_t sourceHash);
+		uint32_t GetMeshCount() const { return header->meshCount; }
+		const MeshRecord& GetMesh(uint32_t idx) const { return meshes[idx]; }
+		const Vertex* GetVertices(const MeshRecord& mesh) const { return vertices + mesh.firstVertex; }
+		const uint32_t* GetIndices(const MeshRecord& mesh) const { return indices + mesh.firstIndex; }
+		uint32_t GetTextureCount() const { return header->textureCount; }
+		TextureRef GetTexture(uint32_t idx) const;
+		uint32_t GetNodeCount() const { return header->nodeCount; }
+		const NodeRecord& GetNode(uint32_t idx) const { return nodes[idx]; }
+		std::string GetNodeName(uint32_t idx) const { return std::string(strings + nodes[idx].nameOffset, nodes[idx].nameLength); }
+	private:
+		MappedFile file;
+		const FileHeader* header = nullptr;
+		const MeshRecord* meshes = nullptr;
+		const TextureRecord* textures = nullptr;
+		const NodeRecord* nodes = nullptr;
+		const char* strings = nullptr;
+		const Vertex* vertices = nullptr;
+		const uint32_t* indices = nullptr;
+	};
+
+	class Writer {
+	public:
+		// material holds indices into the model's textures, they're remapped on Save.
+		void AddMesh(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices, const Material& material, const Utils::AABB& bounds, uint32_t node);
+		// in SceneGraph order, so parent is already added
+		void AddNode(uint32_t parent, const glm::mat4& local, const std::string& name);
+		// modelTextures[i] describes texture i of the model. dependencies are the other files the importer opened, they're hashed here.
+		// written to a temporary file and renamed, so a crash never leaves half a cache.
+		bool Save(const std::string& cachePath, uint64_t sourceHash, const std::vector<TextureRef>& modelTextures, const std::vector<std::string>& dependencies);
+	private:
+		std::vector<MeshRecord> meshes;
+		std::vector<NodeRecord> nodes;
+		std::vector<std::string> nodeNames;
+		std::vector<Vertex> vertices;
+		std::vector<uint32_t> indices;
+	};
+}
+#endif // !MESHCACHE_HPP
@@ -1,16 +1,335 @@
 #include "Model.hpp"
+#include <assimp/DefaultIOSystem.h>
 #include <cstring>
 #include <stdexcept>
+#include <algorithm>
+
+namespace {
+	// every texture slot ProcessMesh reads, in the same order
+	const aiTextureType materialTextureTypes[] = {
+		aiTextureType_DIFFUSE, aiTextureType_SPECULAR, aiTextureType_EMISSIVE, aiTextureType_HEIGHT, aiTextureType_NORMALS,
+		aiTextureType_SHININESS, aiTextureType_OPACITY, aiTextureType_DISPLACEMENT, aiTextureType_REFLECTION, aiTextureType_BASE_COLOR,
+		aiTextureType_NORMAL_CAMERA, aiTextureType_EMISSION_COLOR, aiTextureType_METALNESS, aiTextureType_AMBIENT_OCCLUSION,
+		aiTextureType_UNKNOWN // AI_MATKEY_GLTF_PBRMETALLICROUGHNESS_METALLICROUGHNESS_TEXTURE
+	};
+
+	// meshes CullMeshes tests per job, a multiple of 8 so every chunk starts on a FrustumCuller block
+	const uint32_t CULL_GRAIN = 1024;
+
+	// records every file the importer opens(.bin buffers, .mtl libraries), the mesh cache depends on all of them
+	class RecordingIOSystem : public Assimp::DefaultIOSystem {
+	public:
+		explicit RecordingIOSystem(std::vector<std::string>& outFiles) : files(outFiles) {}
+		Assimp::IOStream* Open(const char* file, const char* mode = "rb") override {
+			Assimp::IOStream* stream = Assimp::DefaultIOSystem::Open(file, mode);
+			if (stream != nullptr && std::find(files.begin(), files.end(), file) == files.end()) files.push_back(file);
+			return stream;
+		}
+	private:
+		std::vector<std::string>& files;
+	};
+}
 
 void Model::Draw(VkCommandBuffer commadbuffer) {
+	Renderer::GetInstance()->geometryPool.Bind(commadbuffer);
 	for (int i = 0; i < meshes.size(); i++) {
 		meshes[i].Draw(commadbuffer);
 	}
 }
 
-void Model::LoadModel(const Renderer* renderer ,const std::string& fn) {
+void Model::Draw(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, const glm::mat4& modelMatrix) {
+	Renderer::GetInstance()->geometryPool.Bind(commandBuffer);
+	VkPipeline boundPipeline = VK_NULL_HANDLE;
+	for (size_t i = 0; i < meshes.size(); i++) {
+		BindMeshPipeline(commandBuffer, i, boundPipeline);
+		meshes[i].Draw(commandBuffer, pipelineLayout, GetMeshMatrix(i, modelMatrix));
+	}
+	RestoreDefaultPipeline(commandBuffer, boundPipeline);
+}
+
+void Model::Draw(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, const glm::mat4& modelMatrix, const glm::mat4& viewProj) {
+	Renderer::GetInstance()->geometryPool.Bind(commandBuffer);
+	VkPipeline boundPipeline = VK_NULL_HANDLE;
+	for (uint32_t i : CullMeshes(viewProj, modelMatrix)) {
+		BindMeshPipeline(commandBuffer, i, boundPipeline);
+		meshes[i].Draw(commandBuffer, pipelineLayout, GetMeshMatrix(i, modelMatrix));
+	}
+	RestoreDefaultPipeline(commandBuffer, boundPipeline);
+}
+
+void Model::BindMeshPipeline(VkCommandBuffer commandBuffer, size_t meshIdx, VkPipeline& boundPipeline) const {
+	VkPipeline pipeline = Renderer::GetInstance()->pipelineManager.Get(meshes[meshIdx].pipeline);
+	if (pipeline == VK_NULL_HANDLE || pipeline == boundPipeline) return;
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+	boundPipeline = pipeline;
+}
+
+void Model::RestoreDefaultPipeline(VkCommandBuffer commandBuffer, VkPipeline boundPipeline) const {
+	VkPipeline pipeline = Renderer::GetInstance()->GetPipeline();
+	if (boundPipeline != VK_NULL_HANDLE && boundPipeline != pipeline) vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+}
+
+void Model::DrawInstanced(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, const glm::mat4& modelMatrix, const InstanceData* instances, uint32_t count) {
+	if (count == 0) return;
+	Renderer* instance = Renderer::GetInstance();
+	UniformAllocation allocation = instance->instanceRing.Allocate(sizeof(InstanceData) * count);
+	memcpy(allocation.mapped, instances, sizeof(InstanceData) * count);
+	VkBuffer instanceBuffer = instance->instanceRing.GetBuffer();
+	VkDeviceSize offset = allocation.offset;
+	instance->geometryPool.Bind(commandBuffer);
+	vkCmdBindVertexBuffers(commandBuffer, 1, 1, &instanceBuffer, &offset);
+	//firstInstance stays 0, instance data comes from the vertex binding instead of the draw data table
+	for (size_t i = 0; i < meshes.size(); i++) {
+		meshes[i].DrawInstanced(commandBuffer, pipelineLayout, GetMeshMatrix(i, modelMatrix), count);
+	}
+}
+
+const std::vector<uint32_t>& Model::CullMeshes(const glm::mat4& viewProj, const glm::mat4& modelMatrix) {
+	//meshes only grow at the end
+	if (meshCuller.Size() > meshes.size()) meshCuller.Clear();
+	for (size_t i = meshCuller.Size(); i < meshes.size(); i++) {
+		meshCuller.Add(meshes[i].bounds, sceneGraph.GetWorld(meshes[i].node));
+	}
+	//planes of viewProj * model are in model space, boxes only change when their node moves(UpdateTransforms)
+	Frustum frustum = Frustum::FromMatrix(viewProj * modelMatrix);
+	uint32_t count = static_cast<uint32_t>(meshCuller.Size());
+	//every chunk fills its own list, joined in chunk order so visibleMeshes stays sorted like a serial cull
+	chunkVisibleMeshes.resize((count + CULL_GRAIN - 1) / CULL_GRAIN);
+	Renderer::GetInstance()->jobSystem.ParallelFor(count, CULL_GRAIN, [&](uint32_t first, uint32_t last) {
+		std::vector<uint32_t>& visible = chunkVisibleMeshes[first / CULL_GRAIN];
+		visible.clear();
+		meshCuller.Cull(frustum, visible, first, last);
+	});
+	visibleMeshes.clear();
+	for (const std::vector<uint32_t>& visible : chunkVisibleMeshes) {
+		visibleMeshes.insert(visibleMeshes.end(), visible.begin(), visible.end());
+	}
+	return visibleMeshes;
+}
+
+void Model::DrawIndirect(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, const glm::mat4& modelMatrix) {
+	Renderer* instance = Renderer::GetInstance();
+	instance->geometryPool.Bind(commandBuffer);
+	if (indirect.drawCount > 0) {
+		Utils::DrawPushConstants pushConstants{ modelMatrix, Utils::DrawPushConstants::DRAW_FROM_INSTANCE };
+		vkCmdPushConstants(commandBuffer, pipelineLayout, Utils::DrawPushConstants::stages, 0, sizeof(pushConstants), &pushConstants);
+		if (indirect.culled.IsValid()) instance->cullingPass.Draw(commandBuffer, indirect.culled);
+		else vkCmdDrawIndexedIndirect(commandBuffer, indirect.buffer, 0, indirect.drawCount, sizeof(VkDrawIndexedIndirectCommand));
+	}
+	//multi-draws can't switch pipelines, they use the generic variant. the meshes after them are drawn with their own
+	VkPipeline boundPipeline = VK_NULL_HANDLE;
+	for (size_t i = indirect.drawCount; i < meshes.size(); i++) {
+		BindMeshPipeline(commandBuffer, i, boundPipeline);
+		meshes[i].Draw(commandBuffer, pipelineLayout, GetMeshMatrix(i, modelMatrix));
+	}
+	RestoreDefaultPipeline(commandBuffer, boundPipeline);
+}
+
+void Model::UpdateTransforms(VkCommandBuffer commandBuffer) {
+	Renderer* instance = Renderer::GetInstance();
+	bool bindless = instance->IsBindless();
+	movedMeshes.clear();
+
+	const std::vector<SceneGraph::NodeRange>& ranges = sceneGraph.UpdateWorldMatrices();
+	for (const SceneGraph::NodeRange& range : ranges) {
+		//meshes are sorted by node, so the meshes of a range are contiguous
+		auto first = std::lower_bound(meshes.begin(), meshes.end(), range.first, [](const Mesh& mesh, uint32_t node) { return mesh.node < node; });
+		for (auto it = first; it != meshes.end() && it->node < range.last; ++it) {
+			size_t i = it - meshes.begin();
+			if (i < meshCuller.Size()) meshCuller.Set(static_cast<uint32_t>(i), Utils::TransformAABB(it->bounds, sceneGraph.GetWorld(it->node)));
+			if (i < transformedMeshCount) movedMeshes.push_back(static_cast<uint32_t>(i));
+		}
+	}
+	//meshes published since the last call were registered with the world matrix of load time, their node may have moved since
+	for (; transformedMeshCount < meshes.size(); transformedMeshCount++) {
+		movedMeshes.push_back(static_cast<uint32_t>(transformedMeshCount));
+	}
+	if (!bindless || movedMeshes.empty()) return;
+
+	//every moved matrix goes into this frame's slice of transformRing and lands in the draw data with one copy
+	UniformAllocation allocation = instance->transformRing.Allocate(sizeof(glm::mat4) * movedMeshes.size());
+	glm::mat4* matrices = static_cast<glm::mat4*>(allocation.mapped);
+	transformCopies.resize(movedMeshes.size());
+	for (size_t i = 0; i < movedMeshes.size(); i++) {
+		const Mesh& mesh = meshes[movedMeshes[i]];
+		matrices[i] = sceneGraph.GetWorld(mesh.node);
+		transformCopies[i].srcOffset = allocation.offset + sizeof(glm::mat4) * i;
+		transformCopies[i].dstOffset = sizeof(Utils::DrawData) * mesh.drawSlot;
+		transformCopies[i].size = sizeof(glm::mat4);
+	}
+	//last frame's draws and culling are done reading the old transforms
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+		0, 0, nullptr, 0, nullptr, 0, nullptr);
+	vkCmdCopyBuffer(commandBuffer, instance->transformRing.GetBuffer(), instance->bindlessTable.GetDrawBuffer(),
+		static_cast<uint32_t>(transformCopies.size()), transformCopies.data());
+	VkMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		0, 1, &barrier, 0, nullptr, 0, nullptr);
+}
+
+void Model::Cull(VkCommandBuffer commandBuffer, const glm::mat4& viewProj, const glm::mat4& modelMatrix) {
+	if (!indirect.culled.IsValid()) return;
+	Renderer* instance = Renderer::GetInstance();
+	instance->cullingPass.Cull(commandBuffer, instance->hiZ, indirect.culled, viewProj * modelMatrix);
+}
+
+void Model::LoadModel(const Renderer* renderer, const std::string& fn) {
+	UploadBatch batch(Renderer::GetInstance());
+	LoadModel(renderer, fn, batch);
+	batch.Wait();
+	printf("Model upload finished with %u submission(s)\n", batch.GetSubmitCount());
+}
+
+void Model::LoadModel(const Renderer* renderer ,const std::string& fn, UploadBatch& batch) {
+	collectIndirect = meshes.empty() && Renderer::GetInstance()->SupportsIndirectDraw();
+	indirectCommands.clear();
+	indirectBounds.clear();
+	ImportScene(renderer, fn, batch, [this](const SceneGraph& graph) { nodeBase = sceneGraph.Append(graph); }, [this](Mesh&& mesh) {
+		mesh.node += nodeBase;
+		mesh.pipeline = Renderer::GetInstance()->RequestMaterialPipeline(mesh.material.GetFeatures());
+		meshes.push_back(std::move(mesh));
+	});
+	if (collectIndirect) indirect = CreateIndirectBuffer(batch);
+	batch.Submit();
+}
+
+void Model::LoadModelAsync(Renderer* renderer, const std::string& fn) {
+	if (IsLoading()) {
+		throw std::runtime_error("model is already loading!");
+	}
+	collectIndirect = meshes.empty() && indirect.drawCount == 0 && renderer->SupportsIndirectDraw();
+	indirectCommands.clear();
+	indirectBounds.clear();
+	renderer->jobSystem.RunBackground([this, renderer, fn]() {
+		UploadBatch batch(renderer);
+		ImportScene(renderer, fn, batch, [this](const SceneGraph& graph) {
+			std::lock_guard<std::mutex> lock(pendingMutex);
+			pendingSceneGraph = graph;
+			hasPendingSceneGraph = true;
+		}, [this, &batch](Mesh&& mesh) {
+			batch.Submit();
+			std::lock_guard<std::mutex> lock(pendingMutex);
+			pendingMeshes.push_back({ std::move(mesh), batch.GetLastTicket() });
+		});
+		if (collectIndirect) {
+			IndirectBuffer indirectBuffer = CreateIndirectBuffer(batch);
+			batch.Submit();
+			indirectBuffer.ticket = batch.GetLastTicket();
+			std::lock_guard<std::mutex> lock(pendingMutex);
+			pendingIndirect = indirectBuffer;
+		}
+		batch.Wait();
+		printf("Model upload finished with %u submission(s)\n", batch.GetSubmitCount());
+	}, &loadJob);
+}
+
+size_t Model::PollLoadedMeshes() {
+	StagingRing& stagingRing = Renderer::GetInstance()->stagingRing;
+	size_t readyCount = 0;
+	std::lock_guard<std::mutex> lock(pendingMutex);
+	//the nodes arrive before any mesh of their load
+	if (hasPendingSceneGraph) {
+		nodeBase = sceneGraph.Append(pendingSceneGraph);
+		pendingSceneGraph.Clear();
+		hasPendingSceneGraph = false;
+	}
+	//meshes are submitted in order, so stop at the first one still in flight
+	while (readyCount < pendingMeshes.size() && stagingRing.IsComplete(pendingMeshes[readyCount].ticket)) {
+		pendingMeshes[readyCount].mesh.node += nodeBase;
+		pendingMeshes[readyCount].mesh.pipeline = Renderer::GetInstance()->RequestMaterialPipeline(pendingMeshes[readyCount].mesh.material.GetFeatures());
+		meshes.push_back(std::move(pendingMeshes[readyCount].mesh));
+		readyCount++;
+	}
+	pendingMeshes.erase(pendingMeshes.begin(), pendingMeshes.begin() + readyCount);
+	//submitted after every mesh, so all of them are published when it completes
+	if (pendingIndirect.buffer != VK_NULL_HANDLE && stagingRing.IsComplete(pendingIndirect.ticket)) {
+		indirect = pendingIndirect;
+		pendingIndirect = IndirectBuffer{};
+		printf("Model draws %u mesh(es) with one indirect draw\n", indirect.drawCount);
+	}
+	return readyCount;
+}
+
+bool Model::IsLoading() {
+	if (!loadJob.IsDone()) return true;
+	std::lock_guard<std::mutex> lock(pendingMutex);
+	return !pendingMeshes.empty() || pendingIndirect.buffer != VK_NULL_HANDLE || hasPendingSceneGraph;
+}
+
+void Model::WaitForLoad() {
+	std::exception_ptr error;
+	try {
+		Renderer::GetInstance()->jobSystem.Wait(loadJob);
+	}
+	catch (...) {
+		error = std::current_exception();
+	}
+	PollLoadedMeshes(); // the loader waited for every upload
+	if (error) std::rethrow_exception(error);
+}
+
+void Model::Destroy() {
+	Renderer* instance = Renderer::GetInstance();
+	//a failed load has nothing left to publish
+	try {
+		instance->jobSystem.Wait(loadJob);
+	}
+	catch (const std::exception& e) {
+		printf("Model loading failed : %s\n", e.what());
+	}
+	{
+		//the last frames in flight may still read the buffers
+		std::lock_guard<std::mutex> lock(instance->queueMutex);
+		vkDeviceWaitIdle(instance->device);
+	}
+	std::lock_guard<std::mutex> lock(pendingMutex);
+	DestroyIndirectBuffer(indirect);
+	DestroyIndirectBuffer(pendingIndirect);
+}
+
+void Model::DestroyIndirectBuffer(IndirectBuffer& indirectBuffer) {
+	Renderer* instance = Renderer::GetInstance();
+	instance->cullingPass.DestroyDrawList(instance->memoryAllocator, indirectBuffer.culled);
+	if (indirectBuffer.buffer != VK_NULL_HANDLE) Utils::DestroyBuffer(instance->device, instance->memoryAllocator, indirectBuffer.buffer, indirectBuffer.memory);
+	indirectBuffer = IndirectBuffer{};
+}
+
+void Model::ImportScene(const Renderer* renderer, const std::string& fn, UploadBatch& batch, const std::function<void(const SceneGraph&)>& addSceneGraph, const std::function<void(Mesh&&)>& _addMesh) {
+	SceneGraph graph;
+	//every texture of a mesh is created before the mesh, so its material can be registered right away
+	std::function<void(Mesh&&)> addMesh = [this, &graph, &_addMesh](Mesh&& mesh) {
+		RegisterBindlessMaterial(mesh, graph.GetWorld(mesh.node));
+		if (collectIndirect) {
+			//meshes are published in this order, so command i draws meshes[i]. empty meshes keep their slot with indexCount 0
+			const GeometryAllocation& geometry = mesh.GetGeometry();
+			indirectCommands.push_back({ geometry.indexCount, 1, geometry.firstIndex, geometry.firstVertex, mesh.drawSlot });
+			indirectBounds.push_back(mesh.bounds);
+		}
+		_addMesh(std::move(mesh));
+	};
+	std::string cachePath = MeshCache::GetCachePath(fn);
+	uint64_t sourceHash = MeshCache::HashFile(fn);
+	MeshCache::Reader cache;
+	if (cache.Open(cachePath, sourceHash)) {
+		printf("Loading %s from mesh cache\n", fn.c_str());
+		for (uint32_t i = 0; i < cache.GetNodeCount(); i++) {
+			const MeshCache::NodeRecord& node = cache.GetNode(i);
+			graph.AddNode(node.parent, node.local, cache.GetNodeName(i));
+		}
+		addSceneGraph(graph);
+		LoadFromCache(renderer, cache, batch, addMesh);
+		return;
+	}
+
 	Assimp::Importer importer;
-	const aiScene* scene = importer.ReadFile(fn, aiProcess_Triangulate);
+	std::vector<std::string> importedFiles;
+	importer.SetIOHandler(new RecordingIOSystem(importedFiles)); // owned by the importer
+	const aiScene* scene = importer.ReadFile(fn, aiProcess_Triangulate | aiProcess_GenBoundingBoxes);
+	//the source is checked by sourceHash already
+	importedFiles.erase(std::remove(importedFiles.begin(), importedFiles.end(), fn), importedFiles.end());
 	std::string path = Utils::getPath(fn);
 
 	if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
@@ -18,20 +337,125 @@ void Model::LoadModel(const Renderer* renderer ,const std::string& fn) {
 		errMsg.append(importer.GetErrorString());
 		throw std::runtime_error(errMsg.c_str());
 	}
-	ProcessNode(renderer, scene->mRootNode, scene, path);
+	BuildSceneGraph(scene->mRootNode, SceneGraph::NO_NODE, graph);
+	addSceneGraph(graph);
+	//decode every texture of the scene in parallel, meshes take them in the order they were collected
+	std::vector<std::string> texturePaths;
+	CollectTexturePaths(scene->mRootNode, scene, path, texturePaths);
+	TextureDecoder decoder(Renderer::GetInstance()->jobSystem, texturePaths);
+	printf("Decoding %zu texture(s) as jobs, at most %u in flight\n", texturePaths.size(), decoder.GetMaxInFlight());
+	textureDecoder = &decoder;
+	MeshCache::Writer cacheWriter;
+	for (uint32_t i = 0; i < graph.Size(); i++) {
+		cacheWriter.AddNode(graph.GetParent(i), graph.GetLocal(i), graph.GetName(i));
+	}
+	try {
+		uint32_t nextNode = 0;
+		ProcessNode(renderer, scene->mRootNode, scene, path, batch, nextNode, [&cacheWriter, &addMesh](Mesh&& mesh) {
+			cacheWriter.AddMesh(mesh.GetVertices(), mesh.GetIndices(), mesh.material, mesh.bounds, mesh.node);
+			addMesh(std::move(mesh));
+		});
+	}
+	catch (...) {
+		textureDecoder = nullptr;
+		throw;
+	}
+	textureDecoder = nullptr;
+
+	std::vector<MeshCache::TextureRef> textureRefs;
+	{
+		std::lock_guard<std::mutex> lock(textureMutex);
+		for (const Texture& texture : texture_loaded) {
+			textureRefs.push_back({ texture.path, texture.sRGB, texture.mipLevels > 1 });
+		}
+	}
+	if (!cacheWriter.Save(cachePath, sourceHash, textureRefs, importedFiles)) {
+		printf("Failed to write mesh cache %s\n", cachePath.c_str());
+	}
+}
+
+void Model::LoadFromCache(const Renderer* renderer, const MeshCache::Reader& cache, UploadBatch& batch, const std::function<void(Mesh&&)>& addMesh) {
+	//texture records are stored in first use order, the same order the meshes below take them
+	std::vector<std::string> texturePaths;
+	for (uint32_t i = 0; i < cache.GetTextureCount(); i++) {
+		std::string texturePath = cache.GetTexture(i).path;
+		std::lock_guard<std::mutex> lock(textureMutex);
+		bool loaded = std::any_of(texture_loaded.begin(), texture_loaded.end(), [&texturePath](const Texture& texture) { return texture.path == texturePath; });
+		if (!loaded) texturePaths.push_back(texturePath);
+	}
+	TextureDecoder decoder(Renderer::GetInstance()->jobSystem, texturePaths);
+	textureDecoder = &decoder;
+	std::vector<int> textureIndices(cache.GetTextureCount(), -1); // cache texture -> model texture
+	try {
+		for (uint32_t i = 0; i < cache.GetMeshCount(); i++) {
+			const MeshCache::MeshRecord& record = cache.GetMesh(i);
+			Material material = record.material;
+			for (int* slot : MeshCache::GetTextureSlots(material)) {
+				if (*slot < 0) continue;
+				int& textureIdx = textureIndices[*slot];
+				if (textureIdx < 0) {
+					MeshCache::TextureRef ref = cache.GetTexture(*slot);
+					textureIdx = TestLoadMaterialTexture(renderer, nullptr, ref.path, batch, ref.sRGB, ref.genMipmap);
+				}
+				*slot = textureIdx;
+			}
+			Mesh mesh(cache.GetVertices(record), record.vertexCount, cache.GetIndices(record), record.indexCount, material, batch);
+			mesh.bounds = record.bounds;
+			mesh.node = record.node;
+			addMesh(std::move(mesh));
+		}
+	}
+	catch (...) {
+		textureDecoder = nullptr;
+		throw;
+	}
+	textureDecoder = nullptr;
 }
 
-void Model::ProcessNode(const Renderer* renderer, aiNode* node, const aiScene* scene, const std::string& path) {
+void Model::CollectTexturePaths(aiNode* node, const aiScene* scene, const std::string& path, std::vector<std::string>& outPaths) {
+	aiString file;
+	for (unsigned int i = 0; i < node->mNumMeshes; i++) {
+		aiMaterial* mat = scene->mMaterials[scene->mMeshes[node->mMeshes[i]]->mMaterialIndex];
+		for (aiTextureType type : materialTextureTypes) {
+			if (mat->GetTexture(type, 0, &file) != AI_SUCCESS) continue;
+			std::string texturePath = path + std::string(file.C_Str());
+			std::lock_guard<std::mutex> lock(textureMutex);
+			bool loaded = std::any_of(texture_loaded.begin(), texture_loaded.end(), [&texturePath](const Texture& texture) { return texture.path == texturePath; });
+			if (!loaded) outPaths.push_back(texturePath);
+		}
+	}
+	for (unsigned int i = 0; i < node->mNumChildren; i++) {
+		CollectTexturePaths(node->mChildren[i], scene, path, outPaths);
+	}
+}
+
+void Model::BuildSceneGraph(aiNode* node, uint32_t parent, SceneGraph& graph) {
+	//aiMatrix4x4 is row major
+	const aiMatrix4x4& m = node->mTransformation;
+	glm::mat4 local(m.a1, m.b1, m.c1, m.d1,
+		m.a2, m.b2, m.c2, m.d2,
+		m.a3, m.b3, m.c3, m.d3,
+		m.a4, m.b4, m.c4, m.d4);
+	uint32_t index = graph.AddNode(parent, local, node->mName.C_Str());
+	for (unsigned int i = 0; i < node->mNumChildren; i++) {
+		BuildSceneGraph(node->mChildren[i], index, graph);
+	}
+}
+
+void Model::ProcessNode(const Renderer* renderer, aiNode* node, const aiScene* scene, const std::string& path, UploadBatch& batch, uint32_t& nextNode, const std::function<void(Mesh&&)>& addMesh) {
+	uint32_t index = nextNode++;
 	for (unsigned int i = 0; i < node->mNumMeshes; i++) {
 		aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-		meshes.push_back(ProcessMesh(renderer, mesh, scene, path));
+		Mesh result = ProcessMesh(renderer, mesh, scene, path, batch);
+		result.node = index;
+		addMesh(std::move(result));
 	}
 	for (unsigned int i = 0; i < node->mNumChildren; i++) {
-		ProcessNode(renderer, node->mChildren[i], scene, path);
+		ProcessNode(renderer, node->mChildren[i], scene, path, batch, nextNode, addMesh);
 	}
 }
 
-Mesh Model::ProcessMesh(const Renderer* renderer, aiMesh* mesh, const aiScene* scene, const std::string& path) {
+Mesh Model::ProcessMesh(const Renderer* renderer, aiMesh* mesh, const aiScene* scene, const std::string& path, UploadBatch& batch) {
 	std::vector<Vertex> vertices;
 	std::vector<unsigned int> indices;
 	Material material;
@@ -74,78 +498,137 @@ Mesh Model::ProcessMesh(const Renderer* renderer, aiMesh* mesh, const aiScene* s
 		aiMaterial* mat = scene->mMaterials[mesh->mMaterialIndex];
 		if (mat->GetTexture(aiTextureType_DIFFUSE, 0, &file) == AI_SUCCESS) {
 			printf("Loading diffuse map : %s\n", file.C_Str());
-			material.diffTexIdx = TestLoadMaterialTexture(renderer, mat, path + std::string(file.C_Str()), true);
+			material.diffTexIdx = TestLoadMaterialTexture(renderer, mat, path + std::string(file.C_Str()), batch, true);
 		}
 		if (mat->GetTexture(aiTextureType_SPECULAR, 0, &file) == AI_SUCCESS) {
 			printf("Loading specular map : %s\n", file.C_Str());
-			material.specTexIdx = TestLoadMaterialTexture(renderer, mat, path + std::string(file.C_Str()), true);
+			material.specTexIdx = TestLoadMaterialTexture(renderer, mat, path + std::string(file.C_Str()), batch, true);
 		}
 		if (mat->GetTexture(aiTextureType_EMISSIVE, 0, &file) == AI_SUCCESS) {
 			printf("Loading emissive map : %s\n", file.C_Str());
-			material.emissionMapIdx = TestLoadMaterialTexture(renderer, mat, path + std::string(file.C_Str()), true);
+			material.emissionMapIdx = TestLoadMaterialTexture(renderer, mat, path + std::string(file.C_Str()), batch, true);
 		}
 		if (mat->GetTexture(aiTextureType_HEIGHT, 0, &file) == AI_SUCCESS) {
 			printf("Loading height map : %s\n", file.C_Str());
-			material.bumpMapIdx= TestLoadMaterialTexture(renderer, mat, path + std::string(file.C_Str()), true);
+			material.bumpMapIdx= TestLoadMaterialTexture(renderer, mat, path + std::string(file.C_Str()), batch, true);
 		}
 		if (mat->GetTexture(aiTextureType_NORMALS, 0, &file) == AI_SUCCESS) {
 			printf("Loading Normal map : %s\n", file.C_Str());
-			material.normalMapIdx = TestLoadMaterialTexture(renderer, mat, path + std::string(file.C_Str()), false);
+			material.normalMapIdx = TestLoadMaterialTexture(renderer, mat, path + std::string(file.C_Str()), batch, false);
 		}
 		if (mat->GetTexture(aiTextureType_SHININESS, 0, &file) == AI_SUCCESS) {
 			printf("Loading shininess map : %s\n", file.C_Str());
-			material.roughnessMapIdx = TestLoadMaterialTexture(renderer, mat, path + std::string(file.C_Str()), true);
+			material.roughnessMapIdx = TestLoadMaterialTexture(renderer, mat, path + std::string(file.C_Str()), batch, true);
 		}
 		if (mat->GetTexture(aiTextureType_OPACITY, 0, &file) == AI_SUCCESS) {
 			printf("Loading opacity map : %s\n", file.C_Str());
-			material.opacityMapIdx = TestLoadMaterialTexture(renderer, mat, path + std::string(file.C_Str()), true, false);
+			material.opacityMapIdx = TestLoadMaterialTexture(renderer, mat, path + std::string(file.C_Str()), batch, true, false);
 		}
 		if (mat->GetTexture(aiTextureType_DISPLACEMENT, 0, &file) == AI_SUCCESS) {
 			printf("Loading displacement map (as bump) : %s\n", file.C_Str());
-			material.bumpMapIdx = TestLoadMaterialTexture(renderer, mat, path + std::string(file.C_Str()), true);
+			material.bumpMapIdx = TestLoadMaterialTexture(renderer, mat, path + std::string(file.C_Str()), batch, true);
 		}
 		if (mat->GetTexture(aiTextureType_REFLECTION, 0, &file) == AI_SUCCESS) {
 			printf("Loading reflection map (as spec) : %s\n", file.C_Str());
-			material.specTexIdx = TestLoadMaterialTexture(renderer, mat, path + std::string(file.C_Str()), true);
+			material.specTexIdx = TestLoadMaterialTexture(renderer, mat, path + std::string(file.C_Str()), batch, true);
 		}
 		if (mat->GetTexture(aiTextureType_BASE_COLOR, 0, &file) == AI_SUCCESS) {
 			printf("Loading base color map (as diff) : %s\n", file.C_Str());
-			material.diffTexIdx = TestLoadMaterialTexture(renderer, mat, path + std::string(file.C_Str()), true);
+			material.diffTexIdx = TestLoadMaterialTexture(renderer, mat, path + std::string(file.C_Str()), batch, true);
 		}
 		if (mat->GetTexture(aiTextureType_NORMAL_CAMERA, 0, &file) == AI_SUCCESS) {
 			printf("Loading normal camera map (as normal): %s\n", file.C_Str());
-			material.normalMapIdx = TestLoadMaterialTexture(renderer, mat, path + std::string(file.C_Str()), false);
+			material.normalMapIdx = TestLoadMaterialTexture(renderer, mat, path + std::string(file.C_Str()), batch, false);
 		}
 		if (mat->GetTexture(aiTextureType_EMISSION_COLOR, 0, &file) == AI_SUCCESS) {
 			printf("Loading emission color map (as emissive): %s\n", file.C_Str());
-			material.emissionMapIdx = TestLoadMaterialTexture(renderer, mat, path + std::string(file.C_Str()), true);
+			material.emissionMapIdx = TestLoadMaterialTexture(renderer, mat, path + std::string(file.C_Str()), batch, true);
 		}
 		if (mat->GetTexture(aiTextureType_METALNESS, 0, &file) == AI_SUCCESS) {
 			printf("Loading metalness map : %s\n", file.C_Str());
-			material.metalnessMapIdx = TestLoadMaterialTexture(renderer, mat, path + std::string(file.C_Str()), false);
+			material.metalnessMapIdx = TestLoadMaterialTexture(renderer, mat, path + std::string(file.C_Str()), batch, false);
 		}
 		if (mat->GetTexture(aiTextureType_AMBIENT_OCCLUSION, 0, &file) == AI_SUCCESS) {
 			printf("Loading amb occlusion map : %s\n", file.C_Str());
-			material.ambOcclMapIdx = TestLoadMaterialTexture(renderer, mat, path + std::string(file.C_Str()), false);
+			material.ambOcclMapIdx = TestLoadMaterialTexture(renderer, mat, path + std::string(file.C_Str()), batch, false);
 		}
 		if (mat->GetTexture(AI_MATKEY_GLTF_PBRMETALLICROUGHNESS_METALLICROUGHNESS_TEXTURE, &file) == AI_SUCCESS) {
 			printf("Loading PBR Roughness map : %s\n", file.C_Str());
-			material.roughnessMapIdx = TestLoadMaterialTexture(renderer, mat, path + std::string(file.C_Str()), false);
+			material.roughnessMapIdx = TestLoadMaterialTexture(renderer, mat, path + std::string(file.C_Str()), batch, false);
+		}
+	}
+	Mesh result(vertices, indices, material, batch);
+	result.bounds.min = glm::vec3(mesh->mAABB.mMin.x, mesh->mAABB.mMin.y, mesh->mAABB.mMin.z);
+	result.bounds.max = glm::vec3(mesh->mAABB.mMax.x, mesh->mAABB.mMax.y, mesh->mAABB.mMax.z);
+	return result;
+}
+
+Model::IndirectBuffer Model::CreateIndirectBuffer(UploadBatch& batch) {
+	IndirectBuffer indirectBuffer;
+	if (indirectCommands.empty()) return indirectBuffer;
+	Renderer* instance = Renderer::GetInstance();
+	VkDeviceSize size = sizeof(VkDrawIndexedIndirectCommand) * indirectCommands.size();
+	bool gpuCulling = instance->SupportsGpuCulling();
+	//the culling pass reads the commands as a storage buffer
+	VkBufferUsageFlags usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT;
+	if (gpuCulling) usage |= VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+	Utils::CreateBuffer(instance->device, instance->memoryAllocator, size, usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, indirectBuffer.buffer, indirectBuffer.memory);
+	batch.UploadBuffer(indirectCommands.data(), size, indirectBuffer.buffer);
+	indirectBuffer.drawCount = static_cast<uint32_t>(indirectCommands.size());
+	if (gpuCulling) {
+		indirectBuffer.culled = instance->cullingPass.CreateDrawList(instance->memoryAllocator, batch, indirectBuffer.buffer, indirectBounds, instance->bindlessTable.GetDrawBuffer());
+	}
+	indirectCommands.clear();
+	indirectBounds.clear();
+	return indirectBuffer;
+}
+
+void Model::RegisterBindlessMaterial(Mesh& mesh, const glm::mat4& world) {
+	Renderer* instance = Renderer::GetInstance();
+	if (!instance->IsBindless()) return;
+	Material material = mesh.material;
+	{
+		std::lock_guard<std::mutex> lock(textureMutex);
+		for (int* slot : MeshCache::GetTextureSlots(material)) {
+			if (*slot >= 0) *slot = static_cast<int>(texture_loaded[*slot].bindlessSlot);
 		}
 	}
-	return Mesh(vertices,indices,material);
+	mesh.materialSlot = instance->bindlessTable.AddMaterial(material);
+	Utils::DrawData draw{};
+	draw.transform = world;
+	draw.materialIndex = mesh.materialSlot;
+	mesh.drawSlot = instance->bindlessTable.AddDraw(draw);
 }
 
-int Model::TestLoadMaterialTexture(const Renderer* renderer, aiMaterial* mat, const std::string& path, bool sRGB, bool genMipmap) {
-	for (unsigned int i = 0; i < texture_loaded.size(); i++) {
-		if (std::strcmp(texture_loaded[i].path.c_str(), path.c_str()) == 0) {
-			printf("Already loaded this texture : %s\n", path.substr(path.rfind('/') + 1, path.size()).c_str());
-			return i;
+int Model::TestLoadMaterialTexture(const Renderer* renderer, aiMaterial* mat, const std::string& path, UploadBatch& batch, bool sRGB, bool genMipmap) {
+	Texture* texture = nullptr;
+	int idx = 0;
+	{
+		std::lock_guard<std::mutex> lock(textureMutex);
+		for (unsigned int i = 0; i < texture_loaded.size(); i++) {
+			if (std::strcmp(texture_loaded[i].path.c_str(), path.c_str()) == 0) {
+				printf("Already loaded this texture : %s\n", path.substr(path.rfind('/') + 1, path.size()).c_str());
+				return i;
+			}
 		}
+		texture_loaded.emplace_back(path);
+		texture = &texture_loaded.back();
+		idx = static_cast<int>(texture_loaded.size()) - 1;
+	}
+	//decode outside of the lock. the main thread only reads textures of meshes that are ready.
+	if (textureDecoder != nullptr) {
+		DecodedImage image = textureDecoder->Take(path);
+		texture->create(image, batch, sRGB, genMipmap);
+		stbi_image_free(image.pixels);
+	}
+	else {
+		texture->create(path, batch, sRGB, false, genMipmap);
+	}
+	Renderer* instance = Renderer::GetInstance();
+	if (instance->IsBindless()) {
+		texture->bindlessSlot = instance->bindlessTable.AddTexture(texture->textureImageView, instance->GetDefaultSampler());
 	}
-	texture_loaded.emplace_back(path);
-	texture_loaded.back().create(path, sRGB, false, genMipmap);
-	return texture_loaded.size() - 1;
+	return idx;
 	
 	return 0;
 }
\ No newline at end of file
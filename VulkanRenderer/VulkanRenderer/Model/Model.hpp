@@ -3,11 +3,18 @@
 #define MODEL_HPP
 #include "Mesh.hpp"
 #include "Texture.hpp"
+#include "TextureDecoder.hpp"
+#include "MeshCache.hpp"
+#include "SceneGraph.hpp"
+#include "Tools/FrustumCuller.hpp"
 #include <assimp/Importer.hpp>
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
 #include <assimp/GltfMaterial.h>
 #include <vector>
+#include <deque>
+#include <mutex>
+#include <functional>
 
 class Model {
 public:
@@ -15,15 +22,103 @@ public:
 	Model(const Renderer* renderer, char* fn) {
 		LoadModel(renderer, fn);
 	}
-	std::vector<Mesh> meshes;
+	std::vector<Mesh> meshes; // meshes ready to draw, sorted by node. only touched by the thread that renders.
+	// node hierarchy of every load, meshes[i].node indexes it. move nodes with SetLocal, then UpdateTransforms.
+	SceneGraph sceneGraph;
 	void Draw(VkCommandBuffer commandBuffer);
+	// pushes modelMatrix * the mesh's node transform and the mesh's material before each draw.
+	// binds each mesh's material variant(Mesh::pipeline) and leaves the default pipeline bound
+	void Draw(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, const glm::mat4& modelMatrix);
+	// same, but only the meshes CullMeshes keeps
+	void Draw(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, const glm::mat4& modelMatrix, const glm::mat4& viewProj);
+	// every mesh once with count instances, instance i drawn with instances[i].transform * modelMatrix * the mesh's node transform.
+	// instances are copied into this frame's Renderer::instanceRing. bind Renderer::GetInstancedPipeline() first,
+	// material overrides are bindless slots and ignored without bindless.
+	void DrawInstanced(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, const glm::mat4& modelMatrix, const InstanceData* instances, uint32_t count);
+	// cpu frustum culling, returns the indices of meshes whose bounds intersect the view. valid until the next call
+	const std::vector<uint32_t>& CullMeshes(const glm::mat4& viewProj, const glm::mat4& modelMatrix);
+	// modelMatrix * the world matrix of meshes[meshIdx]'s node
+	glm::mat4 GetMeshMatrix(size_t meshIdx, const glm::mat4& modelMatrix) const { return modelMatrix * sceneGraph.GetWorld(meshes[meshIdx].node); }
+	// binds the material variant of meshes[meshIdx] unless it's boundPipeline already, boundPipeline starts as VK_NULL_HANDLE.
+	// the variant is the default pipeline while it's compiling
+	void BindMeshPipeline(VkCommandBuffer commandBuffer, size_t meshIdx, VkPipeline& boundPipeline) const;
+	// rebinds Renderer::GetPipeline() after BindMeshPipeline switched away from it
+	void RestoreDefaultPipeline(VkCommandBuffer commandBuffer, VkPipeline boundPipeline) const;
+	// recomputes the subtrees moved since the last call and refreshes the culling bounds and, in bindless mode,
+	// the Utils::DrawData of their meshes with one vkCmdCopyBuffer from Renderer::transformRing. once per frame, outside of a render pass and before Cull.
+	void UpdateTransforms(VkCommandBuffer commandBuffer);
+	// one vkCmdDrawIndexedIndirect for every mesh of the first load(Renderer::SupportsIndirectDraw()).
+	// the command buffer is built by the loader and used once its upload completes, meshes without a command are drawn one by one.
+	// draws only the commands that survived the last Cull when gpu culling is on.
+	void DrawIndirect(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, const glm::mat4& modelMatrix);
+	// Renderer::SupportsGpuCulling() : tests the indirect commands against the frustum and the hi-z pyramid.
+	// record outside of the render pass, before DrawIndirect.
+	void Cull(VkCommandBuffer commandBuffer, const glm::mat4& viewProj, const glm::mat4& modelMatrix);
 	void LoadModel(const Renderer* renderer, const std::string& fn);
-	VkImageView GetTextureView(int idx) { return texture_loaded[idx].textureImageView; }
+	// records every upload of the model into batch and submits it without waiting. poll batch.IsComplete() or call batch.Wait().
+	void LoadModel(const Renderer* renderer, const std::string& fn, UploadBatch& batch);
+	// import, decode and upload as a background job of Renderer::jobSystem(inline without workers).
+	// every mesh is submitted on its own as soon as it is recorded.
+	// call PollLoadedMeshes() once per frame to move meshes whose upload finished into meshes.
+	// WaitForLoad rethrows loading errors.
+	void LoadModelAsync(Renderer* renderer, const std::string& fn);
+	// returns the number of meshes that became ready.
+	size_t PollLoadedMeshes();
+	bool IsLoading();
+	// blocks until the async load finishes and publishes the remaining meshes.
+	void WaitForLoad();
+	// waits for the loader and the gpu, then frees the indirect command buffer and its culling output. call before Renderer::Clean
+	void Destroy();
+	VkImageView GetTextureView(int idx) {
+		std::lock_guard<std::mutex> lock(textureMutex);
+		return texture_loaded[idx].textureImageView;
+	}
 private:
-	std::vector<Texture> texture_loaded;
+	struct PendingMesh {
+		Mesh mesh;
+		uint64_t ticket; // staging ring ticket of the submission that uploads the mesh and its textures
+	};
+	std::deque<Texture> texture_loaded; // deque, so textures don't move while the loader appends
+	std::mutex textureMutex;
+	struct IndirectBuffer {
+		VkBuffer buffer = VK_NULL_HANDLE;
+		MemoryAllocation memory;
+		uint32_t drawCount = 0; // commands for meshes[0, drawCount)
+		uint64_t ticket = 0;
+		CulledDrawList culled; // gpu culling output, invalid without gpu culling
+	};
+	std::vector<PendingMesh> pendingMeshes;
+	SceneGraph pendingSceneGraph; // nodes of the async load, published before its first mesh. guarded by pendingMutex
+	bool hasPendingSceneGraph = false;
+	uint32_t nodeBase = 0; // first node of the last published load, mesh nodes are relative to it until published
+	IndirectBuffer pendingIndirect; // uploading, guarded by pendingMutex
+	std::mutex pendingMutex;
+	IndirectBuffer indirect; // only touched by the thread that renders
+	bool collectIndirect = false; // set before a load starts, the loader appends a command per mesh
+	std::vector<VkDrawIndexedIndirectCommand> indirectCommands;
+	std::vector<Utils::AABB> indirectBounds; // bounds of the mesh of every command
+	FrustumCuller meshCuller; // model space bounds of meshes(node transform applied), box i is meshes[i]
+	std::vector<uint32_t> visibleMeshes;
+	std::vector<std::vector<uint32_t>> chunkVisibleMeshes; // CullMeshes scratch, the visible meshes of every ParallelFor chunk
+	size_t transformedMeshCount = 0; // meshes whose draw data UpdateTransforms has written once
+	std::vector<uint32_t> movedMeshes; // UpdateTransforms scratch, meshes whose draw data needs the new world matrix
+	std::vector<VkBufferCopy> transformCopies; // UpdateTransforms scratch, one region per moved mesh
+	JobCounter loadJob; // the LoadModelAsync job
+	TextureDecoder* textureDecoder = nullptr; // set while ImportScene runs
 private:
-	void ProcessNode(const Renderer* renderer, aiNode* node, const aiScene* scene, const std::string& path);
-	Mesh ProcessMesh(const Renderer* renderer, aiMesh* mesh, const aiScene* scene, const std::string& path);
-	int TestLoadMaterialTexture(const Renderer* renderer, aiMaterial * mat, const std::string& path, bool sRGB, bool genMipmap = true);
+	void LoadFromCache(const Renderer* renderer, const MeshCache::Reader& cache, UploadBatch& batch, const std::function<void(Mesh&&)>& addMesh);
+	void CollectTexturePaths(aiNode* node, const aiScene* scene, const std::string& path, std::vector<std::string>& outPaths);
+	// addSceneGraph gets the nodes of the file before the first mesh, Mesh::node of every mesh indexes it
+	void ImportScene(const Renderer* renderer, const std::string& fn, UploadBatch& batch, const std::function<void(const SceneGraph&)>& addSceneGraph, const std::function<void(Mesh&&)>& addMesh);
+	void BuildSceneGraph(aiNode* node, uint32_t parent, SceneGraph& graph);
+	// visits nodes in the order BuildSceneGraph added them, nextNode is the index of node
+	void ProcessNode(const Renderer* renderer, aiNode* node, const aiScene* scene, const std::string& path, UploadBatch& batch, uint32_t& nextNode, const std::function<void(Mesh&&)>& addMesh);
+	Mesh ProcessMesh(const Renderer* renderer, aiMesh* mesh, const aiScene* scene, const std::string& path, UploadBatch& batch);
+	// uploads indirectCommands(and indirectBounds with gpu culling) through batch. call before the batch's last Submit.
+	IndirectBuffer CreateIndirectBuffer(UploadBatch& batch);
+	void DestroyIndirectBuffer(IndirectBuffer& indirectBuffer);
+	// bindless mode : copies the material with bindless texture slots and world into Renderer::bindlessTable
+	void RegisterBindlessMaterial(Mesh& mesh, const glm::mat4& world);
+	int TestLoadMaterialTexture(const Renderer* renderer, aiMaterial * mat, const std::string& path, UploadBatch& batch, bool sRGB, bool genMipmap = true);
 };
 #endif // !1
\ No newline at end of file
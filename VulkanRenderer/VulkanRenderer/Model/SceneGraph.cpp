@@ -0,0 +1,142 @@
+#include "SceneGraph.hpp"
+#include <stdexcept>
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <cstdio>
+#include <glm/gtc/matrix_transform.hpp>
+
+void SceneGraph::Clear() {
+	localMatrices.clear();
+	worldMatrices.clear();
+	parents.clear();
+	subtreeSizes.clear();
+	dirtyFlags.clear();
+	names.clear();
+	dirtyNodes.clear();
+	updatedRanges.clear();
+}
+
+void SceneGraph::Reserve(size_t count) {
+	localMatrices.reserve(count);
+	worldMatrices.reserve(count);
+	parents.reserve(count);
+	subtreeSizes.reserve(count);
+	dirtyFlags.reserve(count);
+	names.reserve(count);
+}
+
+uint32_t SceneGraph::AddNode(uint32_t parent, const glm::mat4& local, const std::string& name) {
+	uint32_t node = static_cast<uint32_t>(Size());
+	//the parent's subtree has to end here, or the new node would split someone else's range
+	if (parent != NO_NODE && GetSubtreeEnd(parent) != node) {
+		throw std::runtime_error("scene graph nodes must be added depth first!");
+	}
+	for (uint32_t ancestor = parent; ancestor != NO_NODE; ancestor = parents[ancestor]) {
+		subtreeSizes[ancestor]++;
+	}
+	localMatrices.push_back(local);
+	worldMatrices.push_back(parent == NO_NODE ? local : worldMatrices[parent] * local);
+	parents.push_back(parent);
+	subtreeSizes.push_back(1);
+	dirtyFlags.push_back(0);
+	names.push_back(name);
+	return node;
+}
+
+uint32_t SceneGraph::Append(const SceneGraph& other) {
+	uint32_t base = static_cast<uint32_t>(Size());
+	localMatrices.insert(localMatrices.end(), other.localMatrices.begin(), other.localMatrices.end());
+	worldMatrices.insert(worldMatrices.end(), other.worldMatrices.begin(), other.worldMatrices.end());
+	for (uint32_t parent : other.parents) {
+		parents.push_back(parent == NO_NODE ? NO_NODE : parent + base);
+	}
+	subtreeSizes.insert(subtreeSizes.end(), other.subtreeSizes.begin(), other.subtreeSizes.end());
+	dirtyFlags.insert(dirtyFlags.end(), other.Size(), 0);
+	names.insert(names.end(), other.names.begin(), other.names.end());
+	for (uint32_t node : other.dirtyNodes) {
+		SetLocal(node + base, other.localMatrices[node]);
+	}
+	return base;
+}
+
+void SceneGraph::SetLocal(uint32_t node, const glm::mat4& local) {
+	localMatrices[node] = local;
+	if (dirtyFlags[node]) return;
+	dirtyFlags[node] = 1;
+	dirtyNodes.push_back(node);
+}
+
+const std::vector<SceneGraph::NodeRange>& SceneGraph::UpdateWorldMatrices() {
+	updatedRanges.clear();
+	if (dirtyNodes.empty()) return updatedRanges;
+	//parents sort before their children, so a dirty node inside a range already taken is skipped
+	std::sort(dirtyNodes.begin(), dirtyNodes.end());
+	uint32_t coveredEnd = 0;
+	for (uint32_t node : dirtyNodes) {
+		dirtyFlags[node] = 0;
+		if (node < coveredEnd) continue;
+		coveredEnd = GetSubtreeEnd(node);
+		if (!updatedRanges.empty() && updatedRanges.back().last == node) updatedRanges.back().last = coveredEnd;
+		else updatedRanges.push_back({ node, coveredEnd });
+	}
+	dirtyNodes.clear();
+	//a parent is either earlier in the same range or outside of every range and already up to date
+	for (const NodeRange& range : updatedRanges) {
+		for (uint32_t i = range.first; i < range.last; i++) {
+			uint32_t parent = parents[i];
+			worldMatrices[i] = parent == NO_NODE ? localMatrices[i] : worldMatrices[parent] * localMatrices[i];
+		}
+	}
+	return updatedRanges;
+}
+
+uint32_t SceneGraph::FindNode(const std::string& name) const {
+	auto it = std::find(names.begin(), names.end(), name);
+	return it == names.end() ? NO_NODE : static_cast<uint32_t>(it - names.begin());
+}
+
+void SceneGraph::RunBenchmark(size_t nodeCount, int frames) {
+	//random depth first tree : every node hangs under the previous node or one of its ancestors
+	std::mt19937 random(1234);
+	SceneGraph graph;
+	graph.Reserve(nodeCount);
+	std::vector<uint32_t> path;
+	for (size_t i = 0; i < nodeCount; i++) {
+		size_t pop = path.empty() ? 0 : random() % (path.size() + 1);
+		path.resize(path.size() - std::min(pop, path.size()));
+		uint32_t parent = path.empty() ? NO_NODE : path.back();
+		glm::mat4 local = glm::translate(glm::mat4(1.0f), glm::vec3(1.0f, 0.0f, 0.0f));
+		path.push_back(graph.AddNode(parent, local));
+	}
+
+	glm::mat4 rotation = glm::rotate(glm::mat4(1.0f), 0.01f, glm::vec3(0.0f, 1.0f, 0.0f));
+	std::uniform_int_distribution<uint32_t> pickNode(0, static_cast<uint32_t>(nodeCount - 1));
+	for (uint32_t moved : { 0u, 10u, 100u, 1000u }) {
+		size_t updatedNodes = 0;
+		auto begin = std::chrono::high_resolution_clock::now();
+		for (int frame = 0; frame < frames; frame++) {
+			for (uint32_t i = 0; i < moved; i++) {
+				uint32_t node = pickNode(random);
+				graph.SetLocal(node, graph.GetLocal(node) * rotation);
+			}
+			for (const NodeRange& range : graph.UpdateWorldMatrices()) {
+				updatedNodes += range.last - range.first;
+			}
+		}
+		std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - begin;
+		printf("Scene graph : %zu nodes, %4u moved per frame -> %8.1f nodes updated, %.4f ms per frame\n",
+			nodeCount, moved, static_cast<double>(updatedNodes) / frames, elapsed.count() / frames);
+	}
+	//everything moved, the cost of a full update
+	auto begin = std::chrono::high_resolution_clock::now();
+	for (int frame = 0; frame < frames; frame++) {
+		graph.SetLocal(0, graph.GetLocal(0) * rotation);
+		for (uint32_t root = graph.GetSubtreeEnd(0); root < nodeCount; root = graph.GetSubtreeEnd(root)) {
+			graph.SetLocal(root, graph.GetLocal(root) * rotation);
+		}
+		graph.UpdateWorldMatrices();
+	}
+	std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - begin;
+	printf("Scene graph : %zu nodes, all moved -> %.4f ms per frame\n", nodeCount, elapsed.count() / frames);
+}
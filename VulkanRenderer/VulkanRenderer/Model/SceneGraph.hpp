@@ -0,0 +1,57 @@
+#pragma once
+#ifndef SCENEGRAPH_HPP
+#define SCENEGRAPH_HPP
+#include <glm/glm.hpp>
+#include <vector>
+#include <string>
+#include <cstdint>
+
+// transform hierarchy stored flat in depth first order : parents come before children and
+// the subtree of node i is the range [i, GetSubtreeEnd(i)).
+// every property lives in its own array(local, world, parent, subtree size, dirty flag).
+// SetLocal only marks the node, UpdateWorldMatrices recomputes the marked subtrees in one linear pass each,
+// so a frame costs what moved, not the size of the graph.
+class SceneGraph {
+public:
+	static const uint32_t NO_NODE = UINT32_MAX;
+	struct NodeRange {
+		uint32_t first;
+		uint32_t last; // exclusive
+	};
+
+	void Clear();
+	void Reserve(size_t count);
+	// nodes must be added depth first : parent is NO_NODE or the last added node or one of its ancestors.
+	// throws otherwise. the world matrix is valid right away.
+	uint32_t AddNode(uint32_t parent, const glm::mat4& local, const std::string& name = "");
+	// appends other's nodes as new roots and returns the index of its first node. other's world matrices are taken as they are.
+	uint32_t Append(const SceneGraph& other);
+
+	void SetLocal(uint32_t node, const glm::mat4& local);
+	// recomputes every subtree changed since the last call. returns the changed node ranges, sorted and valid until the next call
+	const std::vector<NodeRange>& UpdateWorldMatrices();
+
+	size_t Size() const { return parents.size(); }
+	uint32_t GetParent(uint32_t node) const { return parents[node]; }
+	uint32_t GetSubtreeEnd(uint32_t node) const { return node + subtreeSizes[node]; }
+	const glm::mat4& GetLocal(uint32_t node) const { return localMatrices[node]; }
+	// as of the last UpdateWorldMatrices
+	const glm::mat4& GetWorld(uint32_t node) const { return worldMatrices[node]; }
+	const std::string& GetName(uint32_t node) const { return names[node]; }
+	// first node named name, NO_NODE if there is none
+	uint32_t FindNode(const std::string& name) const;
+
+	// builds a graph of nodeCount nodes, moves a few subtrees per frame and prints the update cost
+	static void RunBenchmark(size_t nodeCount = 100000, int frames = 200);
+
+private:
+	std::vector<glm::mat4> localMatrices;
+	std::vector<glm::mat4> worldMatrices;
+	std::vector<uint32_t> parents;
+	std::vector<uint32_t> subtreeSizes; // including the node itself
+	std::vector<uint8_t> dirtyFlags;
+	std::vector<std::string> names;
+	std::vector<uint32_t> dirtyNodes;
+	std::vector<NodeRange> updatedRanges;
+};
+#endif // !SCENEGRAPH_HPP
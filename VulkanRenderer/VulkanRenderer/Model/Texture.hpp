@@ -7,146 +7,86 @@
 #include<stb_image.h>
 #include "Tools/Utils.hpp"
 #include "Renderer.h"
+#include "Tools/UploadBatch.hpp"
 
 using namespace std;
 
+struct DecodedImage {
+	void* pixels = nullptr; // always 4 channels(STBI_rgb_alpha), float channels for hdr. free with stbi_image_free.
+	int width = 0;
+	int height = 0;
+	int nChannels = 0;		// channels in the file
+	bool isHdr = false;
+};
+
 struct Texture{
 	uint32_t mipLevels = 1;
 	VkImage textureImage = VK_NULL_HANDLE;
 	VkImageView textureImageView = VK_NULL_HANDLE;
-	VkDeviceMemory textureImageMemory = VK_NULL_HANDLE;
+	MemoryAllocation textureImageMemory;
 	string path = "";
+	bool sRGB = false;
+	uint32_t bindlessSlot = UINT32_MAX; // slot of Renderer::bindlessTable, UINT32_MAX when bindless is off
 public:
 	Texture(const string& _path) :path(_path) {};
 
-	void create(const string& fn, bool sRGB = false, bool isHdr = false, bool genMipmap = true, VkImageTiling tiling = VK_IMAGE_TILING_OPTIMAL) {
+	// decodes and uploads fn. the texture is usable once the batch completes.
+	void create(const string& fn, UploadBatch& batch, bool sRGB = false, bool isHdr = false, bool genMipmap = true, VkImageTiling tiling = VK_IMAGE_TILING_OPTIMAL) {
+		DecodedImage image = Decode(fn, isHdr);
+		create(image, batch, sRGB, genMipmap, tiling);
+		stbi_image_free(image.pixels);
+	}
+
+	// records upload and mip generation of an image decoded by Decode() into batch. pixels are copied to staging memory, the caller frees them.
+	void create(const DecodedImage& image, UploadBatch& batch, bool sRGB = false, bool genMipmap = true, VkImageTiling tiling = VK_IMAGE_TILING_OPTIMAL) {
 		Renderer* renderer = Renderer::GetInstance();
 		if (renderer == nullptr) {
 			std::cout << "renderer instance is nullptr! please create renderer instance  calling GetInstance(GlfwWindow, rendererCustomFuncs)!";
 			return;
 		}
-		void* buf = nullptr;
-		int width = 0, height = 0, nChannels = 0;
-		//4ä̹ ƴϸ 4äη   1äΰ 3ä STBI_rgb_alpha  Ǵµ 2ä  ߰
-		stbi_set_flip_vertically_on_load(true);
-		if (isHdr) {
-			buf = (float*)stbi_loadf(fn.c_str(), &width, &height, &nChannels, STBI_rgb_alpha);
-		}
-		else {
-			buf = (unsigned char*)stbi_load(fn.c_str(), &width, &height, &nChannels, STBI_rgb_alpha);
-		}
-
-		if (buf) {
-			cout << fn << " image load success! width : " << width << " height : " << height << " channels : " << nChannels << std::endl;
-		}
-		else {
-			throw std::runtime_error("failed to load texture image!");
-		}
+		this->sRGB = sRGB;
+		int width = image.width, height = image.height, nChannels = image.nChannels;
+		bool isHdr = image.isHdr;
 		VkFormat format = GetTextureFormat(sRGB, isHdr, nChannels);
 		mipLevels = genMipmap ? static_cast<uint32_t>(std::floor(std::log2(std::max(width, height)))) + 1 : 1;
 		
-		VkDeviceSize imageSize = width * height * 4;
-		//staging buffer
-		VkBuffer stagingBuffer;
-		VkDeviceMemory stagingBufferMemory;
-		Utils::CreateBuffer(renderer->device, renderer->physicalDevice, imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, 
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, 
-			stagingBuffer, stagingBufferMemory
-		);
-		void* data;
-		vkMapMemory(renderer->device, stagingBufferMemory, 0, imageSize, 0, &data);
-		memcpy(data, buf, static_cast<size_t>(imageSize));
-		vkUnmapMemory(renderer->device, stagingBufferMemory);
-		stbi_image_free(buf);
 		VkImageCreateInfo imageInfo = Initializer::InitImageCreateInfo(VK_IMAGE_TYPE_2D,static_cast<uint32_t>(width), static_cast<uint32_t>(height),1,mipLevels,format,tiling,
 			VK_IMAGE_USAGE_TRANSFER_SRC_BIT|VK_IMAGE_USAGE_TRANSFER_DST_BIT|VK_IMAGE_USAGE_SAMPLED_BIT);  //to generate mipmap add VK_IMAGE_USAGE_TRANSFER_SRC_BUT to usage flags
 		VkImageFormatProperties proper{};
 		VkResult result = vkGetPhysicalDeviceImageFormatProperties(renderer->physicalDevice, VK_FORMAT_R8G8_SRGB, VK_IMAGE_TYPE_2D, tiling, VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, 0, &proper);
-		Utils::CreateImage(renderer->device, renderer->physicalDevice, textureImage, textureImageMemory, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, imageInfo);
+		Utils::CreateImage(renderer->device, renderer->memoryAllocator, textureImage, textureImageMemory, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, imageInfo);
 		//to generate mipmap, change VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL to VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL.
-		Utils::transitionImageLayout(renderer->device, renderer->commandPool, renderer->graphicsQueue, textureImage, format, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, mipLevels);
-		copyBufferToImage(renderer->device, renderer->commandPool, renderer->graphicsQueue, stagingBuffer, textureImage, static_cast<uint32_t>(width), static_cast<uint32_t>(height));
-		generateMipmaps(renderer->device, renderer->commandPool, renderer->graphicsQueue, renderer->physicalDevice, textureImage, format, width, height, mipLevels);
-		vkDestroyBuffer(renderer->device, stagingBuffer, nullptr);
-		vkFreeMemory(renderer->device, stagingBufferMemory, nullptr);
+		batch.TransitionImageLayout(textureImage, format, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, mipLevels);
+		//stbi always returns 4 channels(STBI_rgb_alpha), float channels for hdr
+		batch.UploadImage(image.pixels, static_cast<uint32_t>(width), static_cast<uint32_t>(height), isHdr ? 16 : 4, textureImage);
+		batch.GenerateMipmaps(textureImage, format, width, height, mipLevels);
 
 		//create texture image view
 		textureImageView = Utils::CreateImageView(renderer->device, textureImage, format, VK_IMAGE_VIEW_TYPE_2D, VK_IMAGE_ASPECT_COLOR_BIT, mipLevels);
 	}
-private:
-inline void copyBufferToImage(VkDevice device, VkCommandPool commandPool, VkQueue submitQueue, VkBuffer buffer, VkImage image, uint32_t width, uint32_t height, uint32_t depth = 1) {
-		VkCommandBuffer commandbuffer = Utils::BeginSingleTimeCommand(device, commandPool);
-		VkBufferImageCopy region = Initializer::InitBufferImageCopy(0, 0, 0, VK_IMAGE_ASPECT_COLOR_BIT, { 0,0,0 }, { width,height,depth});
-		vkCmdCopyBufferToImage(
-			commandbuffer,
-			buffer,
-			image,
-			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-			1,
-			&region
-		);
-		Utils::EndSingleTimeCommand(device, commandPool, submitQueue, commandbuffer);
-	}
-
-inline void generateMipmaps(VkDevice device, VkCommandPool commandPool, VkQueue submitQueue, VkPhysicalDevice physicalDevice ,VkImage image, VkFormat imageFormat,int32_t width, int32_t height, uint32_t mipLevels) {
-	VkFormatProperties formatProperties;
-	vkGetPhysicalDeviceFormatProperties(physicalDevice, imageFormat, &formatProperties);
-	if (!(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT)) {
-		throw std::runtime_error("texture image format dose not support linear bliting!");
-		//other way is resizing the image using stb_image_resize.
-	}
-	VkCommandBuffer commandBuffer = Utils::BeginSingleTimeCommand(device, commandPool);
 
-	VkImageMemoryBarrier barrier = Initializer::InitImageMemoryBarrier(image,VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,1);
-	int32_t mipWidth = width;
-	int32_t mipHeight = height;
+	// cpu only, safe to call from several threads at once.
+	static DecodedImage Decode(const string& fn, bool isHdr = false) {
+		DecodedImage image;
+		image.isHdr = isHdr;
+		//4ä̹ ƴϸ 4äη   1äΰ 3ä STBI_rgb_alpha  Ǵµ 2ä  ߰
+		stbi_set_flip_vertically_on_load_thread(true);
+		if (isHdr) {
+			image.pixels = stbi_loadf(fn.c_str(), &image.width, &image.height, &image.nChannels, STBI_rgb_alpha);
+		}
+		else {
+			image.pixels = stbi_load(fn.c_str(), &image.width, &image.height, &image.nChannels, STBI_rgb_alpha);
+		}
 
-	for (uint32_t i = 1; i < mipLevels; i++) {
-		barrier.subresourceRange.baseMipLevel = i - 1;
-		barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-		barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
-		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-		barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-		vkCmdPipelineBarrier(
-			commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
-			0, nullptr,
-			0, nullptr,
-			1, &barrier
-		);
-		VkImageBlit blit = Initializer::InitImageBlit({ 0,0,0 }, { mipWidth, mipHeight,1 }, { 0,0,0 }, {mipWidth > 1 ? mipWidth / 2 : 1, mipHeight > 1 ? mipHeight / 2 : 1 , 1},i - 1, i);
-		vkCmdBlitImage(commandBuffer,
-			image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-			image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-			1, &blit,
-			VK_FILTER_LINEAR
-		);
-		barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
-		barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-		barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-		vkCmdPipelineBarrier(commandBuffer,
-			VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
-			0, nullptr,
-			0, nullptr,
-			1, &barrier
-		);
-		if (mipWidth > 1) mipWidth /= 2;
-		if (mipHeight > 1) mipHeight /= 2;
+		if (image.pixels) {
+			cout << fn << " image load success! width : " << image.width << " height : " << image.height << " channels : " << image.nChannels << std::endl;
+		}
+		else {
+			throw std::runtime_error("failed to load texture image!");
+		}
+		return image;
 	}
-	barrier.subresourceRange.baseMipLevel = mipLevels - 1;
-	barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-	barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-	vkCmdPipelineBarrier(commandBuffer,
-		VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
-		0, nullptr,
-		0, nullptr,
-		1, &barrier
-	);
-	Utils::EndSingleTimeCommand(device, commandPool, submitQueue, commandBuffer);
-}
-
+private:
 inline VkFormat GetTextureFormat(bool sRGB, bool isHdr, int nChannels) {
 	if (isHdr) {
 		switch (nChannels)
@@ -0,0 +1,95 @@
+#include "TextureDecoder.hpp"
+#include <algorithm>
+
+TextureDecoder::TextureDecoder(JobSystem& _jobSystem, const std::vector<std::string>& paths, bool _isHdr, uint32_t _maxInFlight) : jobSystem(&_jobSystem), isHdr(_isHdr) {
+	for (const std::string& path : paths) {
+		if (jobIndices.count(path) > 0) continue;
+		jobIndices[path] = jobs.size();
+		jobs.emplace_back();
+		jobs.back().path = path;
+	}
+	maxInFlight = _maxInFlight != 0 ? _maxInFlight : std::max<size_t>(2 * jobSystem->GetThreadCount(), 4);
+	std::lock_guard<std::mutex> lock(mutex);
+	ScheduleJobs();
+}
+
+TextureDecoder::~TextureDecoder() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	//jobs that didn't start yet see stopping and return, Decode doesn't throw
+	jobSystem->Wait(decodeJobs);
+	for (Job& job : jobs) {
+		if (job.state == JobState::Decoded && job.image.pixels) stbi_image_free(job.image.pixels);
+	}
+}
+
+void TextureDecoder::ScheduleJobs() {
+	//RunBackground decodes inline without workers, under our lock
+	if (jobSystem->GetWorkerCount() == 0) return;
+	while (!stopping && inFlight < maxInFlight && nextJob < jobs.size()) {
+		size_t jobIndex = nextJob++;
+		if (jobs[jobIndex].state != JobState::Queued) continue; // Take() decoded it already
+		jobs[jobIndex].scheduled = true;
+		inFlight++;
+		jobSystem->RunBackground([this, jobIndex]() { RunJob(jobIndex); }, &decodeJobs);
+	}
+}
+
+void TextureDecoder::RunJob(size_t jobIndex) {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (stopping || jobs[jobIndex].state != JobState::Queued) return; // Take() got to it first
+		jobs[jobIndex].state = JobState::Decoding;
+	}
+	Decode(jobIndex);
+}
+
+// called without the lock, the job is owned by the calling thread until it is marked decoded
+void TextureDecoder::Decode(size_t jobIndex) {
+	Job& job = jobs[jobIndex];
+	DecodedImage image;
+	std::exception_ptr error;
+	try {
+		image = Texture::Decode(job.path, isHdr);
+	}
+	catch (...) {
+		error = std::current_exception();
+	}
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		job.image = image;
+		job.error = error;
+		job.state = JobState::Decoded;
+	}
+	doneCondition.notify_all();
+}
+
+DecodedImage TextureDecoder::Take(const std::string& path) {
+	auto it = jobIndices.find(path);
+	if (it == jobIndices.end()) {
+		return Texture::Decode(path, isHdr);
+	}
+	Job& job = jobs[it->second];
+	std::unique_lock<std::mutex> lock(mutex);
+	if (job.state == JobState::Taken) {
+		throw std::runtime_error("texture is already taken from the decoder!");
+	}
+	if (job.state == JobState::Queued) {
+		job.state = JobState::Decoding;
+		lock.unlock();
+		Decode(it->second);
+		lock.lock();
+	}
+	//a decoding job is running on a worker, so this wait always ends
+	doneCondition.wait(lock, [&job]() { return job.state == JobState::Decoded; });
+	job.state = JobState::Taken;
+	if (job.scheduled) {
+		inFlight--;
+		ScheduleJobs(); // a slot is free
+	}
+	lock.unlock();
+	if (job.error) std::rethrow_exception(job.error);
+	return job.image;
+}
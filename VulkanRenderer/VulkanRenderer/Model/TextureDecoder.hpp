@@ -0,0 +1,59 @@
+#pragma once
+#ifndef TEXTUREDECODER_HPP
+#define TEXTUREDECODER_HPP
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include "Texture.hpp"
+#include "Tools/JobSystem.hpp"
+
+// decodes image files as background jobs of the JobSystem.
+// files are decoded in the order they were added, which should be the order Take() asks for them.
+// at most maxInFlight images are decoding or waiting to be taken, so a big scene doesn't hold every texture in memory at once.
+// without workers nothing is decoded ahead, Take decodes on the calling thread.
+class TextureDecoder {
+public:
+	// maxInFlight 0 : two per job system thread, at least 4
+	TextureDecoder(JobSystem& _jobSystem, const std::vector<std::string>& paths, bool isHdr = false, uint32_t _maxInFlight = 0);
+	// waits for the decode jobs it started
+	~TextureDecoder();
+	TextureDecoder(const TextureDecoder& rhs) = delete;
+	TextureDecoder& operator=(const TextureDecoder& rhs) = delete;
+
+	bool Contains(const std::string& path) const { return jobIndices.count(path) > 0; }
+	// blocks until path is decoded. a file nobody picked up yet is decoded on the calling thread.
+	// rethrows decode errors. the caller frees the pixels with stbi_image_free.
+	DecodedImage Take(const std::string& path);
+	uint32_t GetMaxInFlight() const { return static_cast<uint32_t>(maxInFlight); }
+
+private:
+	enum class JobState { Queued, Decoding, Decoded, Taken };
+	struct Job {
+		std::string path;
+		JobState state = JobState::Queued;
+		bool scheduled = false; // handed to the job system, holds an in flight slot until taken
+		DecodedImage image;
+		std::exception_ptr error;
+	};
+	JobSystem* jobSystem = nullptr;
+	JobCounter decodeJobs;
+	std::vector<Job> jobs;
+	std::unordered_map<std::string, size_t> jobIndices;
+	bool isHdr = false;
+	size_t nextJob = 0;
+	size_t inFlight = 0;	// scheduled, not taken yet
+	size_t maxInFlight = 0;
+	bool stopping = false;
+	std::mutex mutex;
+	std::condition_variable doneCondition;	// Take waits for a job to finish
+
+private:
+	// called with the lock held
+	void ScheduleJobs();
+	void RunJob(size_t jobIndex);
+	void Decode(size_t jobIndex);
+};
+#endif // !TEXTUREDECODER_HPP
@@ -14,11 +14,19 @@ bool Renderer::isInitialized = false;
 Renderer::Renderer(GLFWwindow* wd, RendererCustomFuncs* funcs) : window(wd) {
 	glfwSetWindowUserPointer(window, this);
 	glfwSetFramebufferSizeCallback(window, FramebufferResizeCallback);
+	int width, height;
+	glfwGetFramebufferSize(window, &width, &height);
+	framebufferWidth = width;
+	framebufferHeight = height;
 	if (funcs->checkSuitableDeviceFunc != nullptr) checkSuitableDeviceFunc = funcs->checkSuitableDeviceFunc;
 	if (funcs->setPhysicalDeviceFeaturesFunc != nullptr) setPhysicalDeviceFeaturesFunc = funcs->setPhysicalDeviceFeaturesFunc;
 	checkSwapPresentModeFunc = funcs->checkSwapPresentModeFunc;
 	checkSwapSurfaceFormatFunc = funcs->checkSwapSurfaceFormatFunc;
 	renderFunc = funcs->renderFunc;
+	bindlessRequested = funcs->enableBindless;
+	gpuCullingRequested = funcs->enableGpuCulling;
+	shaderHotReload = funcs->enableShaderHotReload;
+	instancingRequested = funcs->enableInstancing;
 	Init();
 	if (rendererInstance == nullptr) {
 		rendererInstance = this;
@@ -43,21 +51,81 @@ Renderer* Renderer::GetInstance(GLFWwindow* window, RendererCustomFuncs* funcs)
 	else return rendererInstance;
 }
 void Renderer::Init() {
+	jobSystem.Init();
+	ShaderCompiler::GetInstance().Init("ShaderCache");
 	CreateVKinstance();
 	SetupDebugMessenger();
 	CreateSurface();
 	PickFirstPhysicalDevice();
 	CreateLogicalDevice();
+	memoryAllocator.Init(device, physicalDevice);
+	pipelineCache.Init(device, physicalDevice, PIPELINE_CACHE_PATH);
+	pipelineTable.Init(device, pipelineCache.Get());
+	pipelineManager.Init(jobSystem, pipelineTable, static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT));
+	shaderWatcher.Init();
 	CreateSwapChain();
 	CreateImageViews();
-	PipelineBuilder::CreateDefaultRenderPass(defaultRenderpass, device, physicalDevice, swapChainImageFormat);
+	PipelineBuilder::CreateDefaultRenderPass(defaultRenderpass, device, physicalDevice, swapChainImageFormat, gpuCullingSupported);
+	pipelineTable.RegisterRenderPass(defaultRenderpass, { swapChainImageFormat, findDepthFormat(physicalDevice), VK_SAMPLE_COUNT_1_BIT });
 	CreateDefaultDescriptorSetLayout();
 	CreateUniforBuffers();
 	CreateDescriptorPool();
 	CreateDescriptorSets();
 	CreateDefaultSampler();
-	PipelineBuilder::CreateDefaultGraphicsPipeline(defaultPipeline, defaultPipelineLayout, device, "DefaultVertexShader.spv", "DefaultFragmentShader.spv", defaultRenderpass, defaultDescriptorSetLayout);
+	std::vector<VkPushConstantRange> pushConstantRanges = { DrawPushConstants::GetRange() };
+	if (bindlessSupported) {
+		CreateBindlessTable();
+		std::vector<VkDescriptorSetLayout> setLayouts = { defaultDescriptorSetLayout, bindlessTable.GetLayout() };
+		PipelineBuilder::CreatePipelineLayout(defaultPipelineLayout, device, setLayouts, pushConstantRanges);
+		defaultPipelineDesc = GraphicsPipelineDesc();
+		defaultPipelineDesc.vsFilename = "BindlessVertexShader.vert";
+		defaultPipelineDesc.fsFilename = "BindlessFragmentShader.frag";
+		defaultPipelineDesc.renderPass = defaultRenderpass;
+		defaultPipelineDesc.layout = defaultPipelineLayout;
+		//a device with descriptor indexing can still draw the classic way when the bindless shaders don't build
+		try {
+			defaultPipeline = pipelineManager.RequestNow(defaultPipelineDesc);
+		}
+		catch (const std::exception& e) {
+			printf("failed to create the bindless pipeline, bindless materials disabled : %s\n", e.what());
+			vkDestroyPipelineLayout(device, defaultPipelineLayout, nullptr);
+			defaultPipelineLayout = VK_NULL_HANDLE;
+			bindlessTable.Destroy(memoryAllocator);
+			bindlessSupported = false;
+			indirectSupported = false;
+			gpuCullingSupported = false;
+			drawIndirectCountSupported = false;
+		}
+	}
+	std::vector<VkDescriptorSetLayout> setLayouts = { defaultDescriptorSetLayout };
+	if (bindlessSupported) setLayouts.push_back(bindlessTable.GetLayout());
+	else {
+		PipelineBuilder::CreatePipelineLayout(defaultPipelineLayout, device, setLayouts, pushConstantRanges);
+		defaultPipelineDesc = GraphicsPipelineDesc();
+		defaultPipelineDesc.vsFilename = "DefaultVertexShader.vert";
+		defaultPipelineDesc.fsFilename = "DefaultFragmentShader.frag";
+		defaultPipelineDesc.renderPass = defaultRenderpass;
+		defaultPipelineDesc.layout = defaultPipelineLayout;
+		defaultPipeline = pipelineManager.RequestNow(defaultPipelineDesc);
+	}
+	if (instancingRequested) {
+		PipelineBuilder::CreatePipelineLayout(instancedPipelineLayout, device, setLayouts, pushConstantRanges);
+		GraphicsPipelineDesc instancedDesc = defaultPipelineDesc;
+		instancedDesc.vsFilename = "InstancedVertexShader.vert";
+		instancedDesc.layout = instancedPipelineLayout;
+		instancedDesc.instanced = true;
+		instancedPipeline = pipelineManager.Request(instancedDesc);
+	}
+	if (gpuCullingSupported) {
+		hiZ.Init(device, pipelineManager);
+		cullingPass.Init(device, hiZ, drawIndirectCountSupported, pipelineManager);
+	}
 	CreateCommandPool();
+	parallelRecorder.Init(device, queueFamilies.graphicsFamily.value(), static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT), jobSystem);
+	stagingRing.Init(device, memoryAllocator);
+	std::vector<uint32_t> geometryQueueFamilies = { queueFamilies.graphicsFamily.value() };
+	if (queueFamilies.transferFamily != queueFamilies.graphicsFamily) geometryQueueFamilies.push_back(queueFamilies.transferFamily.value());
+	geometryPool.Init(device, memoryAllocator, geometryQueueFamilies, sizeof(Vertex));
 	CreateDepthResources();
 	CreateFramebuffers();
 	CreateCommandBuffers();
@@ -65,8 +133,39 @@ void Renderer::Init() {
 	isInitialized = true;
 }
 void Renderer::Clean() {
+	{
+		//loader threads may still have uploads in flight, nothing below may be in use by the gpu
+		std::lock_guard<std::mutex> lock(queueMutex);
+		vkDeviceWaitIdle(device);
+	}
 	DestroyDebugUtilsMessengerEXT(instance, debugMessenger, nullptr);
 	CleanUpSwapChain();
+	stagingRing.Destroy(memoryAllocator);
+	geometryPool.PrintStats();
+	geometryPool.Destroy(memoryAllocator);
+	if (bindlessTable.IsEnabled()) bindlessTable.PrintStats();
+	bindlessTable.Destroy(memoryAllocator);
+	uniformRing.PrintStats();
+	uniformRing.Destroy(memoryAllocator);
+	transformRing.PrintStats();
+	transformRing.Destroy(memoryAllocator);
+	instanceRing.PrintStats();
+	instanceRing.Destroy(memoryAllocator);
+	parallelRecorder.PrintStats();
+	parallelRecorder.Destroy();
+	pipelineManager.PrintStats();
+	pipelineManager.Destroy();
+	pipelineTable.PrintStats();
+	pipelineTable.Destroy();
+	ShaderCompiler::GetInstance().PrintStats();
+	jobSystem.Shutdown();
+	cullingPass.Destroy();
+	hiZ.Destroy();
+	if (!pipelineCache.Save()) printf("failed to save pipeline cache %s\n", PIPELINE_CACHE_PATH);
+	pipelineCache.PrintStats();
+	pipelineCache.Destroy();
+	memoryAllocator.PrintStats();
+	memoryAllocator.Destroy();
 	vkDestroyInstance(instance, nullptr);
 }
 
@@ -77,7 +176,12 @@ void Renderer::CreateVKinstance() {
 	appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
 	appInfo.pEngineName = "DonghoEngine";
 	appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-	appInfo.apiVersion = VK_API_VERSION_1_0;
+	//1.2 where the loader has it(timeline semaphores, descriptor indexing), the 1.0 loader lacks vkEnumerateInstanceVersion
+	uint32_t loaderVersion = VK_API_VERSION_1_0;
+	auto enumerateInstanceVersion = reinterpret_cast<PFN_vkEnumerateInstanceVersion>(vkGetInstanceProcAddr(nullptr, "vkEnumerateInstanceVersion"));
+	if (enumerateInstanceVersion != nullptr) enumerateInstanceVersion(&loaderVersion);
+	instanceApiVersion = std::min<uint32_t>(loaderVersion, VK_API_VERSION_1_2);
+	appInfo.apiVersion = instanceApiVersion;
 	
 	VkInstanceCreateInfo createInfo{};
 	createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
@@ -159,7 +263,7 @@ void Renderer::PickFirstPhysicalDevice() {
 	for (const auto& device : devices) {
 		if (IsDeviceSuitable(device)) {
 			physicalDevice = device;
-			//indices = FindQueueFamiles(physicalDevice, surface);
+			queueFamilies = FindQueueFamiles(physicalDevice, surface);
 			break;
 		}
 	}
@@ -169,10 +273,31 @@ void Renderer::PickFirstPhysicalDevice() {
 }
 
 void Renderer::CreateLogicalDevice() {
-	QueueFamilyIndices indices = FindQueueFamiles(physicalDevice, surface);
+	// a dedicated upload queue hands resources over to the graphics queue with a timeline semaphore, which needs 1.2.
+	// without it every upload goes to the graphics queue.
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+	VkPhysicalDeviceVulkan12Features supported12Features{};
+	supported12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+	if (std::min(properties.apiVersion, instanceApiVersion) >= VK_API_VERSION_1_2) {
+		VkPhysicalDeviceFeatures2 features2{};
+		features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+		features2.pNext = &supported12Features;
+		vkGetPhysicalDeviceFeatures2(physicalDevice, &features2);
+	}
+	bool dedicatedTransfer = queueFamilies.transferFamily != queueFamilies.graphicsFamily;
+	if (dedicatedTransfer && !supported12Features.timelineSemaphore) {
+		queueFamilies.transferFamily = queueFamilies.graphicsFamily;
+		dedicatedTransfer = false;
+	}
+	bindlessSupported = bindlessRequested && BindlessTable::IsSupported(supported12Features);
+	if (bindlessRequested) {
+		std::cout << (bindlessSupported ? "Bindless materials enabled\n" : "Descriptor indexing isn't supported, bindless materials disabled\n");
+	}
+	QueueFamilyIndices indices = queueFamilies;
 
 	std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
-	std::set<uint32_t> uniqueQueueFamiles = { indices.graphicsFamily.value(), indices.presentFamily.value() };
+	std::set<uint32_t> uniqueQueueFamiles = { indices.graphicsFamily.value(), indices.presentFamily.value(), indices.transferFamily.value() };
 	float queuePriority(1.0f);
 	for (uint32_t queueFamily : uniqueQueueFamiles) {
 		VkDeviceQueueCreateInfo queueCreateInfo{};
@@ -183,14 +308,43 @@ void Renderer::CreateLogicalDevice() {
 		queueCreateInfos.push_back(queueCreateInfo);
 	}
 
+	VkPhysicalDeviceFeatures supportedFeatures;
+	vkGetPhysicalDeviceFeatures(physicalDevice, &supportedFeatures);
+	indirectSupported = bindlessSupported && supportedFeatures.multiDrawIndirect && supportedFeatures.drawIndirectFirstInstance;
 	VkPhysicalDeviceFeatures deviceFeatures{  };
 	deviceFeatures.samplerAnisotropy = VK_TRUE;
+	if (indirectSupported) {
+		deviceFeatures.multiDrawIndirect = VK_TRUE;
+		deviceFeatures.drawIndirectFirstInstance = VK_TRUE;
+	}
+	//the hi-z pyramid samples the depth buffer
+	VkFormatProperties depthFormatProperties;
+	vkGetPhysicalDeviceFormatProperties(physicalDevice, findDepthFormat(physicalDevice), &depthFormatProperties);
+	gpuCullingSupported = gpuCullingRequested && indirectSupported && (depthFormatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT);
+	drawIndirectCountSupported = gpuCullingSupported && supported12Features.drawIndirectCount;
+	if (gpuCullingRequested) {
+		std::cout << (gpuCullingSupported ? "GPU culling enabled\n" : "Indirect draws aren't supported, GPU culling disabled\n");
+	}
 	setPhysicalDeviceFeaturesFunc(deviceFeatures);
 	VkDeviceCreateInfo createInfo{};
 	createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
 	createInfo.pQueueCreateInfos = queueCreateInfos.data();
 	createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
 	createInfo.pEnabledFeatures = &deviceFeatures;
+	VkPhysicalDeviceVulkan12Features enabled12Features{};
+	enabled12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+	if (dedicatedTransfer) {
+		enabled12Features.timelineSemaphore = VK_TRUE;
+		createInfo.pNext = &enabled12Features;
+	}
+	if (bindlessSupported) {
+		BindlessTable::EnableFeatures(enabled12Features);
+		createInfo.pNext = &enabled12Features;
+	}
+	if (drawIndirectCountSupported) {
+		enabled12Features.drawIndirectCount = VK_TRUE;
+		createInfo.pNext = &enabled12Features;
+	}
 	createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtension.size());
 	createInfo.ppEnabledExtensionNames = deviceExtension.data();
 
@@ -205,6 +359,8 @@ void Renderer::CreateLogicalDevice() {
 	}
 	vkGetDeviceQueue(device, indices.graphicsFamily.value(), 0, &graphicsQueue); //write 2024-08-15__03:10
 	vkGetDeviceQueue(device, indices.presentFamily.value(), 0, &presentQueue); //write 2024-08-15__03:56.
+	vkGetDeviceQueue(device, indices.transferFamily.value(), 0, &transferQueue);
+	std::cout << "Upload queue family : " << indices.transferFamily.value() << (indices.transferFamily == indices.graphicsFamily ? " (shared with graphics)\n" : "\n");
 	//In case the queue family are the same, two handles will most likely have the same value now.
 }
 
@@ -241,8 +397,7 @@ VkExtent2D Renderer::ChooseSwapExtent(const VkSurfaceCapabilitiesKHR& capabiliti
 		return capabilities.currentExtent;
 	}
 	else {
-		int width, height;
-		glfwGetFramebufferSize(window, &width, &height);
+		int width = framebufferWidth, height = framebufferHeight;
 
 		VkExtent2D actualExtent = {
 			static_cast<uint32_t>(width),
@@ -321,7 +476,7 @@ void Renderer::CreateImageViews() {
 
 //custom yourself. if you add Descriptorset
 void Renderer::CreateDefaultDescriptorSetLayout() {
-	VkDescriptorSetLayoutBinding uboLayoutBinding = Initializer::InitDescriptorSetLayoutBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1, VK_SHADER_STAGE_VERTEX_BIT);
+	VkDescriptorSetLayoutBinding uboLayoutBinding = Initializer::InitDescriptorSetLayoutBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1, VK_SHADER_STAGE_VERTEX_BIT);
 	VkDescriptorSetLayoutBinding samplerLayoutBinding;
 	std::vector<VkDescriptorSetLayoutBinding> bindings = { uboLayoutBinding };
 	for (int i = 0; i < MAX_NUM_TEXTURE_BINDING; i++) {
@@ -338,7 +493,7 @@ void Renderer::CreateDefaultDescriptorSetLayout() {
 //custom yourself. if you add Descriptorset
 void Renderer::CreateDescriptorPool() {
 	std::vector<VkDescriptorPoolSize> poolSizes(1);
-	poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
 	poolSizes[0].descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
 	for (int i = 0; i < MAX_NUM_TEXTURE_BINDING; i++) {
 		poolSizes.emplace_back();
@@ -362,25 +517,21 @@ void Renderer::CreateDescriptorSets() {
 	}
 	// update descriptorset code
 	for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-		VkDescriptorBufferInfo bufferInfo = Initializer::InitDescriptorBufferInfo(uniformBuffers[i], sizeof(UniformBufferObject), 0);
+		//the dynamic offset picks the slice of the ring, the descriptor never changes
+		VkDescriptorBufferInfo bufferInfo = Initializer::InitDescriptorBufferInfo(uniformRing.GetBuffer(), sizeof(UniformBufferObject), 0);
 		std::array<VkWriteDescriptorSet, 1> descriptorWrites;
-		descriptorWrites[0] = Initializer::InitWriteDescriptorSet(descriptorSets[i], 0, 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1, &bufferInfo);
+		descriptorWrites[0] = Initializer::InitWriteDescriptorSet(descriptorSets[i], 0, 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1, &bufferInfo);
 		
 		vkUpdateDescriptorSets(device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
 	}
 }
 
 void Renderer::CreateUniforBuffers() {
-	VkDeviceSize buffersize = sizeof(UniformBufferObject);
-	uniformBuffers.resize(MAX_FRAMES_IN_FLIGHT);
-	uniformBuffersMemory.resize(MAX_FRAMES_IN_FLIGHT);
-	uniformBuffersMapped.resize(MAX_FRAMES_IN_FLIGHT);
-
-	for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-		CreateBuffer(device, physicalDevice, buffersize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, uniformBuffers[i], uniformBuffersMemory[i]);
-		vkMapMemory(device, uniformBuffersMemory[i], 0, buffersize, 0, &uniformBuffersMapped[i]); //persistent mapping
-	}
+	//persistent mapping, the allocator maps host visible blocks once
+	uniformRing.Init(device, physicalDevice, memoryAllocator, static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT));
+	//room for every node of a 128k node scene moving in the same frame
+	transformRing.Init(device, physicalDevice, memoryAllocator, static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT), 8ull * 1024 * 1024, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, "Transform ring");
+	instanceRing.Init(device, physicalDevice, memoryAllocator, static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT), 4ull * 1024 * 1024, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, "Instance ring");
 }
 
 void Renderer::CreateDefaultSampler() {
@@ -391,12 +542,31 @@ void Renderer::CreateDefaultSampler() {
 	SamplerBuilder::CreateSampler(device, defaultSampler, samplerInfo);
 }
 
+void Renderer::CreateBindlessTable() {
+	//a combined image sampler counts as a sampler and as a sampled image
+	VkPhysicalDeviceVulkan12Properties properties12{};
+	properties12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_PROPERTIES;
+	VkPhysicalDeviceProperties2 properties2{};
+	properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+	properties2.pNext = &properties12;
+	vkGetPhysicalDeviceProperties2(physicalDevice, &properties2);
+	uint32_t maxTextures = std::min({ MAX_BINDLESS_TEXTURES, properties12.maxPerStageDescriptorUpdateAfterBindSamplers,
+		properties12.maxPerStageDescriptorUpdateAfterBindSampledImages, properties12.maxDescriptorSetUpdateAfterBindSamplers,
+		properties12.maxDescriptorSetUpdateAfterBindSampledImages });
+	bindlessTable.Init(device, memoryAllocator, maxTextures);
+}
+
 void Renderer::CreateDepthResources() {
 	VkFormat depthFormat = findDepthFormat(physicalDevice);
-	VkImageCreateInfo imageInfo =  Initializer::InitImageCreateInfo(VK_IMAGE_TYPE_2D, swapChainExtent.width, swapChainExtent.height, 1, 1, depthFormat, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT);
-	CreateImage(device, physicalDevice, depthImage, depthImageMemory, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, imageInfo);
+	VkImageUsageFlags usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+	if (hiZ.IsEnabled()) usage |= VK_IMAGE_USAGE_SAMPLED_BIT;
+	VkImageCreateInfo imageInfo =  Initializer::InitImageCreateInfo(VK_IMAGE_TYPE_2D, swapChainExtent.width, swapChainExtent.height, 1, 1, depthFormat, VK_IMAGE_TILING_OPTIMAL, usage);
+	CreateImage(device, memoryAllocator, depthImage, depthImageMemory, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, imageInfo);
 	depthImageview = CreateImageView(device, depthImage, depthFormat, VK_IMAGE_VIEW_TYPE_2D, VK_IMAGE_ASPECT_DEPTH_BIT,1);
 	transitionImageLayout(device, commandPool, graphicsQueue, depthImage, depthFormat, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, 1);
+	if (hiZ.IsEnabled()) {
+		hiZ.CreateImages(memoryAllocator, commandPool, graphicsQueue, depthImage, depthImageview, depthFormat, swapChainExtent);
+	}
 }
 
 void Renderer::CreateFramebuffers() {
@@ -469,17 +639,29 @@ void Renderer::Render() {
 	vkResetFences(device, 1, &inFlightFences[currentFrame]); //Delay resetting the fence until after we know for sure we will be submitting work with it.
 
 	vkResetCommandBuffer(commandBuffers[currentFrame], 0);
+	uniformRing.BeginFrame(currentFrame); // the fence above guarantees the gpu is done with this frame's slices
+	transformRing.BeginFrame(currentFrame);
+	instanceRing.BeginFrame(currentFrame);
+	parallelRecorder.BeginFrame(currentFrame);
+	if (shaderHotReload && shaderWatcher.IsDue()) {
+		std::vector<std::string> changedFiles = shaderWatcher.Poll(ShaderCompiler::GetInstance().GetSourceFiles());
+		if (!changedFiles.empty()) pipelineManager.Reload(changedFiles);
+	}
+	pipelineManager.Update(frameNumber); // rebuilt pipelines are swapped in between frames
 	renderFunc(commandBuffers[currentFrame],swapChainFramebuffers[imageIdx],currentFrame);
 	//updateUniformBuiffer(currentframe);
 	VkSemaphore waitSemaphores[] = { imageAvailableSemaphores[currentFrame] };
 	VkPipelineStageFlags waitStage[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
 	VkSemaphore signalSemaphores[] = { renderFinishedSemaphores[currentFrame] };
 	VkSubmitInfo submitInfo = Initializer::InitSubmitInfo(1, waitSemaphores,waitStage,1, &commandBuffers[currentFrame], 1, signalSemaphores);
-	if (vkQueueSubmit(graphicsQueue, 1, &submitInfo, inFlightFences[currentFrame]) != VK_SUCCESS) {
-		throw std::runtime_error("failed to submit draw command buffer!");
-	}
 	VkPresentInfoKHR presentInfo = Initializer::InitPresentInfo(1, signalSemaphores, 1, &swapChain, &imageIdx);
-	result = vkQueuePresentKHR(presentQueue, &presentInfo);
+	{
+		std::lock_guard<std::mutex> lock(queueMutex);
+		if (vkQueueSubmit(graphicsQueue, 1, &submitInfo, inFlightFences[currentFrame]) != VK_SUCCESS) {
+			throw std::runtime_error("failed to submit draw command buffer!");
+		}
+		result = vkQueuePresentKHR(presentQueue, &presentInfo);
+	}
 	if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || framebufferResized) {
 		framebufferResized = false;
 		RecreateSwapChain();
@@ -488,6 +670,7 @@ void Renderer::Render() {
 		throw std::runtime_error("failed to present swap chain image!");
 	}
 	currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+	frameNumber++;
 }
 
 void Renderer::CleanUpSwapChain() {
@@ -497,9 +680,16 @@ void Renderer::CleanUpSwapChain() {
 	for (size_t i = 0; i < swapChainImageViews.size(); i++) {
 		vkDestroyImageView(device, swapChainImageViews[i], nullptr);
 	}
+	hiZ.DestroyImages(memoryAllocator);
+	if (depthImage != VK_NULL_HANDLE) {
+		vkDestroyImageView(device, depthImageview, nullptr);
+		DestroyImage(device, memoryAllocator, depthImage, depthImageMemory);
+	}
 	vkDestroySwapchainKHR(device, swapChain, nullptr);
 }
 void Renderer::RecreateSwapChain() {
+	//vkDeviceWaitIdle and the depth layout transition use every queue
+	std::lock_guard<std::mutex> lock(queueMutex);
 	vkDeviceWaitIdle(device);
 
 	CleanUpSwapChain();
@@ -510,13 +700,21 @@ void Renderer::RecreateSwapChain() {
 	CreateFramebuffers();
 }
 
-void Renderer::UpdateUniformBuffer(uint32_t currentFrame, Utils::UniformBufferObject& ubo) {
-	memcpy(uniformBuffersMapped[currentFrame], &ubo, sizeof(ubo));
+uint32_t Renderer::UpdateUniformBuffer(const Utils::UniformBufferObject& ubo) {
+	return uniformRing.Push(ubo);
+}
+
+PipelineHandle Renderer::RequestMaterialPipeline(uint32_t features) {
+	GraphicsPipelineDesc desc = defaultPipelineDesc;
+	desc.fragmentConstants = { features };
+	return pipelineManager.Request(desc, defaultPipeline);
 }
 
 #pragma region callback Function
 void Renderer::FramebufferResizeCallback(GLFWwindow* window, int width, int height) {
 	auto app = reinterpret_cast<Renderer*>(glfwGetWindowUserPointer(window));
+	app->framebufferWidth = width;
+	app->framebufferHeight = height;
 	app->framebufferResized = true;
 }
 #pragma endregion
\ No newline at end of file
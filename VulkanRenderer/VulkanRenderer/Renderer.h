@@ -5,13 +5,31 @@
 #include<vector>
 #include <stdexcept>
 #include <functional>
+#include <mutex>
+#include <atomic>
 #include "Tools/Utils.hpp"
+#include "Tools/StagingRing.hpp"
+#include "Tools/GeometryPool.hpp"
+#include "Tools/BindlessTable.hpp"
+#include "Tools/UniformRing.hpp"
+#include "Tools/HiZPyramid.hpp"
+#include "Tools/CullingPass.hpp"
+#include "Tools/ParallelRecorder.hpp"
+#include "Tools/JobSystem.hpp"
+#include "Tools/PipelineCache.hpp"
+#include "Tools/PipelineTable.hpp"
+#include "Tools/PipelineManager.hpp"
+#include "Tools/ShaderWatcher.hpp"
 struct RendererCustomFuncs {
 	std::function<bool(VkPhysicalDevice device)> checkSuitableDeviceFunc = nullptr;
 	std::function<void(VkPhysicalDeviceFeatures& deviceFeatures)> setPhysicalDeviceFeaturesFunc = nullptr;
 	std::function<bool(const VkSurfaceFormatKHR& availableFormat)>checkSwapSurfaceFormatFunc = nullptr;
 	std::function<bool(const VkPresentModeKHR& availableFormat)>checkSwapPresentModeFunc = nullptr;
 	std::function<void(VkCommandBuffer, VkFramebuffer, uint32_t)> renderFunc = nullptr;
+	bool enableBindless = false; // materials and textures through Renderer::bindlessTable. ignored when the device lacks descriptor indexing
+	bool enableGpuCulling = false; // frustum + hi-z culling of indirect draws(Model::Cull). needs indirect draws
+	bool enableShaderHotReload = false; // pipelines are rebuilt when one of their shader sources changes on disk
+	bool enableInstancing = false; // builds the instanced pipeline(Model::DrawInstanced), GetInstancedPipeline stays VK_NULL_HANDLE otherwise
 };
 
 class Renderer {
@@ -31,7 +49,24 @@ public:
 	VkDevice device = { VK_NULL_HANDLE };
 	VkQueue graphicsQueue = { VK_NULL_HANDLE };
 	VkQueue presentQueue = { VK_NULL_HANDLE };
+	VkQueue transferQueue = { VK_NULL_HANDLE }; // same as graphicsQueue when uploads can't run on a separate family
 	VkCommandPool commandPool = { VK_NULL_HANDLE };
+	Utils::QueueFamilyIndices queueFamilies;
+	std::mutex queueMutex; // lock when submitting to a queue outside of Render(). loaders submit from worker threads.
+	JobSystem jobSystem; // started first, the thread that creates the renderer is its main thread
+	MemoryAllocator memoryAllocator;
+	PipelineCache pipelineCache; // every pipeline is created through it, saved to PIPELINE_CACHE_PATH in Clean
+	PipelineTable pipelineTable; // every graphics pipeline, equal states share one VkPipeline
+	PipelineManager pipelineManager; // variants compiled as jobs, the default pipeline is the usual fallback
+	StagingRing stagingRing;
+	GeometryPool geometryPool; // vertex/index data of every mesh
+	BindlessTable bindlessTable; // only initialized in bindless mode
+	UniformRing uniformRing; // per frame constants. binding 0 of the default set reads it with a dynamic offset
+	UniformRing transformRing; // per frame world matrices Model::UpdateTransforms copies into the bindless draw data
+	UniformRing instanceRing; // per frame InstanceData, bound as vertex binding 1 of the instanced pipeline
+	HiZPyramid hiZ; // only initialized with gpu culling, rebuilt from the depth buffer after every frame
+	CullingPass cullingPass; // only initialized with gpu culling
+	ParallelRecorder parallelRecorder; // secondary command buffers of renderFunc recorded as jobs, reset per frame in flight
 	
 private:
 #ifdef NDEBUG
@@ -59,41 +94,72 @@ private:
 	VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
 	std::vector<VkDescriptorSet>descriptorSets;
 	VkSampler defaultSampler = VK_NULL_HANDLE;
-	VkPipeline defaultPipeline = { VK_NULL_HANDLE };
+	PipelineHandle defaultPipeline = NO_PIPELINE; // compiled before the first frame, the fallback of the other variants
+	GraphicsPipelineDesc defaultPipelineDesc; // MATERIAL_FEATURES_DYNAMIC, material variants copy it
 	VkPipelineLayout defaultPipelineLayout = { VK_NULL_HANDLE };
-	VkImage depthImage;
-	VkDeviceMemory depthImageMemory;
-	VkImageView depthImageview;
+	PipelineHandle instancedPipeline = NO_PIPELINE; // default pipeline + per instance vertex input, compiled in the background
+	VkPipelineLayout instancedPipelineLayout = { VK_NULL_HANDLE }; // same sets and push constants as the default layout
+	VkImage depthImage = VK_NULL_HANDLE;
+	MemoryAllocation depthImageMemory;
+	VkImageView depthImageview = VK_NULL_HANDLE;
 	std::vector<VkFramebuffer> swapChainFramebuffers;
 	std::vector<VkCommandBuffer> commandBuffers;
-	std::vector<VkBuffer> uniformBuffers;
-	std::vector<VkDeviceMemory> uniformBuffersMemory;
-	std::vector<void*> uniformBuffersMapped;
 	const int MAX_FRAMES_IN_FLIGHT = 2;
+	const char* PIPELINE_CACHE_PATH = "PipelineCache.bin";
 	const int MAX_NUM_TEXTURE_BINDING = 8;
+	const uint32_t MAX_BINDLESS_TEXTURES = 4096;
+	uint32_t instanceApiVersion = VK_API_VERSION_1_0; // min(loader version, 1.2), device features past it aren't used
+	bool bindlessRequested = false;
+	bool bindlessSupported = false;
+	bool indirectSupported = false; // multiDrawIndirect + drawIndirectFirstInstance
+	bool gpuCullingRequested = false;
+	bool instancingRequested = false;
+	bool shaderHotReload = false;
+	ShaderWatcher shaderWatcher;
+	uint64_t frameNumber = 0; // frames submitted so far, PipelineManager retires replaced pipelines by it
+	bool gpuCullingSupported = false; // indirect draws + a sampleable depth format
+	bool drawIndirectCountSupported = false; // culled draws are compacted instead of zeroed
 	uint32_t currentFrame = 0;
 	std::vector<VkSemaphore> imageAvailableSemaphores;
 	std::vector<VkSemaphore> renderFinishedSemaphores;
 	std::vector<VkFence> inFlightFences;
-	bool framebufferResized = false;
+	//written by the resize callback on the main thread, read by whichever thread calls Render
+	std::atomic<bool> framebufferResized{ false };
+	//glfwGetFramebufferSize may only be called on the main thread, the callback keeps a copy for the swap chain
+	std::atomic<int> framebufferWidth{ 0 };
+	std::atomic<int> framebufferHeight{ 0 };
 
 public:
 	void Init();
+	// call from one thread only, the main thread or a render thread. the main thread keeps polling GLFW events.
 	void Render();
 	void Clean();
 	static Renderer* GetInstance();
 	static Renderer* GetInstance(GLFWwindow* window, RendererCustomFuncs* funcs);
-	void UpdateUniformBuffer(uint32_t currentImage, Utils::UniformBufferObject& ubo);
+	// copies ubo into this frame's region of uniformRing. call from renderFunc and bind the default set with the returned dynamic offset.
+	uint32_t UpdateUniformBuffer(const Utils::UniformBufferObject& ubo);
 
 #pragma region Getter Functions
 	//Gettter Functions
-	const VkPipeline GetPipeline() const { return  defaultPipeline; }
+	const VkPipeline GetPipeline() const { return pipelineManager.Get(defaultPipeline); }
 	const VkPipelineLayout GetPipelineLayout() const { return defaultPipelineLayout; }
+	// the default pipeline specialized to a Material::GetFeatures() mask, compiled in the background with the default one
+	// as fallback. materials with the same mask share the pipeline. call from the thread that renders
+	PipelineHandle RequestMaterialPipeline(uint32_t features);
+	// for Model::DrawInstanced. the layout is compatible with the default one, bound sets stay valid across the switch
+	// VK_NULL_HANDLE until it's compiled, the vertex input differs so the default pipeline can't stand in
+	const VkPipeline GetInstancedPipeline() const { return pipelineManager.Get(instancedPipeline); }
+	const VkPipelineLayout GetInstancedPipelineLayout() const { return instancedPipelineLayout; }
 	const VkRenderPass GetRenderPass() const { return defaultRenderpass; }
 	const VkExtent2D GetSwapChainExtent() const { return swapChainExtent; }
 	const VkDescriptorSet GetDescriptorSet(uint32_t currentFrame) const { return isInitialized ? descriptorSets[currentFrame] : VK_NULL_HANDLE; }
 	const VkSampler GetDefaultSampler() const { return defaultSampler; }
-	const VkBuffer GetUniformBuffer(uint32_t currentFrame) const { return uniformBuffers[currentFrame]; }
+	// bind bindlessTable's set as set 1 and draw meshes with their material slot, no per draw descriptor writes.
+	const bool IsBindless() const { return bindlessTable.IsEnabled(); }
+	// a whole model in one vkCmdDrawIndexedIndirect(Model::DrawIndirect). needs bindless materials.
+	const bool SupportsIndirectDraw() const { return IsBindless() && indirectSupported; }
+	// record Model::Cull before the render pass and hiZ.Build after it
+	const bool SupportsGpuCulling() const { return SupportsIndirectDraw() && cullingPass.IsEnabled(); }
 #pragma endregion
 
 private:
@@ -122,6 +188,7 @@ private:
 	void CreateCommandBuffers();
 	void CreateSyncObject();
 	void CreateDefaultSampler();
+	void CreateBindlessTable();
 
 	bool checkDeviceExtensionSupport(VkPhysicalDevice device);
 	bool IsDeviceSuitable(VkPhysicalDevice device);
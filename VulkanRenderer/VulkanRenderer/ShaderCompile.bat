@@ -1,3 +0,0 @@
-C:\VulkanSDK\1.3.275.0\Bin\glslc.exe DefaultVertexShader.vert -o DefaultVertexShader.spv
-C:\VulkanSDK\1.3.275.0\Bin\glslc.exe DefaultFragmentShader.frag -o DefaultFragmentShader.spv
-pause
\ No newline at end of file
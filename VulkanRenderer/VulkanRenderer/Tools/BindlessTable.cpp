@@ -0,0 +1,132 @@
+#include "Tools/BindlessTable.hpp"
+#include "Tools/Utils.hpp"
+#include <stdexcept>
+#include <cstring>
+#include <cstdio>
+#include <array>
+
+bool BindlessTable::IsSupported(const VkPhysicalDeviceVulkan12Features& features) {
+	return features.runtimeDescriptorArray && features.descriptorBindingPartiallyBound && features.descriptorBindingVariableDescriptorCount &&
+		features.descriptorBindingSampledImageUpdateAfterBind && features.shaderSampledImageArrayNonUniformIndexing;
+}
+
+void BindlessTable::EnableFeatures(VkPhysicalDeviceVulkan12Features& features) {
+	features.runtimeDescriptorArray = VK_TRUE;
+	features.descriptorBindingPartiallyBound = VK_TRUE;
+	features.descriptorBindingVariableDescriptorCount = VK_TRUE;
+	features.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+	features.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+}
+
+void BindlessTable::Init(VkDevice _device, MemoryAllocator& allocator, uint32_t _maxTextures, uint32_t _maxMaterials, uint32_t _maxDraws) {
+	device = _device;
+	maxTextures = _maxTextures;
+	maxMaterials = _maxMaterials;
+	maxDraws = _maxDraws;
+
+	std::array<VkDescriptorSetLayoutBinding, 3> bindings;
+	bindings[0] = Initializer::InitDescriptorSetLayoutBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_FRAGMENT_BIT);
+	bindings[0].stageFlags |= VK_SHADER_STAGE_VERTEX_BIT;
+	bindings[1] = Initializer::InitDescriptorSetLayoutBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_VERTEX_BIT);
+	bindings[2] = Initializer::InitDescriptorSetLayoutBinding(2, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, maxTextures, VK_SHADER_STAGE_FRAGMENT_BIT);
+	//the variable count binding has to be the last one
+	std::array<VkDescriptorBindingFlags, 3> bindingFlags = { 0, 0,
+		VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT | VK_DESCRIPTOR_BINDING_VARIABLE_DESCRIPTOR_COUNT_BIT };
+	VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsInfo{};
+	bindingFlagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+	bindingFlagsInfo.bindingCount = static_cast<uint32_t>(bindingFlags.size());
+	bindingFlagsInfo.pBindingFlags = bindingFlags.data();
+	VkDescriptorSetLayoutCreateInfo layoutInfo = Initializer::InitDescriptorSetLayoutCreateInfo(static_cast<uint32_t>(bindings.size()), bindings.data());
+	layoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+	layoutInfo.pNext = &bindingFlagsInfo;
+	if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &layout) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create bindless descriptor set layout!");
+	}
+
+	std::array<VkDescriptorPoolSize, 2> poolSizes;
+	poolSizes[0].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	poolSizes[0].descriptorCount = 2;
+	poolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	poolSizes[1].descriptorCount = maxTextures;
+	VkDescriptorPoolCreateInfo poolInfo = Initializer::InitDescriptorPoolCreateInfo(static_cast<uint32_t>(poolSizes.size()), poolSizes.data(), 1);
+	if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &pool) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create bindless descriptor pool!");
+	}
+
+	VkDescriptorSetVariableDescriptorCountAllocateInfo variableCountInfo{};
+	variableCountInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_VARIABLE_DESCRIPTOR_COUNT_ALLOCATE_INFO;
+	variableCountInfo.descriptorSetCount = 1;
+	variableCountInfo.pDescriptorCounts = &maxTextures;
+	VkDescriptorSetAllocateInfo allocInfo = Initializer::InitDescriptorSetAllocateInfo(pool, 1, &layout);
+	allocInfo.pNext = &variableCountInfo;
+	if (vkAllocateDescriptorSets(device, &allocInfo, &descriptorSet) != VK_SUCCESS) {
+		throw std::runtime_error("failed to allocate bindless descriptor set!");
+	}
+
+	VkDeviceSize bufferSize = sizeof(Material) * maxMaterials;
+	Utils::CreateBuffer(device, allocator, bufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, materialBuffer, materialBufferMemory);
+	VkDeviceSize drawBufferSize = sizeof(Utils::DrawData) * maxDraws;
+	Utils::CreateBuffer(device, allocator, drawBufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, drawBuffer, drawBufferMemory);
+	std::array<VkDescriptorBufferInfo, 2> bufferInfos = {
+		Initializer::InitDescriptorBufferInfo(materialBuffer, bufferSize),
+		Initializer::InitDescriptorBufferInfo(drawBuffer, drawBufferSize)
+	};
+	std::array<VkWriteDescriptorSet, 2> writes;
+	for (uint32_t i = 0; i < writes.size(); i++) {
+		writes[i] = Initializer::InitWriteDescriptorSet(descriptorSet, i, 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, &bufferInfos[i]);
+	}
+	vkUpdateDescriptorSets(device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+}
+
+void BindlessTable::Destroy(MemoryAllocator& allocator) {
+	if (device == VK_NULL_HANDLE) return;
+	Utils::DestroyBuffer(device, allocator, materialBuffer, materialBufferMemory);
+	Utils::DestroyBuffer(device, allocator, drawBuffer, drawBufferMemory);
+	vkDestroyDescriptorPool(device, pool, nullptr);
+	vkDestroyDescriptorSetLayout(device, layout, nullptr);
+	descriptorSet = VK_NULL_HANDLE;
+	textureCount = 0;
+	materialCount = 0;
+	drawCount = 0;
+	device = VK_NULL_HANDLE;
+}
+
+uint32_t BindlessTable::AddTexture(VkImageView imageView, VkSampler sampler) {
+	std::lock_guard<std::mutex> lock(mutex);
+	if (textureCount == maxTextures) {
+		throw std::runtime_error("bindless texture table is full!");
+	}
+	uint32_t slot = textureCount++;
+	//the slot isn't referenced by any material yet, so writing it while the set is bound is fine
+	VkDescriptorImageInfo imageInfo = Initializer::InitDescriptorImageInfo(VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, imageView, sampler);
+	VkWriteDescriptorSet write = Initializer::InitWriteDescriptorSet(descriptorSet, 2, slot, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, nullptr, &imageInfo);
+	vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
+	return slot;
+}
+
+uint32_t BindlessTable::AddMaterial(const Material& material) {
+	std::lock_guard<std::mutex> lock(mutex);
+	if (materialCount == maxMaterials) {
+		throw std::runtime_error("bindless material table is full!");
+	}
+	uint32_t slot = materialCount++;
+	memcpy(static_cast<Material*>(materialBufferMemory.mapped) + slot, &material, sizeof(Material));
+	return slot;
+}
+
+uint32_t BindlessTable::AddDraw(const Utils::DrawData& draw) {
+	std::lock_guard<std::mutex> lock(mutex);
+	if (drawCount == maxDraws) {
+		throw std::runtime_error("bindless draw table is full!");
+	}
+	uint32_t slot = drawCount++;
+	memcpy(static_cast<Utils::DrawData*>(drawBufferMemory.mapped) + slot, &draw, sizeof(Utils::DrawData));
+	return slot;
+}
+
+void BindlessTable::PrintStats() {
+	std::lock_guard<std::mutex> lock(mutex);
+	printf("Bindless table : %u / %u texture(s), %u / %u material(s), %u / %u draw(s)\n", textureCount, maxTextures, materialCount, maxMaterials, drawCount, maxDraws);
+}
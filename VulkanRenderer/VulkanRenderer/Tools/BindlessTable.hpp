@@ -0,0 +1,61 @@
+#pragma once
+#ifndef BINDLESSTABLE_HPP
+#define BINDLESSTABLE_HPP
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+#include <vector>
+#include <mutex>
+#include <cstdint>
+#include "MemoryAllocator.hpp"
+#include "Model/Material.hpp"
+#include "Utils.hpp"
+
+// one descriptor set holding every material and every texture of the scene(bindless mode).
+// set = 1, binding = 0 : readonly buffer of Material, texture indices are slots of binding 2
+// set = 1, binding = 1 : readonly buffer of Utils::DrawData, indexed by the instance index of indirect draws
+// set = 1, binding = 2 : runtime sized sampler2D array, partially bound and written after bind
+// entries are written once when they are added, so the set is bound once per command buffer.
+// draw transforms change later on the gpu timeline only(vkCmdUpdateBuffer, see Model::UpdateTransforms).
+class BindlessTable {
+public:
+	// descriptor indexing features the table needs. chain into VkPhysicalDeviceFeatures2 / VkDeviceCreateInfo.
+	static bool IsSupported(const VkPhysicalDeviceVulkan12Features& features);
+	static void EnableFeatures(VkPhysicalDeviceVulkan12Features& features);
+
+	void Init(VkDevice _device, MemoryAllocator& allocator, uint32_t _maxTextures, uint32_t _maxMaterials = 4096, uint32_t _maxDraws = 16384);
+	void Destroy(MemoryAllocator& allocator);
+	bool IsEnabled() const { return device != VK_NULL_HANDLE; }
+
+	// thread safe. returns the index into textures[] of the shaders. throws when the table is full
+	uint32_t AddTexture(VkImageView imageView, VkSampler sampler);
+	// thread safe. texture indices of material must be slots returned by AddTexture, -1 for none.
+	// returns the index into materials[] of the shaders. throws when the table is full
+	uint32_t AddMaterial(const Material& material);
+	// thread safe. returns the index into draws[] of the shaders. throws when the table is full
+	uint32_t AddDraw(const Utils::DrawData& draw);
+
+	VkDescriptorSetLayout GetLayout() const { return layout; }
+	VkDescriptorSet GetDescriptorSet() const { return descriptorSet; }
+	// transfer dst, slot i at sizeof(Utils::DrawData) * i
+	VkBuffer GetDrawBuffer() const { return drawBuffer; }
+	void PrintStats();
+
+private:
+	VkDevice device = VK_NULL_HANDLE;
+	VkDescriptorSetLayout layout = VK_NULL_HANDLE;
+	VkDescriptorPool pool = VK_NULL_HANDLE;
+	VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+	VkBuffer materialBuffer = VK_NULL_HANDLE;
+	MemoryAllocation materialBufferMemory; // host visible, materials are written straight into the mapping
+	VkBuffer drawBuffer = VK_NULL_HANDLE;
+	MemoryAllocation drawBufferMemory; // host visible, a slot is written through the mapping once before its first use
+	uint32_t maxTextures = 0;
+	uint32_t maxMaterials = 0;
+	uint32_t maxDraws = 0;
+	uint32_t textureCount = 0;
+	uint32_t materialCount = 0;
+	uint32_t drawCount = 0;
+	std::mutex mutex; // vkUpdateDescriptorSets on the same set must be externally synchronized
+};
+#endif // !BINDLESSTABLE_HPP
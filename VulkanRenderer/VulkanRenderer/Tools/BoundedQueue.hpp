@@ -0,0 +1,72 @@
+#pragma once
+#ifndef BOUNDEDQUEUE_HPP
+#define BOUNDEDQUEUE_HPP
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <cstddef>
+
+// fixed capacity fifo between threads. Push blocks while it's full, Pop while it's empty.
+// Close wakes everyone : Push fails from then on, Pop drains what's left and then fails.
+template<typename T>
+class BoundedQueue {
+public:
+	explicit BoundedQueue(size_t _capacity = 2) : capacity(_capacity > 0 ? _capacity : 1) {}
+
+	// false when the queue was closed, item is dropped
+	bool Push(T&& item) {
+		std::unique_lock<std::mutex> lock(mutex);
+		notFull.wait(lock, [this]() { return closed || items.size() < capacity; });
+		return PushLocked(std::move(item), lock);
+	}
+	// gives up after timeout while full, item is left untouched then
+	template<typename Rep, typename Period>
+	bool TryPush(T& item, const std::chrono::duration<Rep, Period>& timeout) {
+		std::unique_lock<std::mutex> lock(mutex);
+		if (!notFull.wait_for(lock, timeout, [this]() { return closed || items.size() < capacity; })) return false;
+		return PushLocked(std::move(item), lock);
+	}
+	// false once the queue is closed and empty
+	bool Pop(T& outItem) {
+		std::unique_lock<std::mutex> lock(mutex);
+		notEmpty.wait(lock, [this]() { return closed || !items.empty(); });
+		if (items.empty()) return false;
+		outItem = std::move(items.front());
+		items.pop_front();
+		lock.unlock();
+		notFull.notify_one();
+		return true;
+	}
+	void Close() {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			closed = true;
+		}
+		notFull.notify_all();
+		notEmpty.notify_all();
+	}
+	bool IsClosed() {
+		std::lock_guard<std::mutex> lock(mutex);
+		return closed;
+	}
+	size_t GetCapacity() const { return capacity; }
+
+private:
+	const size_t capacity;
+	std::deque<T> items;
+	bool closed = false;
+	std::mutex mutex;
+	std::condition_variable notFull;
+	std::condition_variable notEmpty;
+
+private:
+	bool PushLocked(T&& item, std::unique_lock<std::mutex>& lock) {
+		if (closed) return false;
+		items.push_back(std::move(item));
+		lock.unlock();
+		notEmpty.notify_one();
+		return true;
+	}
+};
+#endif // !BOUNDEDQUEUE_HPP
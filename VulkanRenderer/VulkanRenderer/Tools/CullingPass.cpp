@@ -0,0 +1,151 @@
+#include "Tools/CullingPass.hpp"
+#include "Tools/HiZPyramid.hpp"
+#include "Tools/UploadBatch.hpp"
+#include "Tools/PipelineBuilder.hpp"
+#include <stdexcept>
+#include <array>
+
+void CullingPass::Init(VkDevice _device, const HiZPyramid& hiZ, bool _compact, PipelineManager& _pipelineManager, uint32_t maxDrawLists) {
+	device = _device;
+	compact = _compact;
+
+	std::array<VkDescriptorSetLayoutBinding, 5> bindings;
+	for (uint32_t i = 0; i < bindings.size(); i++) {
+		bindings[i] = Initializer::InitDescriptorSetLayoutBinding(i, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT);
+	}
+	VkDescriptorSetLayoutCreateInfo layoutInfo = Initializer::InitDescriptorSetLayoutCreateInfo(static_cast<uint32_t>(bindings.size()), bindings.data());
+	if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &layout) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create culling descriptor set layout!");
+	}
+
+	VkDescriptorPoolSize poolSize{};
+	poolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	poolSize.descriptorCount = static_cast<uint32_t>(bindings.size()) * maxDrawLists;
+	VkDescriptorPoolCreateInfo poolInfo = Initializer::InitDescriptorPoolCreateInfo(1, &poolSize, maxDrawLists);
+	poolInfo.flags |= VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
+	if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &pool) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create culling descriptor pool!");
+	}
+
+	VkPushConstantRange pushConstantRange{};
+	pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	pushConstantRange.offset = 0;
+	pushConstantRange.size = sizeof(PushConstants);
+	PipelineBuilder::CreatePipelineLayout(pipelineLayout, device, { hiZ.GetReadLayout(), layout }, { pushConstantRange });
+	pipelineManager = &_pipelineManager;
+	ComputePipelineDesc pipelineDesc;
+	pipelineDesc.csFilename = "Cull.comp";
+	pipelineDesc.layout = pipelineLayout;
+	pipeline = pipelineManager->RequestNow(pipelineDesc);
+}
+
+void CullingPass::Destroy() {
+	if (device == VK_NULL_HANDLE) return;
+	vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+	vkDestroyDescriptorPool(device, pool, nullptr);
+	vkDestroyDescriptorSetLayout(device, layout, nullptr);
+	device = VK_NULL_HANDLE;
+}
+
+CulledDrawList CullingPass::CreateDrawList(MemoryAllocator& allocator, UploadBatch& batch, VkBuffer indirectBuffer, const std::vector<Utils::AABB>& bounds, VkBuffer drawDataBuffer) {
+	CulledDrawList drawList;
+	if (bounds.empty()) return drawList;
+	drawList.drawCount = static_cast<uint32_t>(bounds.size());
+
+	//vec4 pairs, std430 pads vec3
+	std::vector<glm::vec4> packedBounds;
+	packedBounds.reserve(bounds.size() * 2);
+	for (const Utils::AABB& box : bounds) {
+		packedBounds.push_back(glm::vec4(box.min, 1.0f));
+		packedBounds.push_back(glm::vec4(box.max, 1.0f));
+	}
+	VkDeviceSize boundsSize = sizeof(glm::vec4) * packedBounds.size();
+	VkDeviceSize drawSize = sizeof(VkDrawIndexedIndirectCommand) * bounds.size();
+	Utils::CreateBuffer(device, allocator, boundsSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, drawList.boundsBuffer, drawList.boundsMemory);
+	batch.UploadBuffer(packedBounds.data(), boundsSize, drawList.boundsBuffer);
+	Utils::CreateBuffer(device, allocator, drawSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, drawList.drawBuffer, drawList.drawMemory);
+	Utils::CreateBuffer(device, allocator, sizeof(uint32_t), VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, drawList.countBuffer, drawList.countMemory);
+
+	VkDescriptorSetAllocateInfo allocInfo = Initializer::InitDescriptorSetAllocateInfo(pool, 1, &layout);
+	{
+		//vkAllocateDescriptorSets and vkFreeDescriptorSets need the pool externally synchronized
+		std::lock_guard<std::mutex> lock(poolMutex);
+		if (vkAllocateDescriptorSets(device, &allocInfo, &drawList.descriptorSet) != VK_SUCCESS) {
+			throw std::runtime_error("failed to allocate culling descriptor set!");
+		}
+	}
+	std::array<VkDescriptorBufferInfo, 5> bufferInfos = {
+		Initializer::InitDescriptorBufferInfo(indirectBuffer, drawSize),
+		Initializer::InitDescriptorBufferInfo(drawList.boundsBuffer, boundsSize),
+		Initializer::InitDescriptorBufferInfo(drawList.drawBuffer, drawSize),
+		Initializer::InitDescriptorBufferInfo(drawList.countBuffer, sizeof(uint32_t)),
+		Initializer::InitDescriptorBufferInfo(drawDataBuffer, VK_WHOLE_SIZE)
+	};
+	std::array<VkWriteDescriptorSet, 5> writes;
+	for (uint32_t i = 0; i < writes.size(); i++) {
+		writes[i] = Initializer::InitWriteDescriptorSet(drawList.descriptorSet, i, 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, &bufferInfos[i]);
+	}
+	vkUpdateDescriptorSets(device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+	return drawList;
+}
+
+void CullingPass::DestroyDrawList(MemoryAllocator& allocator, CulledDrawList& drawList) {
+	if (!drawList.IsValid()) return;
+	{
+		std::lock_guard<std::mutex> lock(poolMutex);
+		vkFreeDescriptorSets(device, pool, 1, &drawList.descriptorSet);
+	}
+	Utils::DestroyBuffer(device, allocator, drawList.boundsBuffer, drawList.boundsMemory);
+	Utils::DestroyBuffer(device, allocator, drawList.drawBuffer, drawList.drawMemory);
+	Utils::DestroyBuffer(device, allocator, drawList.countBuffer, drawList.countMemory);
+	drawList = CulledDrawList{};
+}
+
+void CullingPass::Cull(VkCommandBuffer commandBuffer, const HiZPyramid& hiZ, const CulledDrawList& drawList, const glm::mat4& viewProjModel) {
+	//the draws of the last frame that used this list are done reading it, and its culling writes are done before they are overwritten
+	VkMemoryBarrier reuseBarrier{};
+	reuseBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	reuseBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	reuseBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		0, 1, &reuseBarrier, 0, nullptr, 0, nullptr);
+	if (compact) {
+		vkCmdFillBuffer(commandBuffer, drawList.countBuffer, 0, sizeof(uint32_t), 0);
+		VkMemoryBarrier clearBarrier{};
+		clearBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		clearBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		clearBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &clearBarrier, 0, nullptr, 0, nullptr);
+	}
+
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineManager->Get(pipeline));
+	VkDescriptorSet descriptorSets[] = { hiZ.GetReadDescriptorSet(), drawList.descriptorSet };
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 2, descriptorSets, 0, nullptr);
+	PushConstants pushConstants{};
+	pushConstants.viewProjModel = viewProjModel;
+	pushConstants.depthSize[0] = hiZ.GetDepthExtent().width;
+	pushConstants.depthSize[1] = hiZ.GetDepthExtent().height;
+	pushConstants.drawCount = drawList.drawCount;
+	pushConstants.hiZLevels = hiZ.GetLevelCount();
+	pushConstants.compact = compact ? 1 : 0;
+	vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(pushConstants), &pushConstants);
+	vkCmdDispatch(commandBuffer, (drawList.drawCount + 63) / 64, 1, 1);
+
+	VkMemoryBarrier cullBarrier{};
+	cullBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	cullBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	cullBarrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, 0, 1, &cullBarrier, 0, nullptr, 0, nullptr);
+}
+
+void CullingPass::Draw(VkCommandBuffer commandBuffer, const CulledDrawList& drawList) {
+	if (compact) {
+		vkCmdDrawIndexedIndirectCount(commandBuffer, drawList.drawBuffer, 0, drawList.countBuffer, 0, drawList.drawCount, sizeof(VkDrawIndexedIndirectCommand));
+	}
+	else {
+		vkCmdDrawIndexedIndirect(commandBuffer, drawList.drawBuffer, 0, drawList.drawCount, sizeof(VkDrawIndexedIndirectCommand));
+	}
+}
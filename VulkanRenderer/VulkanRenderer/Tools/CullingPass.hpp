@@ -0,0 +1,71 @@
+#pragma once
+#ifndef CULLINGPASS_HPP
+#define CULLINGPASS_HPP
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+#include <glm/glm.hpp>
+#include <vector>
+#include <mutex>
+#include <cstdint>
+#include "MemoryAllocator.hpp"
+#include "PipelineManager.hpp"
+#include "Utils.hpp"
+
+class UploadBatch;
+class HiZPyramid;
+
+// gpu output of one indirect command buffer. created by CullingPass::CreateDrawList, owned by the caller
+struct CulledDrawList {
+	VkBuffer boundsBuffer = VK_NULL_HANDLE; // mesh space AABB per command, vec4 min, vec4 max
+	MemoryAllocation boundsMemory;
+	VkBuffer drawBuffer = VK_NULL_HANDLE; // surviving commands
+	MemoryAllocation drawMemory;
+	VkBuffer countBuffer = VK_NULL_HANDLE; // number of surviving commands(compacted mode only)
+	MemoryAllocation countMemory;
+	VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+	uint32_t drawCount = 0; // commands of the source buffer
+	bool IsValid() const { return descriptorSet != VK_NULL_HANDLE; }
+};
+
+// compute pass that tests every command of an indirect buffer against the frustum and the hi-z pyramid of the last frame.
+// with drawIndirectCount the survivors are compacted and drawn with vkCmdDrawIndexedIndirectCount,
+// otherwise culled commands keep their slot with instanceCount 0.
+// the pyramid holds last frame's depth but is tested with this frame's matrices, fast camera moves can pop for a frame.
+class CullingPass {
+public:
+	// the pipeline comes from pipelineManager, which rebuilds it on hot reload and releases it in its Destroy
+	void Init(VkDevice _device, const HiZPyramid& hiZ, bool _compact, PipelineManager& _pipelineManager, uint32_t maxDrawLists = 256);
+	void Destroy();
+	bool IsEnabled() const { return device != VK_NULL_HANDLE; }
+	bool IsCompacting() const { return compact; }
+
+	// indirectBuffer needs VK_BUFFER_USAGE_STORAGE_BUFFER_BIT and bounds one entry per command.
+	// bounds are in mesh space and moved by the Utils::DrawData of drawDataBuffer the command's firstInstance points at.
+	// bounds are uploaded through batch, call before the batch's last Submit. thread safe with DestroyDrawList.
+	CulledDrawList CreateDrawList(MemoryAllocator& allocator, UploadBatch& batch, VkBuffer indirectBuffer, const std::vector<Utils::AABB>& bounds, VkBuffer drawDataBuffer);
+	void DestroyDrawList(MemoryAllocator& allocator, CulledDrawList& drawList);
+
+	// record outside of a render pass, before the draws that use drawList.
+	void Cull(VkCommandBuffer commandBuffer, const HiZPyramid& hiZ, const CulledDrawList& drawList, const glm::mat4& viewProjModel);
+	// record inside the render pass with the push constants of the draw already set
+	void Draw(VkCommandBuffer commandBuffer, const CulledDrawList& drawList);
+
+private:
+	struct PushConstants {
+		glm::mat4 viewProjModel;
+		uint32_t depthSize[2];
+		uint32_t drawCount;
+		uint32_t hiZLevels; // 0 skips the occlusion test
+		uint32_t compact;
+	};
+	VkDevice device = VK_NULL_HANDLE;
+	VkDescriptorSetLayout layout = VK_NULL_HANDLE; // set 1 : input commands, bounds, output commands, count, draw data
+	VkDescriptorPool pool = VK_NULL_HANDLE;
+	std::mutex poolMutex; // draw lists are created by loader threads and destroyed by the thread that renders
+	PipelineManager* pipelineManager = nullptr;
+	PipelineHandle pipeline = NO_PIPELINE;
+	VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+	bool compact = false;
+};
+#endif // !CULLINGPASS_HPP
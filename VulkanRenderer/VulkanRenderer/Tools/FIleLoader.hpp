@@ -1,8 +1,9 @@
+#pragma once
 #include<iostream>
 #include<fstream>
 #include<filesystem>
 namespace FileLoader {
-	std::vector<char>LoadShaderfile(const std::string& fn) {
+	inline std::vector<char>LoadShaderfile(const std::string& fn) {
 		//ate: start reading at the end of the file
 		//     the advantage of starting to read at the end of the file is that 
 		//     we can use the read positoin to determine the size of the file and allocate a buffer
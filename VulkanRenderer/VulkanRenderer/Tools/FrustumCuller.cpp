@@ -0,0 +1,186 @@
+#include "Tools/FrustumCuller.hpp"
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <cstdio>
+#include <cmath>
+#include <glm/gtc/matrix_transform.hpp>
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(_M_X64) || defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+Frustum Frustum::FromMatrix(const glm::mat4& m) {
+	//glm is column major, row i is (m[0][i], m[1][i], m[2][i], m[3][i])
+	glm::vec4 row0(m[0][0], m[1][0], m[2][0], m[3][0]);
+	glm::vec4 row1(m[0][1], m[1][1], m[2][1], m[3][1]);
+	glm::vec4 row2(m[0][2], m[1][2], m[2][2], m[3][2]);
+	glm::vec4 row3(m[0][3], m[1][3], m[2][3], m[3][3]);
+	Frustum frustum;
+	frustum.planes[0] = row3 + row0; // left
+	frustum.planes[1] = row3 - row0; // right
+	frustum.planes[2] = row3 + row1; // bottom
+	frustum.planes[3] = row3 - row1; // top
+	frustum.planes[4] = row2;        // near, vulkan clips at z = 0
+	frustum.planes[5] = row3 - row2; // far
+	return frustum;
+}
+
+void FrustumCuller::Clear() {
+	centerX.clear(); centerY.clear(); centerZ.clear();
+	extentX.clear(); extentY.clear(); extentZ.clear();
+	count = 0;
+}
+
+void FrustumCuller::Reserve(size_t _count) {
+	size_t padded = (_count + 7) & ~size_t(7);
+	for (std::vector<float>* array : { &centerX, &centerY, &centerZ, &extentX, &extentY, &extentZ }) {
+		array->reserve(padded);
+	}
+}
+
+uint32_t FrustumCuller::Add(const Utils::AABB& box) {
+	if (count == centerX.size()) {
+		for (std::vector<float>* array : { &centerX, &centerY, &centerZ, &extentX, &extentY, &extentZ }) {
+			array->resize(count + 8, 0.0f);
+		}
+	}
+	uint32_t index = static_cast<uint32_t>(count++);
+	Set(index, box);
+	return index;
+}
+
+uint32_t FrustumCuller::Add(const Utils::AABB& box, const glm::mat4& transform) {
+	return Add(Utils::TransformAABB(box, transform));
+}
+
+void FrustumCuller::Set(uint32_t index, const Utils::AABB& box) {
+	glm::vec3 center = (box.min + box.max) * 0.5f;
+	glm::vec3 extent = (box.max - box.min) * 0.5f;
+	centerX[index] = center.x; centerY[index] = center.y; centerZ[index] = center.z;
+	extentX[index] = extent.x; extentY[index] = extent.y; extentZ[index] = extent.z;
+}
+
+size_t FrustumCuller::CullScalar(const Frustum& frustum, std::vector<uint32_t>& outVisible, size_t first, size_t last) const {
+	size_t before = outVisible.size();
+	last = std::min(last, count);
+	for (size_t i = first; i < last; i++) {
+		bool visible = true;
+		for (const glm::vec4& plane : frustum.planes) {
+			//signed distance of the center plus the box's projected radius on the normal
+			float distance = plane.x * centerX[i] + plane.y * centerY[i] + plane.z * centerZ[i] + plane.w;
+			float radius = std::abs(plane.x) * extentX[i] + std::abs(plane.y) * extentY[i] + std::abs(plane.z) * extentZ[i];
+			if (distance + radius < 0.0f) {
+				visible = false;
+				break;
+			}
+		}
+		if (visible) outVisible.push_back(static_cast<uint32_t>(i));
+	}
+	return outVisible.size() - before;
+}
+
+size_t FrustumCuller::Cull(const Frustum& frustum, std::vector<uint32_t>& outVisible, size_t first, size_t last) const {
+	size_t before = outVisible.size();
+	last = std::min(last, count);
+	size_t i = first;
+#if defined(__AVX__)
+	__m256 planeX[6], planeY[6], planeZ[6], planeW[6], absX[6], absY[6], absZ[6];
+	for (int p = 0; p < 6; p++) {
+		const glm::vec4& plane = frustum.planes[p];
+		planeX[p] = _mm256_set1_ps(plane.x); planeY[p] = _mm256_set1_ps(plane.y); planeZ[p] = _mm256_set1_ps(plane.z); planeW[p] = _mm256_set1_ps(plane.w);
+		absX[p] = _mm256_set1_ps(std::abs(plane.x)); absY[p] = _mm256_set1_ps(std::abs(plane.y)); absZ[p] = _mm256_set1_ps(std::abs(plane.z));
+	}
+	const __m256 zero = _mm256_setzero_ps();
+	for (; i < last; i += 8) {
+		__m256 cx = _mm256_loadu_ps(&centerX[i]), cy = _mm256_loadu_ps(&centerY[i]), cz = _mm256_loadu_ps(&centerZ[i]);
+		__m256 ex = _mm256_loadu_ps(&extentX[i]), ey = _mm256_loadu_ps(&extentY[i]), ez = _mm256_loadu_ps(&extentZ[i]);
+		int mask = 0xFF;
+		for (int p = 0; p < 6 && mask != 0; p++) {
+			__m256 distance = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(planeX[p], cx), _mm256_mul_ps(planeY[p], cy)), _mm256_add_ps(_mm256_mul_ps(planeZ[p], cz), planeW[p]));
+			__m256 radius = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(absX[p], ex), _mm256_mul_ps(absY[p], ey)), _mm256_mul_ps(absZ[p], ez));
+			mask &= _mm256_movemask_ps(_mm256_cmp_ps(_mm256_add_ps(distance, radius), zero, _CMP_GE_OQ));
+		}
+		//padding past count is zero sized boxes at the origin, drop them. boxes past last belong to another range
+		if (last - i < 8) mask &= (1 << (last - i)) - 1;
+		for (int lane = 0; mask != 0 && lane < 8; lane++) {
+			if (mask & (1 << lane)) outVisible.push_back(static_cast<uint32_t>(i + lane));
+		}
+	}
+#elif defined(_M_X64) || defined(__SSE2__)
+	__m128 planeX[6], planeY[6], planeZ[6], planeW[6], absX[6], absY[6], absZ[6];
+	for (int p = 0; p < 6; p++) {
+		const glm::vec4& plane = frustum.planes[p];
+		planeX[p] = _mm_set1_ps(plane.x); planeY[p] = _mm_set1_ps(plane.y); planeZ[p] = _mm_set1_ps(plane.z); planeW[p] = _mm_set1_ps(plane.w);
+		absX[p] = _mm_set1_ps(std::abs(plane.x)); absY[p] = _mm_set1_ps(std::abs(plane.y)); absZ[p] = _mm_set1_ps(std::abs(plane.z));
+	}
+	const __m128 zero = _mm_setzero_ps();
+	for (; i < last; i += 4) {
+		__m128 cx = _mm_loadu_ps(&centerX[i]), cy = _mm_loadu_ps(&centerY[i]), cz = _mm_loadu_ps(&centerZ[i]);
+		__m128 ex = _mm_loadu_ps(&extentX[i]), ey = _mm_loadu_ps(&extentY[i]), ez = _mm_loadu_ps(&extentZ[i]);
+		int mask = 0xF;
+		for (int p = 0; p < 6 && mask != 0; p++) {
+			__m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(planeX[p], cx), _mm_mul_ps(planeY[p], cy)), _mm_add_ps(_mm_mul_ps(planeZ[p], cz), planeW[p]));
+			__m128 radius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(absX[p], ex), _mm_mul_ps(absY[p], ey)), _mm_mul_ps(absZ[p], ez));
+			mask &= _mm_movemask_ps(_mm_cmpge_ps(_mm_add_ps(distance, radius), zero));
+		}
+		//padding past count is zero sized boxes at the origin, drop them. boxes past last belong to another range
+		if (last - i < 4) mask &= (1 << (last - i)) - 1;
+		for (int lane = 0; mask != 0 && lane < 4; lane++) {
+			if (mask & (1 << lane)) outVisible.push_back(static_cast<uint32_t>(i + lane));
+		}
+	}
+#else
+	return CullScalar(frustum, outVisible, first, last);
+#endif
+	return outVisible.size() - before;
+}
+
+const char* FrustumCuller::GetSimdName() {
+#if defined(__AVX__)
+	return "AVX";
+#elif defined(_M_X64) || defined(__SSE2__)
+	return "SSE";
+#else
+	return "scalar";
+#endif
+}
+
+void FrustumCuller::RunBenchmark(size_t objectCount, int iterations) {
+	//small boxes scattered around a camera looking down -z, about a tenth of them in view
+	std::mt19937 random(1234);
+	std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+	std::uniform_real_distribution<float> size(0.1f, 2.0f);
+	FrustumCuller culler;
+	culler.Reserve(objectCount);
+	for (size_t i = 0; i < objectCount; i++) {
+		glm::vec3 center(position(random), position(random), position(random));
+		glm::vec3 extent(size(random));
+		culler.Add(Utils::AABB{ center - extent, center + extent });
+	}
+	glm::mat4 view = glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	glm::mat4 proj = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 200.0f);
+	Frustum frustum = Frustum::FromMatrix(proj * view);
+
+	std::vector<uint32_t> visible;
+	visible.reserve(objectCount);
+	size_t scalarVisible = 0, simdVisible = 0;
+	auto measure = [&](bool simd, size_t& outVisibleCount) {
+		auto begin = std::chrono::high_resolution_clock::now();
+		for (int i = 0; i < iterations; i++) {
+			visible.clear();
+			outVisibleCount = simd ? culler.Cull(frustum, visible) : culler.CullScalar(frustum, visible);
+		}
+		std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - begin;
+		return elapsed.count() / iterations * (100000.0 / objectCount);
+	};
+	double scalarTime = measure(false, scalarVisible);
+	double simdTime = measure(true, simdVisible);
+	printf("Frustum culling benchmark : %zu objects, %d iterations\n", objectCount, iterations);
+	printf("  scalar : %.3f ms per 100k objects, %zu visible\n", scalarTime, scalarVisible);
+	printf("  %s : %.3f ms per 100k objects, %zu visible(%.1fx)\n", GetSimdName(), simdTime, simdVisible, scalarTime / simdTime);
+	if (scalarVisible != simdVisible) {
+		printf("  visible counts differ!\n");
+	}
+}
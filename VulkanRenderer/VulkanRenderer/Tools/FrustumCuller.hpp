@@ -0,0 +1,47 @@
+#pragma once
+#ifndef FRUSTUMCULLER_HPP
+#define FRUSTUMCULLER_HPP
+
+#include <glm/glm.hpp>
+#include <vector>
+#include <cstdint>
+#include "Utils.hpp"
+
+// six clip planes(xyz : normal pointing inside, w : distance) of a Vulkan clip space(0 <= z <= w).
+// from viewProj the planes are in world space, from viewProj * model in the space of that model.
+struct Frustum {
+	glm::vec4 planes[6];
+	static Frustum FromMatrix(const glm::mat4& clipFromSpace);
+};
+
+// boxes in structure of arrays layout, tested 8(AVX) or 4(SSE) at a time against a Frustum.
+// a box is culled when it's completely behind one plane, so boxes near frustum corners can survive.
+class FrustumCuller {
+public:
+	void Clear();
+	void Reserve(size_t count);
+	// returns the index of the box, indices in Cull's output refer to it
+	uint32_t Add(const Utils::AABB& box);
+	// box transformed by transform, enclosed by a new axis aligned box
+	uint32_t Add(const Utils::AABB& box, const glm::mat4& transform);
+	void Set(uint32_t index, const Utils::AABB& box);
+	size_t Size() const { return count; }
+
+	// appends the index of every box of [first, last) that intersects frustum to outVisible, returns how many were appended.
+	// first must be a multiple of 8, ranges split that way can be culled on several threads at once
+	size_t Cull(const Frustum& frustum, std::vector<uint32_t>& outVisible, size_t first = 0, size_t last = SIZE_MAX) const;
+	// reference implementation, one box and plane at a time
+	size_t CullScalar(const Frustum& frustum, std::vector<uint32_t>& outVisible, size_t first = 0, size_t last = SIZE_MAX) const;
+	// instruction set Cull uses
+	static const char* GetSimdName();
+
+	// culls objectCount random boxes iterations times with both paths and prints the cost per 100k objects
+	static void RunBenchmark(size_t objectCount = 100000, int iterations = 200);
+
+private:
+	// center / half extent, padded to a multiple of 8 so the last block loads whole
+	std::vector<float> centerX, centerY, centerZ;
+	std::vector<float> extentX, extentY, extentZ;
+	size_t count = 0;
+};
+#endif // !FRUSTUMCULLER_HPP
@@ -0,0 +1,79 @@
+#include "Tools/GeometryPool.hpp"
+#include "Tools/UploadBatch.hpp"
+#include "Tools/Utils.hpp"
+#include <stdexcept>
+#include <cstdio>
+
+void GeometryPool::Init(VkDevice _device, MemoryAllocator& allocator, const std::vector<uint32_t>& queueFamilies, VkDeviceSize _vertexStride,
+	VkDeviceSize vertexCapacity, VkDeviceSize indexCapacity) {
+	device = _device;
+	vertexStride = _vertexStride;
+	//capacities must hold whole vertices/indices
+	vertexCapacity -= vertexCapacity % vertexStride;
+	indexCapacity -= indexCapacity % sizeof(uint32_t);
+
+	concurrentSharing = queueFamilies.size() > 1;
+	VkSharingMode sharingMode = concurrentSharing ? VK_SHARING_MODE_CONCURRENT : VK_SHARING_MODE_EXCLUSIVE;
+	Utils::CreateBuffer(device, allocator, vertexCapacity, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, vertexBuffer, vertexBufferMemory, sharingMode, queueFamilies);
+	Utils::CreateBuffer(device, allocator, indexCapacity, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, indexBuffer, indexBufferMemory, sharingMode, queueFamilies);
+	vertexRanges.Init(vertexCapacity);
+	indexRanges.Init(indexCapacity);
+}
+
+void GeometryPool::Destroy(MemoryAllocator& allocator) {
+	if (device == VK_NULL_HANDLE) return;
+	Utils::DestroyBuffer(device, allocator, vertexBuffer, vertexBufferMemory);
+	Utils::DestroyBuffer(device, allocator, indexBuffer, indexBufferMemory);
+	vertexRanges.Clear();
+	indexRanges.Clear();
+	device = VK_NULL_HANDLE;
+}
+
+GeometryAllocation GeometryPool::Allocate(uint32_t vertexCount, uint32_t indexCount) {
+	GeometryAllocation allocation;
+	if (vertexCount == 0 || indexCount == 0) return allocation;
+	allocation.vertexSize = vertexStride * vertexCount;
+	allocation.indexSize = sizeof(uint32_t) * indexCount;
+	allocation.indexCount = indexCount;
+	std::lock_guard<std::mutex> lock(mutex);
+	//vertex ranges are aligned to the stride, so the byte offset is a whole number of vertices
+	if (!vertexRanges.Allocate(allocation.vertexSize, vertexStride, SuballocationType::Buffer, allocation.vertexOffset)) {
+		throw std::runtime_error("geometry pool is out of vertex memory!");
+	}
+	if (!indexRanges.Allocate(allocation.indexSize, sizeof(uint32_t), SuballocationType::Buffer, allocation.indexOffset)) {
+		vertexRanges.Free(allocation.vertexOffset);
+		throw std::runtime_error("geometry pool is out of index memory!");
+	}
+	allocation.firstVertex = static_cast<int32_t>(allocation.vertexOffset / vertexStride);
+	allocation.firstIndex = static_cast<uint32_t>(allocation.indexOffset / sizeof(uint32_t));
+	return allocation;
+}
+
+void GeometryPool::Free(GeometryAllocation& allocation) {
+	if (!allocation.IsValid()) return;
+	std::lock_guard<std::mutex> lock(mutex);
+	vertexRanges.Free(allocation.vertexOffset);
+	indexRanges.Free(allocation.indexOffset);
+	allocation = GeometryAllocation{};
+}
+
+void GeometryPool::Upload(UploadBatch& batch, const GeometryAllocation& allocation, const void* vertices, const uint32_t* indices) {
+	if (!allocation.IsValid()) return;
+	batch.UploadBuffer(vertices, allocation.vertexSize, vertexBuffer, allocation.vertexOffset, concurrentSharing);
+	batch.UploadBuffer(indices, allocation.indexSize, indexBuffer, allocation.indexOffset, concurrentSharing);
+}
+
+void GeometryPool::Bind(VkCommandBuffer commandBuffer) const {
+	VkDeviceSize offsets[] = { 0 };
+	vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertexBuffer, offsets);
+	vkCmdBindIndexBuffer(commandBuffer, indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+}
+
+void GeometryPool::PrintStats() {
+	std::lock_guard<std::mutex> lock(mutex);
+	printf("Geometry pool : vertices %.2f / %.2f MB, indices %.2f / %.2f MB, %u mesh(es)\n",
+		vertexRanges.GetUsedSize() / (1024.0 * 1024.0), vertexRanges.GetSize() / (1024.0 * 1024.0),
+		indexRanges.GetUsedSize() / (1024.0 * 1024.0), indexRanges.GetSize() / (1024.0 * 1024.0), vertexRanges.GetAllocationCount());
+}
@@ -0,0 +1,58 @@
+#pragma once
+#ifndef GEOMETRYPOOL_HPP
+#define GEOMETRYPOOL_HPP
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+#include <vector>
+#include <mutex>
+#include <cstdint>
+#include "MemoryAllocator.hpp"
+
+class UploadBatch;
+
+// a mesh is a range of the shared vertex buffer and a range of the shared index buffer.
+struct GeometryAllocation {
+	VkDeviceSize vertexOffset = 0;	// bytes
+	VkDeviceSize vertexSize = 0;
+	VkDeviceSize indexOffset = 0;	// bytes
+	VkDeviceSize indexSize = 0;
+	int32_t firstVertex = 0;		// vertexOffset of vkCmdDrawIndexed
+	uint32_t firstIndex = 0;
+	uint32_t indexCount = 0;
+	bool IsValid() const { return vertexSize > 0; }
+};
+
+// one vertex buffer and one 32 bit index buffer that every mesh is sub-allocated from.
+// bind once with Bind() and draw any mesh with its firstIndex/firstVertex.
+// buffers are shared between the graphics and transfer families, so uploads need no ownership transfer.
+class GeometryPool {
+public:
+	void Init(VkDevice _device, MemoryAllocator& allocator, const std::vector<uint32_t>& queueFamilies, VkDeviceSize _vertexStride,
+		VkDeviceSize vertexCapacity = 64ull * 1024 * 1024, VkDeviceSize indexCapacity = 32ull * 1024 * 1024);
+	void Destroy(MemoryAllocator& allocator);
+
+	// throws when the pool is full
+	GeometryAllocation Allocate(uint32_t vertexCount, uint32_t indexCount);
+	void Free(GeometryAllocation& allocation);
+	void Upload(UploadBatch& batch, const GeometryAllocation& allocation, const void* vertices, const uint32_t* indices);
+	void Bind(VkCommandBuffer commandBuffer) const;
+
+	VkBuffer GetVertexBuffer() const { return vertexBuffer; }
+	VkBuffer GetIndexBuffer() const { return indexBuffer; }
+	VkDeviceSize GetVertexStride() const { return vertexStride; }
+	void PrintStats();
+
+private:
+	VkDevice device = VK_NULL_HANDLE;
+	VkDeviceSize vertexStride = 0;
+	bool concurrentSharing = false;
+	VkBuffer vertexBuffer = VK_NULL_HANDLE;
+	MemoryAllocation vertexBufferMemory;
+	VkBuffer indexBuffer = VK_NULL_HANDLE;
+	MemoryAllocation indexBufferMemory;
+	RangeAllocator vertexRanges;
+	RangeAllocator indexRanges;
+	std::mutex mutex;
+};
+#endif // !GEOMETRYPOOL_HPP
@@ -0,0 +1,209 @@
+#include "Tools/HiZPyramid.hpp"
+#include "Tools/Utils.hpp"
+#include "Tools/PipelineBuilder.hpp"
+#include <stdexcept>
+#include <algorithm>
+#include <array>
+
+void HiZPyramid::Init(VkDevice _device, PipelineManager& _pipelineManager) {
+	device = _device;
+
+	VkSamplerCreateInfo samplerInfo{};
+	samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+	samplerInfo.magFilter = VK_FILTER_NEAREST;
+	samplerInfo.minFilter = VK_FILTER_NEAREST;
+	samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+	samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.maxLod = static_cast<float>(MAX_LEVELS);
+	if (vkCreateSampler(device, &samplerInfo, nullptr, &sampler) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create hi-z sampler!");
+	}
+
+	std::array<VkDescriptorSetLayoutBinding, 2> buildBindings;
+	buildBindings[0] = Initializer::InitDescriptorSetLayoutBinding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_COMPUTE_BIT);
+	buildBindings[1] = Initializer::InitDescriptorSetLayoutBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, VK_SHADER_STAGE_COMPUTE_BIT);
+	VkDescriptorSetLayoutCreateInfo layoutInfo = Initializer::InitDescriptorSetLayoutCreateInfo(static_cast<uint32_t>(buildBindings.size()), buildBindings.data());
+	if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &buildLayout) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create hi-z descriptor set layout!");
+	}
+	VkDescriptorSetLayoutBinding readBinding = Initializer::InitDescriptorSetLayoutBinding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_COMPUTE_BIT);
+	layoutInfo = Initializer::InitDescriptorSetLayoutCreateInfo(1, &readBinding);
+	if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &readLayout) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create hi-z descriptor set layout!");
+	}
+
+	std::array<VkDescriptorPoolSize, 2> poolSizes;
+	poolSizes[0].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	poolSizes[0].descriptorCount = MAX_LEVELS + 1;
+	poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+	poolSizes[1].descriptorCount = MAX_LEVELS;
+	VkDescriptorPoolCreateInfo poolInfo = Initializer::InitDescriptorPoolCreateInfo(static_cast<uint32_t>(poolSizes.size()), poolSizes.data(), MAX_LEVELS + 1);
+	if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &pool) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create hi-z descriptor pool!");
+	}
+
+	VkPushConstantRange pushConstantRange{};
+	pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	pushConstantRange.offset = 0;
+	pushConstantRange.size = sizeof(PushConstants);
+	PipelineBuilder::CreatePipelineLayout(pipelineLayout, device, { buildLayout }, { pushConstantRange });
+	pipelineManager = &_pipelineManager;
+	ComputePipelineDesc pipelineDesc;
+	pipelineDesc.csFilename = "HiZBuild.comp";
+	pipelineDesc.layout = pipelineLayout;
+	pipeline = pipelineManager->RequestNow(pipelineDesc);
+}
+
+void HiZPyramid::Destroy() {
+	if (device == VK_NULL_HANDLE) return;
+	vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+	vkDestroyDescriptorPool(device, pool, nullptr);
+	vkDestroyDescriptorSetLayout(device, buildLayout, nullptr);
+	vkDestroyDescriptorSetLayout(device, readLayout, nullptr);
+	vkDestroySampler(device, sampler, nullptr);
+	device = VK_NULL_HANDLE;
+}
+
+void HiZPyramid::CreateImages(MemoryAllocator& allocator, VkCommandPool commandPool, VkQueue queue, VkImage _depthImage, VkImageView depthView, VkFormat _depthFormat, VkExtent2D _depthExtent) {
+	depthImage = _depthImage;
+	depthFormat = _depthFormat;
+	depthExtent = _depthExtent;
+
+	levelExtents.clear();
+	VkExtent2D extent = { (depthExtent.width + 1) / 2, (depthExtent.height + 1) / 2 };
+	while (levelExtents.size() < MAX_LEVELS) {
+		levelExtents.push_back(extent);
+		if (extent.width == 1 && extent.height == 1) break;
+		extent = { (extent.width + 1) / 2, (extent.height + 1) / 2 };
+	}
+	levelCount = static_cast<uint32_t>(levelExtents.size());
+
+	VkImageCreateInfo imageInfo = Initializer::InitImageCreateInfo(VK_IMAGE_TYPE_2D, levelExtents[0].width, levelExtents[0].height, 1, levelCount, VK_FORMAT_R32_SFLOAT,
+		VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT);
+	Utils::CreateImage(device, allocator, image, imageMemory, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, imageInfo);
+	fullView = Utils::CreateImageView(device, image, VK_FORMAT_R32_SFLOAT, VK_IMAGE_VIEW_TYPE_2D, VK_IMAGE_ASPECT_COLOR_BIT, levelCount);
+	levelViews.resize(levelCount);
+	for (uint32_t i = 0; i < levelCount; i++) {
+		VkImageViewCreateInfo viewInfo{};
+		viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		viewInfo.image = image;
+		viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		viewInfo.format = VK_FORMAT_R32_SFLOAT;
+		viewInfo.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, i, 1, 0, 1 };
+		if (vkCreateImageView(device, &viewInfo, nullptr, &levelViews[i]) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create hi-z image view!");
+		}
+	}
+
+	//level 0 reads the depth buffer, every other level the one above it
+	buildSets.resize(levelCount);
+	std::vector<VkDescriptorSetLayout> buildLayouts(levelCount, buildLayout);
+	VkDescriptorSetAllocateInfo allocInfo = Initializer::InitDescriptorSetAllocateInfo(pool, levelCount, buildLayouts.data());
+	if (vkAllocateDescriptorSets(device, &allocInfo, buildSets.data()) != VK_SUCCESS) {
+		throw std::runtime_error("failed to allocate hi-z descriptor sets!");
+	}
+	allocInfo = Initializer::InitDescriptorSetAllocateInfo(pool, 1, &readLayout);
+	if (vkAllocateDescriptorSets(device, &allocInfo, &readSet) != VK_SUCCESS) {
+		throw std::runtime_error("failed to allocate hi-z descriptor sets!");
+	}
+	for (uint32_t i = 0; i < levelCount; i++) {
+		VkDescriptorImageInfo srcInfo = i == 0
+			? Initializer::InitDescriptorImageInfo(VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL, depthView, sampler)
+			: Initializer::InitDescriptorImageInfo(VK_IMAGE_LAYOUT_GENERAL, levelViews[i - 1], sampler);
+		VkDescriptorImageInfo dstInfo = Initializer::InitDescriptorImageInfo(VK_IMAGE_LAYOUT_GENERAL, levelViews[i], VK_NULL_HANDLE);
+		std::array<VkWriteDescriptorSet, 2> writes;
+		writes[0] = Initializer::InitWriteDescriptorSet(buildSets[i], 0, 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, nullptr, &srcInfo);
+		writes[1] = Initializer::InitWriteDescriptorSet(buildSets[i], 1, 0, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, nullptr, &dstInfo);
+		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+	}
+	VkDescriptorImageInfo readInfo = Initializer::InitDescriptorImageInfo(VK_IMAGE_LAYOUT_GENERAL, fullView, sampler);
+	VkWriteDescriptorSet readWrite = Initializer::InitWriteDescriptorSet(readSet, 0, 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, nullptr, &readInfo);
+	vkUpdateDescriptorSets(device, 1, &readWrite, 0, nullptr);
+
+	//far plane everywhere, nothing is occluded until the first Build
+	VkCommandBuffer commandBuffer = Utils::BeginSingleTimeCommand(device, commandPool);
+	VkImageSubresourceRange range = { VK_IMAGE_ASPECT_COLOR_BIT, 0, levelCount, 0, 1 };
+	VkImageMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.image = image;
+	barrier.subresourceRange = range;
+	barrier.srcAccessMask = 0;
+	barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+	VkClearColorValue farPlane = { { 1.0f, 1.0f, 1.0f, 1.0f } };
+	vkCmdClearColorImage(commandBuffer, image, VK_IMAGE_LAYOUT_GENERAL, &farPlane, 1, &range);
+	barrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+	Utils::EndSingleTimeCommand(device, commandPool, queue, commandBuffer);
+}
+
+void HiZPyramid::DestroyImages(MemoryAllocator& allocator) {
+	if (image == VK_NULL_HANDLE) return;
+	vkResetDescriptorPool(device, pool, 0);
+	buildSets.clear();
+	readSet = VK_NULL_HANDLE;
+	for (VkImageView view : levelViews) {
+		vkDestroyImageView(device, view, nullptr);
+	}
+	levelViews.clear();
+	vkDestroyImageView(device, fullView, nullptr);
+	Utils::DestroyImage(device, allocator, image, imageMemory);
+	image = VK_NULL_HANDLE;
+	levelCount = 0;
+}
+
+void HiZPyramid::Build(VkCommandBuffer commandBuffer) {
+	bool hasStencil = depthFormat == VK_FORMAT_D32_SFLOAT_S8_UINT || depthFormat == VK_FORMAT_D24_UNORM_S8_UINT;
+	VkImageMemoryBarrier depthBarrier{};
+	depthBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	depthBarrier.oldLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+	depthBarrier.newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+	depthBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	depthBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	depthBarrier.image = depthImage;
+	depthBarrier.subresourceRange = { VkImageAspectFlags(VK_IMAGE_ASPECT_DEPTH_BIT | (hasStencil ? VK_IMAGE_ASPECT_STENCIL_BIT : 0)), 0, 1, 0, 1 };
+	depthBarrier.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+	depthBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	//the culling pass of this frame still reads the pyramid, only an execution dependency is needed for it
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		0, 0, nullptr, 0, nullptr, 1, &depthBarrier);
+
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineManager->Get(pipeline));
+	VkExtent2D srcExtent = depthExtent;
+	for (uint32_t i = 0; i < levelCount; i++) {
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &buildSets[i], 0, nullptr);
+		PushConstants pushConstants = { { static_cast<int32_t>(srcExtent.width), static_cast<int32_t>(srcExtent.height) },
+			{ static_cast<int32_t>(levelExtents[i].width), static_cast<int32_t>(levelExtents[i].height) } };
+		vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(pushConstants), &pushConstants);
+		vkCmdDispatch(commandBuffer, (levelExtents[i].width + 7) / 8, (levelExtents[i].height + 7) / 8, 1);
+		srcExtent = levelExtents[i];
+
+		//the next level and next frame's culling read this one, next frame's Build overwrites it
+		VkImageMemoryBarrier levelBarrier{};
+		levelBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		levelBarrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+		levelBarrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+		levelBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		levelBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		levelBarrier.image = image;
+		levelBarrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, i, 1, 0, 1 };
+		levelBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		levelBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &levelBarrier);
+	}
+
+	depthBarrier.oldLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+	depthBarrier.newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+	depthBarrier.srcAccessMask = 0;
+	depthBarrier.dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+		0, 0, nullptr, 0, nullptr, 1, &depthBarrier);
+}
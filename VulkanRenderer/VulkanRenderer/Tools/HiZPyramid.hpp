@@ -0,0 +1,64 @@
+#pragma once
+#ifndef HIZPYRAMID_HPP
+#define HIZPYRAMID_HPP
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+#include <vector>
+#include <cstdint>
+#include "MemoryAllocator.hpp"
+#include "PipelineManager.hpp"
+
+// max depth pyramid of the last frame, read by CullingPass.
+// level 0 is half the depth buffer(rounded up) and every texel of level L covers 2^(L+1) x 2^(L+1) depth pixels.
+// the image stays in VK_IMAGE_LAYOUT_GENERAL, it is cleared to the far plane whenever it is recreated.
+class HiZPyramid {
+public:
+	// the pipeline comes from pipelineManager, which rebuilds it on hot reload and releases it in its Destroy
+	void Init(VkDevice _device, PipelineManager& _pipelineManager);
+	void Destroy();
+	bool IsEnabled() const { return device != VK_NULL_HANDLE; }
+
+	// call after the depth buffer is (re)created. the depth image needs VK_IMAGE_USAGE_SAMPLED_BIT,
+	// depthView a depth only aspect.
+	void CreateImages(MemoryAllocator& allocator, VkCommandPool commandPool, VkQueue queue, VkImage _depthImage, VkImageView depthView, VkFormat _depthFormat, VkExtent2D _depthExtent);
+	void DestroyImages(MemoryAllocator& allocator);
+
+	// record after the render pass that wrote depth(store op STORE, final layout DEPTH_STENCIL_ATTACHMENT_OPTIMAL).
+	// the depth image is back in DEPTH_STENCIL_ATTACHMENT_OPTIMAL afterwards.
+	void Build(VkCommandBuffer commandBuffer);
+
+	// combined image sampler of the whole pyramid in GENERAL layout. read it with texelFetch
+	VkDescriptorSetLayout GetReadLayout() const { return readLayout; }
+	VkDescriptorSet GetReadDescriptorSet() const { return readSet; }
+	VkExtent2D GetDepthExtent() const { return depthExtent; }
+	uint32_t GetLevelCount() const { return levelCount; }
+
+private:
+	struct PushConstants {
+		int32_t srcSize[2];
+		int32_t dstSize[2];
+	};
+	VkDevice device = VK_NULL_HANDLE;
+	VkSampler sampler = VK_NULL_HANDLE; // nearest, clamp to edge
+	VkDescriptorSetLayout buildLayout = VK_NULL_HANDLE; // binding 0 : source level, binding 1 : destination level
+	VkDescriptorSetLayout readLayout = VK_NULL_HANDLE;
+	VkDescriptorPool pool = VK_NULL_HANDLE;
+	PipelineManager* pipelineManager = nullptr;
+	PipelineHandle pipeline = NO_PIPELINE;
+	VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+	VkDescriptorSet readSet = VK_NULL_HANDLE;
+	std::vector<VkDescriptorSet> buildSets; // one per level
+	static const uint32_t MAX_LEVELS = 16;
+
+	VkImage image = VK_NULL_HANDLE;
+	MemoryAllocation imageMemory;
+	VkImageView fullView = VK_NULL_HANDLE;
+	std::vector<VkImageView> levelViews;
+	std::vector<VkExtent2D> levelExtents;
+	uint32_t levelCount = 0;
+	VkImage depthImage = VK_NULL_HANDLE;
+	VkFormat depthFormat = VK_FORMAT_UNDEFINED;
+	VkExtent2D depthExtent = { 0, 0 };
+};
+#endif // !HIZPYRAMID_HPP
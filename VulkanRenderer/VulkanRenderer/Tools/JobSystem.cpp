@@ -0,0 +1,323 @@
+#include "Tools/JobSystem.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+
+namespace {
+	// worker threads remember which system they belong to, any other thread is index 0
+	thread_local const JobSystem* currentSystem = nullptr;
+	thread_local uint32_t currentThreadIndex = 0;
+	// a worker tries this many times to find a job before it goes to sleep
+	const int SPIN_COUNT = 64;
+}
+
+void JobSystem::Init(uint32_t workerCount) {
+	if (initialized) return;
+	if (workerCount == 0) workerCount = std::max(1u, std::thread::hardware_concurrency()) - 1;
+	mainThreadId = std::this_thread::get_id();
+	stopping = false;
+	queues.clear();
+	for (uint32_t i = 0; i <= workerCount; i++) {
+		queues.push_back(std::make_unique<WorkQueue>());
+	}
+	for (uint32_t i = 1; i <= workerCount; i++) {
+		workers.emplace_back(&JobSystem::WorkerLoop, this, i);
+	}
+	initialized = true;
+}
+
+void JobSystem::Shutdown() {
+	if (!initialized) return;
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+		stopping = true;
+	}
+	wakeCondition.notify_all();
+	for (std::thread& worker : workers) worker.join();
+	workers.clear();
+	queues.clear();
+	backgroundQueue.jobs.clear();
+	queuedJobs = 0;
+	mainThreadJobs.clear();
+	initialized = false;
+}
+
+uint32_t JobSystem::GetThreadIndex() const {
+	return currentSystem == this ? currentThreadIndex : 0;
+}
+
+void JobSystem::Run(std::function<void()> job, JobCounter* counter) {
+	if (counter != nullptr) counter->count.fetch_add(1);
+	Push({ std::move(job), counter });
+}
+
+void JobSystem::RunBackground(std::function<void()> job, JobCounter* counter) {
+	if (counter != nullptr) counter->count.fetch_add(1);
+	Job backgroundJob = { std::move(job), counter };
+	if (workers.empty()) {
+		Execute(backgroundJob);
+		return;
+	}
+	{
+		std::lock_guard<std::mutex> lock(backgroundQueue.mutex);
+		backgroundQueue.jobs.push_back(std::move(backgroundJob));
+	}
+	queuedJobs.fetch_add(1);
+	if (sleepingWorkers.load() > 0) {
+		std::lock_guard<std::mutex> lock(sleepMutex);
+		wakeCondition.notify_one();
+	}
+}
+
+void JobSystem::RunAfter(JobCounter& dependency, std::function<void()> job, JobCounter* counter) {
+	if (counter != nullptr) counter->count.fetch_add(1);
+	{
+		//Finish takes the continuations under the same lock after the count hit zero, so a job is never left behind
+		std::lock_guard<std::mutex> lock(dependency.mutex);
+		if (dependency.count.load() != 0) {
+			dependency.continuations.push_back([this, job = std::move(job), counter]() mutable {
+				Push({ std::move(job), counter });
+			});
+			return;
+		}
+	}
+	Push({ std::move(job), counter });
+}
+
+void JobSystem::Wait(JobCounter& counter) {
+	bool mainThread = IsMainThread();
+	while (!counter.IsDone()) {
+		if (mainThread) RunMainThreadJobs();
+		if (!RunOneJob()) std::this_thread::yield();
+	}
+	std::exception_ptr error;
+	{
+		//the last Finish may still hold the lock, the counter can be destroyed once it's released
+		std::lock_guard<std::mutex> lock(counter.mutex);
+		error = counter.error;
+		counter.error = nullptr;
+	}
+	if (error) std::rethrow_exception(error);
+}
+
+void JobSystem::ParallelFor(uint32_t count, uint32_t grain, const std::function<void(uint32_t, uint32_t)>& func) {
+	if (count == 0) return;
+	grain = std::max(grain, 1u);
+	if (count <= grain || !initialized) {
+		func(0, count);
+		return;
+	}
+	JobCounter counter;
+	//the caller runs the first chunk itself instead of waiting idle
+	for (uint32_t first = grain; first < count; first += grain) {
+		uint32_t last = std::min(first + grain, count);
+		Run([&func, first, last]() { func(first, last); }, &counter);
+	}
+	std::exception_ptr error;
+	try {
+		func(0, grain);
+	}
+	catch (...) {
+		error = std::current_exception();
+	}
+	//the other chunks reference func and counter, wait for them even when ours threw
+	try {
+		Wait(counter);
+	}
+	catch (...) {
+		if (!error) error = std::current_exception();
+	}
+	if (error) std::rethrow_exception(error);
+}
+
+void JobSystem::RunOnMainThread(std::function<void()> job, JobCounter* counter) {
+	if (counter != nullptr) counter->count.fetch_add(1);
+	std::lock_guard<std::mutex> lock(mainThreadMutex);
+	mainThreadJobs.push_back({ std::move(job), counter });
+}
+
+void JobSystem::RunMainThreadJobs() {
+	std::vector<Job> jobs;
+	{
+		std::lock_guard<std::mutex> lock(mainThreadMutex);
+		jobs.swap(mainThreadJobs);
+	}
+	for (Job& job : jobs) Execute(job);
+}
+
+void JobSystem::WorkerLoop(uint32_t threadIndex) {
+	currentSystem = this;
+	currentThreadIndex = threadIndex;
+	while (!stopping) {
+		bool ran = false;
+		for (int i = 0; i < SPIN_COUNT && !ran; i++) {
+			ran = RunOneJob();
+			if (!ran) std::this_thread::yield();
+		}
+		if (ran) continue;
+		std::unique_lock<std::mutex> lock(sleepMutex);
+		//Push bumps queuedJobs before it reads sleepingWorkers, one of the two sides always sees the other
+		sleepingWorkers.fetch_add(1);
+		wakeCondition.wait(lock, [this]() { return stopping || queuedJobs.load() > 0; });
+		sleepingWorkers.fetch_sub(1);
+	}
+}
+
+void JobSystem::Push(Job&& job) {
+	uint32_t threadIndex = GetThreadIndex();
+	{
+		WorkQueue& queue = *queues[threadIndex];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		queue.jobs.push_back(std::move(job));
+	}
+	queuedJobs.fetch_add(1);
+	if (sleepingWorkers.load() > 0) {
+		std::lock_guard<std::mutex> lock(sleepMutex);
+		wakeCondition.notify_one();
+	}
+}
+
+bool JobSystem::TryPop(uint32_t threadIndex, Job& outJob) {
+	//own queue from the back
+	{
+		WorkQueue& queue = *queues[threadIndex];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if (!queue.jobs.empty()) {
+			outJob = std::move(queue.jobs.back());
+			queue.jobs.pop_back();
+			return true;
+		}
+	}
+	//steal from the front of the others, starting next to us so thieves spread out
+	uint32_t queueCount = static_cast<uint32_t>(queues.size());
+	for (uint32_t i = 1; i < queueCount; i++) {
+		WorkQueue& queue = *queues[(threadIndex + i) % queueCount];
+		std::unique_lock<std::mutex> lock(queue.mutex, std::try_to_lock);
+		if (!lock.owns_lock() || queue.jobs.empty()) continue;
+		outJob = std::move(queue.jobs.front());
+		queue.jobs.pop_front();
+		return true;
+	}
+	//background jobs last, and never on the main thread or other threads that aren't workers
+	if (threadIndex == 0) return false;
+	std::lock_guard<std::mutex> lock(backgroundQueue.mutex);
+	if (backgroundQueue.jobs.empty()) return false;
+	outJob = std::move(backgroundQueue.jobs.front());
+	backgroundQueue.jobs.pop_front();
+	return true;
+}
+
+bool JobSystem::RunOneJob() {
+	if (queuedJobs.load() == 0) return false;
+	Job job;
+	if (!TryPop(GetThreadIndex(), job)) return false;
+	queuedJobs.fetch_sub(1);
+	Execute(job);
+	return true;
+}
+
+void JobSystem::Execute(Job& job) {
+	try {
+		job.func();
+	}
+	catch (...) {
+		if (job.counter != nullptr) {
+			std::lock_guard<std::mutex> lock(job.counter->mutex);
+			if (!job.counter->error) job.counter->error = std::current_exception();
+		}
+		else {
+			//nobody waits on it, an exception leaving the worker would terminate the process
+			try {
+				throw;
+			}
+			catch (const std::exception& e) {
+				printf("Job failed : %s\n", e.what());
+			}
+			catch (...) {
+				printf("Job failed\n");
+			}
+		}
+	}
+	Finish(job.counter);
+}
+
+void JobSystem::Finish(JobCounter* counter) {
+	if (counter == nullptr) return;
+	std::vector<std::function<void()>> continuations;
+	{
+		//zero is only reached under the lock, so RunAfter and Wait never see a half finished counter
+		std::lock_guard<std::mutex> lock(counter->mutex);
+		if (counter->count.fetch_sub(1) != 1) return;
+		continuations.swap(counter->continuations);
+	}
+	for (std::function<void()>& continuation : continuations) continuation();
+}
+
+void JobSystem::RunBenchmark(uint32_t workerCount) {
+	JobSystem jobs;
+	jobs.Init(workerCount);
+	printf("Job system benchmark : %u worker(s) + main thread\n", jobs.GetWorkerCount());
+	using Clock = std::chrono::high_resolution_clock;
+	const uint32_t jobCount = 100000;
+	std::atomic<uint32_t> executed{ 0 };
+
+	//every job is pushed to the main thread's queue, workers only get them by stealing
+	auto begin = Clock::now();
+	JobCounter counter;
+	for (uint32_t i = 0; i < jobCount; i++) {
+		jobs.Run([&executed]() { executed.fetch_add(1, std::memory_order_relaxed); }, &counter);
+	}
+	jobs.Wait(counter);
+	std::chrono::duration<double, std::nano> elapsed = Clock::now() - begin;
+	printf("  spawn + steal : %.1f ns per empty job(%u jobs)\n", elapsed.count() / jobCount, executed.load());
+
+	//one job per worker fans out children on its own queue, so most run without stealing
+	executed = 0;
+	begin = Clock::now();
+	JobCounter parents;
+	uint32_t parentCount = jobs.GetThreadCount();
+	for (uint32_t p = 0; p < parentCount; p++) {
+		jobs.Run([&jobs, &executed, jobCount, parentCount]() {
+			JobCounter children;
+			for (uint32_t i = 0; i < jobCount / parentCount; i++) {
+				jobs.Run([&executed]() { executed.fetch_add(1, std::memory_order_relaxed); }, &children);
+			}
+			jobs.Wait(children);
+		}, &parents);
+	}
+	jobs.Wait(parents);
+	elapsed = Clock::now() - begin;
+	printf("  local spawn : %.1f ns per empty job(%u jobs)\n", elapsed.count() / executed.load(), executed.load());
+
+	//continuation : a job queued by the counter of another
+	begin = Clock::now();
+	const uint32_t chainLength = 10000;
+	JobCounter link;
+	JobCounter chainDone;
+	std::function<void(uint32_t)> chain = [&](uint32_t remaining) {
+		if (remaining == 0) return;
+		JobCounter* next = new JobCounter();
+		jobs.Run([]() {}, next);
+		jobs.RunAfter(*next, [&chain, next, remaining]() { delete next; chain(remaining - 1); }, &chainDone);
+	};
+	chain(chainLength);
+	jobs.Wait(chainDone);
+	elapsed = Clock::now() - begin;
+	printf("  dependency chain : %.1f ns per link\n", elapsed.count() / chainLength);
+
+	//compute bound parallel for against the same loop on one thread
+	const uint32_t itemCount = 4 * 1024 * 1024;
+	std::vector<float> values(itemCount);
+	auto work = [&values](uint32_t first, uint32_t last) {
+		for (uint32_t i = first; i < last; i++) values[i] = std::sqrt(static_cast<float>(i)) * std::sin(static_cast<float>(i));
+	};
+	begin = Clock::now();
+	work(0, itemCount);
+	std::chrono::duration<double, std::milli> serial = Clock::now() - begin;
+	begin = Clock::now();
+	jobs.ParallelFor(itemCount, 16 * 1024, work);
+	std::chrono::duration<double, std::milli> parallel = Clock::now() - begin;
+	printf("  parallel for : %.2f ms serial, %.2f ms parallel(%.1fx)\n", serial.count(), parallel.count(), serial.count() / parallel.count());
+	jobs.Shutdown();
+}
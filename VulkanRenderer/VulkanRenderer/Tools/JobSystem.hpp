@@ -0,0 +1,110 @@
+#pragma once
+#ifndef JOBSYSTEM_HPP
+#define JOBSYSTEM_HPP
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <exception>
+#include <cstdint>
+
+class JobSystem;
+
+// number of unfinished jobs of a group. JobSystem::Run increments it, the job decrements it when done.
+// jobs started with RunAfter(counter) are queued the moment it reaches zero.
+// destroy it only after JobSystem::Wait returned, a job may still be leaving it when IsDone turns true.
+// the first exception a job of the group throws is kept and rethrown by Wait.
+class JobCounter {
+public:
+	bool IsDone() const { return count.load() == 0; }
+private:
+	friend class JobSystem;
+	std::atomic<uint32_t> count{ 0 };
+	std::mutex mutex; // guards continuations and error
+	std::vector<std::function<void()>> continuations;
+	std::exception_ptr error;
+};
+
+// work stealing scheduler. every worker owns a deque : it pushes and pops its own jobs at the back(lifo, cache warm),
+// idle workers steal from the front of the others(fifo, oldest and usually biggest work first).
+// threads that aren't workers(the main thread, loaders) push to the shared deque 0.
+// Wait never blocks a thread that could help : it runs queued jobs until its counter is done.
+// jobs that must run on the main thread(GLFW) go through RunOnMainThread and run in RunMainThreadJobs or a main thread Wait.
+// long jobs(loading, decoding) go through RunBackground, only workers pick them up so a frame's Wait never runs one.
+class JobSystem {
+public:
+	JobSystem() {}
+	~JobSystem() { Shutdown(); }
+	JobSystem(const JobSystem& rhs) = delete;
+	JobSystem& operator=(const JobSystem& rhs) = delete;
+
+	// workerCount 0 : one worker per core besides the calling thread, which becomes the main thread
+	void Init(uint32_t workerCount = 0);
+	// waits for the workers to finish the job they're running, queued jobs are dropped
+	void Shutdown();
+	bool IsEnabled() const { return initialized; }
+
+	// thread safe. counter may be null
+	void Run(std::function<void()> job, JobCounter* counter = nullptr);
+	// job is queued once dependency reaches zero, right away if it already is
+	void RunAfter(JobCounter& dependency, std::function<void()> job, JobCounter* counter = nullptr);
+	// queued after every other job and only run by workers. runs right away on the calling thread without workers
+	void RunBackground(std::function<void()> job, JobCounter* counter = nullptr);
+	// runs other jobs until counter reaches zero, then rethrows the first exception of its jobs
+	void Wait(JobCounter& counter);
+	// calls func(first, last) for chunks of at most grain items of [0, count) and waits for all of them.
+	// rethrows the first exception of a chunk once every chunk is done
+	void ParallelFor(uint32_t count, uint32_t grain, const std::function<void(uint32_t, uint32_t)>& func);
+
+	// job runs on the thread that called Init
+	void RunOnMainThread(std::function<void()> job, JobCounter* counter = nullptr);
+	// call once per frame from the main thread
+	void RunMainThreadJobs();
+	bool IsMainThread() const { return std::this_thread::get_id() == mainThreadId; }
+
+	uint32_t GetWorkerCount() const { return static_cast<uint32_t>(workers.size()); }
+	// workers and the main thread, the range of GetThreadIndex
+	uint32_t GetThreadCount() const { return GetWorkerCount() + 1; }
+	// 0 on the main thread and any other thread that isn't a worker, worker i returns i + 1
+	uint32_t GetThreadIndex() const;
+
+	// spawn, steal and parallel for overhead on workerCount workers
+	static void RunBenchmark(uint32_t workerCount = 0);
+
+private:
+	struct Job {
+		std::function<void()> func;
+		JobCounter* counter = nullptr;
+	};
+	struct WorkQueue {
+		std::mutex mutex;
+		std::deque<Job> jobs;
+	};
+	std::vector<std::unique_ptr<WorkQueue>> queues; // [thread index]
+	WorkQueue backgroundQueue; // fifo, popped by workers once the other queues are empty
+	std::vector<std::thread> workers;
+	std::atomic<uint32_t> queuedJobs{ 0 };
+	std::atomic<uint32_t> sleepingWorkers{ 0 };
+	std::atomic<bool> stopping{ false };
+	std::mutex sleepMutex;
+	std::condition_variable wakeCondition;
+	std::mutex mainThreadMutex;
+	std::vector<Job> mainThreadJobs;
+	std::thread::id mainThreadId;
+	bool initialized = false;
+
+private:
+	void WorkerLoop(uint32_t threadIndex);
+	void Push(Job&& job);
+	bool TryPop(uint32_t threadIndex, Job& outJob);
+	// pops a job of the calling thread or steals one and runs it. false when every queue was empty
+	bool RunOneJob();
+	// a throwing job still finishes, its exception goes to the counter(printed when there's none)
+	void Execute(Job& job);
+	void Finish(JobCounter* counter);
+};
+#endif // !JOBSYSTEM_HPP
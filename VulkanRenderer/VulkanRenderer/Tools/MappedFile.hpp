@@ -0,0 +1,30 @@
+#pragma once
+#ifndef MAPPEDFILE_HPP
+#define MAPPEDFILE_HPP
+#include <string>
+#include <cstddef>
+
+// read only memory mapped file. the os pages data in on first touch, nothing is copied on open.
+class MappedFile {
+public:
+	MappedFile() {};
+	~MappedFile() { Close(); }
+	MappedFile(const MappedFile& rhs) = delete;
+	MappedFile& operator=(const MappedFile& rhs) = delete;
+
+	// returns false when the file doesn't exist, is empty or can't be mapped.
+	bool Open(const std::string& fn);
+	void Close();
+	const char* GetData() const { return data; }
+	size_t GetSize() const { return size; }
+	bool IsOpen() const { return data != nullptr; }
+
+private:
+	const char* data = nullptr;
+	size_t size = 0;
+#ifdef _WIN32
+	void* fileHandle = nullptr;
+	void* mappingHandle = nullptr;
+#endif
+};
+#endif // !MAPPEDFILE_HPP
@@ -0,0 +1,285 @@
+#include "Tools/MemoryAllocator.hpp"
+#include "Tools/Utils.hpp"
+#include <stdexcept>
+#include <iterator>
+#include <algorithm>
+#include <cstdio>
+
+namespace {
+	inline VkDeviceSize AlignUp(VkDeviceSize value, VkDeviceSize alignment) {
+		return alignment > 1 ? (value + alignment - 1) / alignment * alignment : value;
+	}
+	// bufferImageGranularity is always power of two
+	inline bool OnSamePage(VkDeviceSize lastByteOfA, VkDeviceSize firstByteOfB, VkDeviceSize pageSize) {
+		return (lastByteOfA & ~(pageSize - 1)) == (firstByteOfB & ~(pageSize - 1));
+	}
+	// linear resources(buffer, linear image) and optimal images can't share a page
+	inline bool IsGranularityConflict(SuballocationType a, SuballocationType b) {
+		if (a == SuballocationType::Free || b == SuballocationType::Free) return false;
+		return (a == SuballocationType::ImageOptimal) != (b == SuballocationType::ImageOptimal);
+	}
+}
+
+#pragma region RangeAllocator
+void RangeAllocator::Init(VkDeviceSize _size, VkDeviceSize _granularity) {
+	size = _size;
+	granularity = std::max<VkDeviceSize>(_granularity, 1);
+	Clear();
+}
+
+void RangeAllocator::Clear() {
+	ranges.clear();
+	ranges[0] = { size, SuballocationType::Free };
+	usedSize = 0;
+	allocationCount = 0;
+}
+
+// best fit. the smallest free range that can hold the allocation is used.
+bool RangeAllocator::Allocate(VkDeviceSize allocSize, VkDeviceSize alignment, SuballocationType type, VkDeviceSize& outOffset) {
+	if (allocSize == 0 || allocSize > GetFreeSize()) return false;
+	auto best = ranges.end();
+	VkDeviceSize bestStart = 0;
+	VkDeviceSize bestRangeSize = UINT64_MAX;
+	for (auto it = ranges.begin(); it != ranges.end(); ++it) {
+		if (it->second.type != SuballocationType::Free || it->second.size < allocSize) continue;
+		VkDeviceSize rangeEnd = it->first + it->second.size;
+		VkDeviceSize start = AlignUp(it->first, alignment);
+		//neighbours of a free range are always in use, because free ranges are merged on Free().
+		if (granularity > 1 && it != ranges.begin()) {
+			auto prev = std::prev(it);
+			if (IsGranularityConflict(prev->second.type, type) && OnSamePage(prev->first + prev->second.size - 1, start, granularity)) {
+				start = AlignUp(start, granularity);
+			}
+		}
+		if (start + allocSize > rangeEnd) continue;
+		auto next = std::next(it);
+		if (granularity > 1 && next != ranges.end()) {
+			if (IsGranularityConflict(type, next->second.type) && OnSamePage(start + allocSize - 1, next->first, granularity)) continue;
+		}
+		if (it->second.size < bestRangeSize) {
+			best = it;
+			bestStart = start;
+			bestRangeSize = it->second.size;
+		}
+	}
+	if (best == ranges.end()) return false;
+
+	VkDeviceSize rangeOffset = best->first;
+	VkDeviceSize rangeEnd = rangeOffset + best->second.size;
+	if (bestStart > rangeOffset) {
+		best->second.size = bestStart - rangeOffset; //alignment padding stays free
+	}
+	else {
+		ranges.erase(best);
+	}
+	ranges[bestStart] = { allocSize, type };
+	if (bestStart + allocSize < rangeEnd) {
+		ranges[bestStart + allocSize] = { rangeEnd - (bestStart + allocSize), SuballocationType::Free };
+	}
+	usedSize += allocSize;
+	allocationCount++;
+	outOffset = bestStart;
+	return true;
+}
+
+void RangeAllocator::Free(VkDeviceSize offset) {
+	auto it = ranges.find(offset);
+	if (it == ranges.end() || it->second.type == SuballocationType::Free) {
+		throw std::runtime_error("tried to free a range that was not allocated!");
+	}
+	usedSize -= it->second.size;
+	allocationCount--;
+	it->second.type = SuballocationType::Free;
+
+	auto next = std::next(it);
+	if (next != ranges.end() && next->second.type == SuballocationType::Free) {
+		it->second.size += next->second.size;
+		ranges.erase(next);
+	}
+	if (it != ranges.begin()) {
+		auto prev = std::prev(it);
+		if (prev->second.type == SuballocationType::Free) {
+			prev->second.size += it->second.size;
+			ranges.erase(it);
+		}
+	}
+}
+
+VkDeviceSize RangeAllocator::GetLargestFreeRange() const {
+	VkDeviceSize largest = 0;
+	for (const auto& range : ranges) {
+		if (range.second.type == SuballocationType::Free) largest = std::max(largest, range.second.size);
+	}
+	return largest;
+}
+
+uint32_t RangeAllocator::GetFreeRangeCount() const {
+	uint32_t count = 0;
+	for (const auto& range : ranges) {
+		if (range.second.type == SuballocationType::Free) count++;
+	}
+	return count;
+}
+#pragma endregion
+
+#pragma region MemoryAllocator
+void MemoryAllocator::Init(VkDevice _device, VkPhysicalDevice _physicalDevice, VkDeviceSize _preferredBlockSize) {
+	device = _device;
+	physicalDevice = _physicalDevice;
+	preferredBlockSize = _preferredBlockSize;
+	vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+	VkPhysicalDeviceProperties properties{};
+	vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+	bufferImageGranularity = properties.limits.bufferImageGranularity;
+	blocks.resize(memProperties.memoryTypeCount);
+}
+
+void MemoryAllocator::Destroy() {
+	std::lock_guard<std::mutex> lock(mutex);
+	for (auto& typeBlocks : blocks) {
+		for (auto& block : typeBlocks) {
+			if (block.memory != VK_NULL_HANDLE) FreeDeviceMemory(block.memory, block.mapped);
+		}
+		typeBlocks.clear();
+	}
+}
+
+// small heaps(integrated gpu, BAR memory) use 1/8 of heap as block size
+VkDeviceSize MemoryAllocator::GetBlockSize(uint32_t memoryTypeIndex) const {
+	VkDeviceSize heapSize = memProperties.memoryHeaps[memProperties.memoryTypes[memoryTypeIndex].heapIndex].size;
+	const VkDeviceSize smallHeapMaxSize = 1024ull * 1024 * 1024;
+	return heapSize <= smallHeapMaxSize ? heapSize / 8 : preferredBlockSize;
+}
+
+VkDeviceMemory MemoryAllocator::AllocateDeviceMemory(VkDeviceSize size, uint32_t memoryTypeIndex, void** outMapped) {
+	VkMemoryAllocateInfo allocInfo = Initializer::InitMemoryAllocateInfo(size, memoryTypeIndex);
+	VkDeviceMemory memory;
+	if (vkAllocateMemory(device, &allocInfo, nullptr, &memory) != VK_SUCCESS) {
+		throw std::runtime_error("failed to allocate device memory!");
+	}
+	totalAllocateCalls++;
+	*outMapped = nullptr;
+	if (memProperties.memoryTypes[memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+		vkMapMemory(device, memory, 0, VK_WHOLE_SIZE, 0, outMapped); //persistent mapping
+	}
+	return memory;
+}
+
+void MemoryAllocator::FreeDeviceMemory(VkDeviceMemory memory, void* mapped) {
+	if (mapped != nullptr) vkUnmapMemory(device, memory);
+	vkFreeMemory(device, memory, nullptr);
+}
+
+MemoryAllocation MemoryAllocator::Allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties, SuballocationType type) {
+	std::lock_guard<std::mutex> lock(mutex);
+	MemoryAllocation allocation;
+	allocation.memoryTypeIndex = Utils::findMemoryType(physicalDevice, requirements.memoryTypeBits, properties);
+	allocation.size = requirements.size;
+	VkDeviceSize blockSize = GetBlockSize(allocation.memoryTypeIndex);
+
+	//big resources(4k texture with mip chain) would waste most of a block, so they get their own memory.
+	if (requirements.size > blockSize / 2) {
+		allocation.memory = AllocateDeviceMemory(requirements.size, allocation.memoryTypeIndex, &allocation.mapped);
+		allocation.offset = 0;
+		allocation.blockIndex = UINT32_MAX;
+		dedicatedCount++;
+		dedicatedBytes += requirements.size;
+		return allocation;
+	}
+
+	auto& typeBlocks = blocks[allocation.memoryTypeIndex];
+	uint32_t emptySlot = UINT32_MAX;
+	for (uint32_t i = 0; i < typeBlocks.size(); i++) {
+		MemoryBlock& block = typeBlocks[i];
+		if (block.memory == VK_NULL_HANDLE) {
+			if (emptySlot == UINT32_MAX) emptySlot = i;
+			continue;
+		}
+		if (block.ranges.Allocate(requirements.size, requirements.alignment, type, allocation.offset)) {
+			allocation.memory = block.memory;
+			allocation.mapped = block.mapped ? static_cast<char*>(block.mapped) + allocation.offset : nullptr;
+			allocation.blockIndex = i;
+			return allocation;
+		}
+	}
+
+	if (emptySlot == UINT32_MAX) {
+		emptySlot = static_cast<uint32_t>(typeBlocks.size());
+		typeBlocks.emplace_back();
+	}
+	MemoryBlock& block = typeBlocks[emptySlot];
+	block.memory = AllocateDeviceMemory(blockSize, allocation.memoryTypeIndex, &block.mapped);
+	block.ranges.Init(blockSize, bufferImageGranularity);
+	if (!block.ranges.Allocate(requirements.size, requirements.alignment, type, allocation.offset)) {
+		throw std::runtime_error("failed to sub-allocate device memory!");
+	}
+	allocation.memory = block.memory;
+	allocation.mapped = block.mapped ? static_cast<char*>(block.mapped) + allocation.offset : nullptr;
+	allocation.blockIndex = emptySlot;
+	return allocation;
+}
+
+void MemoryAllocator::Free(MemoryAllocation& allocation) {
+	if (allocation.memory == VK_NULL_HANDLE) return;
+	std::lock_guard<std::mutex> lock(mutex);
+	if (allocation.blockIndex == UINT32_MAX) {
+		FreeDeviceMemory(allocation.memory, allocation.mapped);
+		dedicatedCount--;
+		dedicatedBytes -= allocation.size;
+	}
+	else {
+		auto& typeBlocks = blocks[allocation.memoryTypeIndex];
+		MemoryBlock& block = typeBlocks[allocation.blockIndex];
+		block.ranges.Free(allocation.offset);
+		//keep one empty block per memory type, so load/unload patterns don't hit vkAllocateMemory every time.
+		if (block.ranges.IsEmpty()) {
+			bool hasOtherEmptyBlock = false;
+			for (uint32_t i = 0; i < typeBlocks.size(); i++) {
+				if (i != allocation.blockIndex && typeBlocks[i].memory != VK_NULL_HANDLE && typeBlocks[i].ranges.IsEmpty()) {
+					hasOtherEmptyBlock = true;
+					break;
+				}
+			}
+			if (hasOtherEmptyBlock) {
+				FreeDeviceMemory(block.memory, block.mapped);
+				block.memory = VK_NULL_HANDLE;
+				block.mapped = nullptr;
+			}
+		}
+	}
+	allocation = MemoryAllocation{};
+}
+
+MemoryStats MemoryAllocator::GetStats() const {
+	std::lock_guard<std::mutex> lock(mutex);
+	MemoryStats stats;
+	VkDeviceSize freeBytes = 0;
+	for (const auto& typeBlocks : blocks) {
+		for (const auto& block : typeBlocks) {
+			if (block.memory == VK_NULL_HANDLE) continue;
+			stats.deviceMemoryCount++;
+			stats.allocationCount += block.ranges.GetAllocationCount();
+			stats.reservedBytes += block.ranges.GetSize();
+			stats.usedBytes += block.ranges.GetUsedSize();
+			freeBytes += block.ranges.GetFreeSize();
+			stats.largestFreeRange = std::max(stats.largestFreeRange, block.ranges.GetLargestFreeRange());
+		}
+	}
+	stats.deviceMemoryCount += dedicatedCount;
+	stats.dedicatedCount = dedicatedCount;
+	stats.allocationCount += dedicatedCount;
+	stats.reservedBytes += dedicatedBytes;
+	stats.usedBytes += dedicatedBytes;
+	stats.totalAllocateCalls = totalAllocateCalls;
+	stats.fragmentation = freeBytes > 0 ? 1.0f - static_cast<float>(stats.largestFreeRange) / static_cast<float>(freeBytes) : 0.0f;
+	return stats;
+}
+
+void MemoryAllocator::PrintStats() const {
+	MemoryStats stats = GetStats();
+	printf("Device memory : %u VkDeviceMemory (%u dedicated), %u allocations, %llu vkAllocateMemory calls\n",
+		stats.deviceMemoryCount, stats.dedicatedCount, stats.allocationCount, static_cast<unsigned long long>(stats.totalAllocateCalls));
+	printf("                used %.2f MB / reserved %.2f MB, largest free range %.2f MB, fragmentation %.3f\n",
+		stats.usedBytes / (1024.0 * 1024.0), stats.reservedBytes / (1024.0 * 1024.0), stats.largestFreeRange / (1024.0 * 1024.0), stats.fragmentation);
+}
+#pragma endregion
@@ -0,0 +1,102 @@
+#pragma once
+#ifndef MEMORYALLOCATOR_HPP
+#define MEMORYALLOCATOR_HPP
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <cstdint>
+
+enum class SuballocationType : uint8_t {
+	Free,
+	Buffer,
+	ImageLinear,
+	ImageOptimal
+};
+
+// offset ordered free-list over a linear range [0, size).
+// used ranges of different type never share a bufferImageGranularity page.
+class RangeAllocator {
+public:
+	void Init(VkDeviceSize _size, VkDeviceSize _granularity = 1);
+	bool Allocate(VkDeviceSize allocSize, VkDeviceSize alignment, SuballocationType type, VkDeviceSize& outOffset);
+	void Free(VkDeviceSize offset);
+	void Clear();
+
+	VkDeviceSize GetSize() const { return size; }
+	VkDeviceSize GetUsedSize() const { return usedSize; }
+	VkDeviceSize GetFreeSize() const { return size - usedSize; }
+	VkDeviceSize GetLargestFreeRange() const;
+	uint32_t GetAllocationCount() const { return allocationCount; }
+	uint32_t GetFreeRangeCount() const;
+	bool IsEmpty() const { return allocationCount == 0; }
+
+private:
+	struct Range {
+		VkDeviceSize size = 0;
+		SuballocationType type = SuballocationType::Free;
+	};
+	std::map<VkDeviceSize, Range> ranges; // key : offset. ranges cover the whole [0, size) without gaps.
+	VkDeviceSize size = 0;
+	VkDeviceSize granularity = 1;
+	VkDeviceSize usedSize = 0;
+	uint32_t allocationCount = 0;
+};
+
+struct MemoryAllocation {
+	VkDeviceMemory memory = VK_NULL_HANDLE;
+	VkDeviceSize offset = 0;
+	VkDeviceSize size = 0;
+	void* mapped = nullptr; // already offset. nullptr if memory is not host visible
+	uint32_t memoryTypeIndex = 0;
+	uint32_t blockIndex = UINT32_MAX; // UINT32_MAX : dedicated allocation
+};
+
+struct MemoryStats {
+	uint32_t deviceMemoryCount = 0;		// live vkAllocateMemory objects (blocks + dedicated)
+	uint32_t dedicatedCount = 0;
+	uint32_t allocationCount = 0;		// live sub-allocations
+	uint64_t totalAllocateCalls = 0;	// vkAllocateMemory calls since Init
+	VkDeviceSize reservedBytes = 0;
+	VkDeviceSize usedBytes = 0;
+	VkDeviceSize largestFreeRange = 0;
+	float fragmentation = 0.0f;			// 1 - largestFreeRange / total free bytes in blocks
+};
+
+// block based device memory allocator.
+// one list of large VkDeviceMemory blocks per memory type, resources are sub-allocated from the blocks.
+// thread safe. models are loaded on worker threads while the main thread renders.
+class MemoryAllocator {
+public:
+	void Init(VkDevice _device, VkPhysicalDevice _physicalDevice, VkDeviceSize _preferredBlockSize = 64ull * 1024 * 1024);
+	void Destroy();
+	MemoryAllocation Allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties, SuballocationType type);
+	void Free(MemoryAllocation& allocation);
+	MemoryStats GetStats() const;
+	void PrintStats() const;
+
+private:
+	struct MemoryBlock {
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		void* mapped = nullptr;
+		RangeAllocator ranges;
+	};
+	VkDevice device = VK_NULL_HANDLE;
+	VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+	VkPhysicalDeviceMemoryProperties memProperties{};
+	VkDeviceSize bufferImageGranularity = 1;
+	VkDeviceSize preferredBlockSize = 0;
+	std::vector<std::vector<MemoryBlock>> blocks; // [memoryTypeIndex][blockIndex], freed blocks keep their slot
+	uint32_t dedicatedCount = 0;
+	VkDeviceSize dedicatedBytes = 0;
+	uint64_t totalAllocateCalls = 0;
+	mutable std::mutex mutex;
+
+private:
+	VkDeviceSize GetBlockSize(uint32_t memoryTypeIndex) const;
+	VkDeviceMemory AllocateDeviceMemory(VkDeviceSize size, uint32_t memoryTypeIndex, void** outMapped);
+	void FreeDeviceMemory(VkDeviceMemory memory, void* mapped);
+};
+#endif // !MEMORYALLOCATOR_HPP
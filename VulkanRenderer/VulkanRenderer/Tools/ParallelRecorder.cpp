@@ -0,0 +1,112 @@
+#include "Tools/ParallelRecorder.hpp"
+#include "Tools/JobSystem.hpp"
+#include "Tools/Utils.hpp"
+#include <stdexcept>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+
+namespace {
+	// fewer draws than this aren't worth a secondary buffer and a job of their own
+	const uint32_t MIN_CHUNK_DRAWS = 64;
+}
+
+void ParallelRecorder::Init(VkDevice _device, uint32_t queueFamily, uint32_t _frameCount, JobSystem& _jobSystem) {
+	device = _device;
+	jobSystem = &_jobSystem;
+	frameCount = _frameCount;
+	threadCount = jobSystem->GetThreadCount();
+	commands.resize(frameCount * threadCount);
+	for (ThreadCommands& threadCommands : commands) {
+		//transient : the buffers are recorded once per use and reset with their pool
+		VkCommandPoolCreateInfo poolInfo{};
+		poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+		poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+		poolInfo.queueFamilyIndex = queueFamily;
+		if (vkCreateCommandPool(device, &poolInfo, nullptr, &threadCommands.pool) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create recording command pool!");
+		}
+	}
+}
+
+void ParallelRecorder::Destroy() {
+	if (device == VK_NULL_HANDLE) return;
+	for (ThreadCommands& threadCommands : commands) {
+		vkDestroyCommandPool(device, threadCommands.pool, nullptr);
+	}
+	commands.clear();
+	device = VK_NULL_HANDLE;
+}
+
+void ParallelRecorder::BeginFrame(uint32_t frame) {
+	currentFrame = frame % frameCount;
+	for (uint32_t i = 0; i < threadCount; i++) {
+		ThreadCommands& threadCommands = commands[currentFrame * threadCount + i];
+		vkResetCommandPool(device, threadCommands.pool, 0);
+		threadCommands.usedCount = 0;
+	}
+}
+
+VkCommandBuffer ParallelRecorder::AcquireCommandBuffer() {
+	ThreadCommands& threadCommands = commands[currentFrame * threadCount + jobSystem->GetThreadIndex()];
+	if (threadCommands.usedCount == threadCommands.commandBuffers.size()) {
+		VkCommandBuffer commandBuffer;
+		VkCommandBufferAllocateInfo allocInfo = Initializer::InitCommandBufferAllocateInfo(threadCommands.pool, 1, VK_COMMAND_BUFFER_LEVEL_SECONDARY);
+		if (vkAllocateCommandBuffers(device, &allocInfo, &commandBuffer) != VK_SUCCESS) {
+			throw std::runtime_error("failed to allocate secondary command buffer!");
+		}
+		threadCommands.commandBuffers.push_back(commandBuffer);
+	}
+	return threadCommands.commandBuffers[threadCommands.usedCount++];
+}
+
+void ParallelRecorder::Record(VkCommandBuffer primary, VkRenderPass renderPass, VkFramebuffer framebuffer, uint32_t itemCount,
+	const std::function<void(VkCommandBuffer, uint32_t, uint32_t)>& recordFunc) {
+	if (itemCount == 0) return;
+	auto begin = std::chrono::high_resolution_clock::now();
+	VkCommandBufferInheritanceInfo inheritance{};
+	inheritance.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+	inheritance.renderPass = renderPass;
+	inheritance.subpass = 0;
+	inheritance.framebuffer = framebuffer;
+
+	//a few chunks per thread, so a thread that finishes early steals the rest
+	uint32_t chunkSize = std::max(MIN_CHUNK_DRAWS, (itemCount + threadCount * 4 - 1) / (threadCount * 4));
+	uint32_t chunkCount = (itemCount + chunkSize - 1) / chunkSize;
+	std::vector<VkCommandBuffer> secondaries(chunkCount, VK_NULL_HANDLE);
+	std::exception_ptr error;
+	std::mutex errorMutex;
+	jobSystem->ParallelFor(chunkCount, 1, [&](uint32_t firstChunk, uint32_t lastChunk) {
+		for (uint32_t chunk = firstChunk; chunk < lastChunk; chunk++) {
+			try {
+				VkCommandBuffer commandBuffer = AcquireCommandBuffer();
+				VkCommandBufferBeginInfo beginInfo = Initializer::InitCommandBufferBeginInfo(
+					VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT, &inheritance);
+				if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+					throw std::runtime_error("failed to begin secondary command buffer!");
+				}
+				recordFunc(commandBuffer, chunk * chunkSize, std::min((chunk + 1) * chunkSize, itemCount));
+				if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+					throw std::runtime_error("failed to record secondary command buffer!");
+				}
+				secondaries[chunk] = commandBuffer;
+			}
+			catch (...) {
+				std::lock_guard<std::mutex> lock(errorMutex);
+				if (!error) error = std::current_exception();
+			}
+		}
+	});
+	if (error) std::rethrow_exception(error);
+
+	//chunks are contiguous, executing them in chunk order keeps the draw order of a single thread
+	vkCmdExecuteCommands(primary, chunkCount, secondaries.data());
+	std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - begin;
+	recordCount++;
+	totalRecordMs += elapsed.count();
+}
+
+void ParallelRecorder::PrintStats() const {
+	printf("Parallel recorder : %u thread(s), %llu recording(s), %.3f ms average\n", threadCount,
+		static_cast<unsigned long long>(recordCount), recordCount > 0 ? totalRecordMs / recordCount : 0.0);
+}
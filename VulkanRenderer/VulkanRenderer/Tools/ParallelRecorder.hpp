@@ -0,0 +1,57 @@
+#pragma once
+#ifndef PARALLELRECORDER_HPP
+#define PARALLELRECORDER_HPP
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+#include <vector>
+#include <mutex>
+#include <functional>
+#include <exception>
+#include <cstdint>
+
+class JobSystem;
+
+// records the draws of a render pass as jobs into secondary command buffers.
+// every thread of the job system owns a command pool per frame in flight, so no pool is ever touched by two threads
+// and a frame's pools are reset in one call once the gpu is done with them(BeginFrame).
+class ParallelRecorder {
+public:
+	void Init(VkDevice _device, uint32_t queueFamily, uint32_t _frameCount, JobSystem& _jobSystem);
+	void Destroy();
+	bool IsEnabled() const { return device != VK_NULL_HANDLE; }
+
+	// the gpu must be done with the previous use of frame(its in flight fence was waited).
+	void BeginFrame(uint32_t frame);
+	// splits [0, itemCount) into contiguous chunks and calls recordFunc(commandBuffer, first, last) for every chunk
+	// on whichever thread runs its job. commandBuffer is a secondary buffer continuing subpass 0 of renderPass and inherits no state,
+	// recordFunc binds the pipeline, dynamic state and descriptor sets itself.
+	// blocks, helping with the chunks, and executes them into primary in chunk order, so the draw order is kept.
+	// primary must be inside renderPass, begun with VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS. rethrows recording errors.
+	// call from the thread that calls Renderer::Render, the main thread or the render thread.
+	void Record(VkCommandBuffer primary, VkRenderPass renderPass, VkFramebuffer framebuffer, uint32_t itemCount,
+		const std::function<void(VkCommandBuffer, uint32_t, uint32_t)>& recordFunc);
+	uint32_t GetThreadCount() const { return threadCount; }
+	void PrintStats() const;
+
+private:
+	struct ThreadCommands {
+		VkCommandPool pool = VK_NULL_HANDLE;
+		std::vector<VkCommandBuffer> commandBuffers; // allocated on demand, kept across resets
+		size_t usedCount = 0;
+	};
+	VkDevice device = VK_NULL_HANDLE;
+	JobSystem* jobSystem = nullptr;
+	uint32_t frameCount = 0;
+	uint32_t threadCount = 0;
+	uint32_t currentFrame = 0;
+	std::vector<ThreadCommands> commands; // [frame * threadCount + thread index of the job system]
+
+	uint64_t recordCount = 0;
+	double totalRecordMs = 0.0;
+
+private:
+	// a secondary buffer of the calling thread's pool for this frame
+	VkCommandBuffer AcquireCommandBuffer();
+};
+#endif // !PARALLELRECORDER_HPP
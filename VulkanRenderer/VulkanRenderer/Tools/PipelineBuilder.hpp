@@ -7,6 +7,8 @@
 #include <vector>
 #include <stdexcept>
 #include "FileLoader.hpp"
+#include "ShaderCompiler.hpp"
+#include "PipelineTable.hpp"
 #include "Utils.hpp"
 #include "Model/Mesh.hpp"
 namespace PipelineBuilder {
@@ -23,7 +25,13 @@ namespace PipelineBuilder {
 		VkPipelineColorBlendStateCreateInfo colorBlending{};
 	}PipelineCteateInfos;
 
-	VkShaderModule CreateShaderModule(VkDevice device, const std::vector<char>& code) {
+	// .spv files are loaded as they are, glsl sources go through ShaderCompiler and its cache
+	inline std::vector<char> LoadShader(const std::string& fn) {
+		if (std::filesystem::path(fn).extension() == ".spv") return FileLoader::LoadShaderfile(fn);
+		return ShaderCompiler::GetInstance().Compile(fn);
+	}
+
+	inline VkShaderModule CreateShaderModule(VkDevice device, const std::vector<char>& code) {
 		VkShaderModuleCreateInfo createInfo{};
 		createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
 		createInfo.codeSize = code.size();
@@ -36,7 +44,9 @@ namespace PipelineBuilder {
 		return shaderModule;
 	}
 
-	void CreateGraphicsPipeline(VkPipeline& out, VkPipelineLayout pipelineLayout, VkRenderPass renderPass, VkDevice device, PipelineCreateInfos& infos, uint32_t subpass = 0) {
+	// pipelineCache : Renderer::pipelineCache.Get() so the driver reuses what earlier runs compiled
+	inline void CreateGraphicsPipeline(VkPipeline& out, VkPipelineLayout pipelineLayout, VkRenderPass renderPass, VkDevice device, PipelineCreateInfos& infos, uint32_t subpass = 0,
+		VkPipelineCache pipelineCache = VK_NULL_HANDLE) {
 		VkGraphicsPipelineCreateInfo pipelineCreateInfo{};
 		pipelineCreateInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
 		pipelineCreateInfo.stageCount = static_cast<uint32_t>(infos.shaderStages.size());
@@ -54,12 +64,13 @@ namespace PipelineBuilder {
 		pipelineCreateInfo.subpass = subpass;
 		pipelineCreateInfo.basePipelineHandle = VK_NULL_HANDLE;
 		pipelineCreateInfo.basePipelineIndex = -1;
-		if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineCreateInfo, nullptr, &out) != VK_SUCCESS) {
+		if (vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &out) != VK_SUCCESS) {
 			throw std::runtime_error("failed to create graphicsPipeline!");
 		}
 	}
 
-	void CreateDefaultRenderPass(VkRenderPass& out,VkDevice device, VkPhysicalDevice physicalDevice, VkFormat swapChainFormat) {
+	// storeDepth keeps the depth attachment after the pass(hi-z pyramid)
+	inline void CreateDefaultRenderPass(VkRenderPass& out,VkDevice device, VkPhysicalDevice physicalDevice, VkFormat swapChainFormat, bool storeDepth = false) {
 		VkAttachmentDescription colorAttachment{};
 		colorAttachment.format = swapChainFormat;
 		colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
@@ -74,7 +85,7 @@ namespace PipelineBuilder {
 		depthAttachment.format = Utils::findDepthFormat(physicalDevice);
 		depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
 		depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-		depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		depthAttachment.storeOp = storeDepth ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
 		depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
 		depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
 		depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
@@ -94,12 +105,13 @@ namespace PipelineBuilder {
 		subpass.pColorAttachments = &colorAttachmentRef;
 		subpass.pDepthStencilAttachment = &depthAttachmentRef;
 
+		//every frame clears the one depth buffer, after the previous frame's depth writes
 		VkSubpassDependency dependency{};
 		dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
 		dependency.dstSubpass = 0;
-		dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
-		dependency.srcAccessMask = 0;
-		dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+		dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+		dependency.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
 		dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
 
 		std::vector<VkAttachmentDescription> attachments = { colorAttachment, depthAttachment };
@@ -117,13 +129,53 @@ namespace PipelineBuilder {
 		}
 	}
 
-	// no support stencil test, color blending, multisampling
-	void CreateDefaultGraphicsPipeline(VkPipeline& out_pipeline, VkPipelineLayout& out_pipelineLayout, const VkDevice device, const std::string& vsFilename, const std::string& fsFilename, const VkRenderPass renderpass, VkDescriptorSetLayout& descriptorSetLayout) {
-		auto vertShaderCode = FileLoader::LoadShaderfile(vsFilename);
-		auto fragShaderCode = FileLoader::LoadShaderfile(fsFilename);
+	inline void CreatePipelineLayout(VkPipelineLayout& out_pipelineLayout, const VkDevice device, const std::vector<VkDescriptorSetLayout>& descriptorSetLayouts,
+		const std::vector<VkPushConstantRange>& pushConstantRanges = {}) {
+		VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(descriptorSetLayouts.size());
+		pipelineLayoutInfo.pSetLayouts = descriptorSetLayouts.data();
+		pipelineLayoutInfo.pushConstantRangeCount = static_cast<uint32_t>(pushConstantRanges.size());
+		pipelineLayoutInfo.pPushConstantRanges = pushConstantRanges.data();
+
+		if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &out_pipelineLayout) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create pipeline layout");
+		}
+	}
+
+	// the default pipeline's state with Vertex(and InstanceData as binding 1 when instanced) as vertex input. shaders are left empty
+	inline GraphicsPipelineState GetDefaultPipelineState(const VkPipelineLayout pipelineLayout, const VkRenderPass renderpass, bool instanced = false) {
+		GraphicsPipelineState state;
+		state.layout = pipelineLayout;
+		state.renderPass = renderpass;
+		state.bindings = { Vertex::GetBindingDescription() };
+		auto vertexAttributes = Vertex::GetAttributeDescriptons();
+		state.attributes.assign(vertexAttributes.begin(), vertexAttributes.end());
+		if (instanced) {
+			state.bindings.push_back(InstanceData::GetBindingDescription());
+			auto instanceAttributes = InstanceData::GetAttributeDescriptons();
+			state.attributes.insert(state.attributes.end(), instanceAttributes.begin(), instanceAttributes.end());
+		}
+		return state;
+	}
 
-		VkShaderModule vertShaderModule = CreateShaderModule(device, vertShaderCode);
-		VkShaderModule fragShaderModule = CreateShaderModule(device, fragShaderCode);
+	// no support stencil test, multisampling
+	// the layout is only read, so worker threads can build pipelines of a shared layout(PipelineManager)
+	inline void CreateGraphicsPipeline(VkPipeline& out_pipeline, const VkDevice device, const GraphicsPipelineState& state, VkPipelineCache pipelineCache = VK_NULL_HANDLE) {
+		VkShaderModule vertShaderModule = CreateShaderModule(device, state.vertexCode);
+		VkShaderModule fragShaderModule = CreateShaderModule(device, state.fragmentCode);
+
+		std::vector<VkSpecializationMapEntry> mapEntries(state.fragmentConstants.size());
+		for (uint32_t i = 0; i < mapEntries.size(); i++) {
+			mapEntries[i].constantID = i;
+			mapEntries[i].offset = i * sizeof(uint32_t);
+			mapEntries[i].size = sizeof(uint32_t);
+		}
+		VkSpecializationInfo specialization{};
+		specialization.mapEntryCount = static_cast<uint32_t>(mapEntries.size());
+		specialization.pMapEntries = mapEntries.data();
+		specialization.dataSize = state.fragmentConstants.size() * sizeof(uint32_t);
+		specialization.pData = state.fragmentConstants.data();
 
 		VkPipelineShaderStageCreateInfo vertShaderStageInfo{};
 		vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
@@ -138,129 +190,115 @@ namespace PipelineBuilder {
 		fragShaderStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
 		fragShaderStageInfo.module = fragShaderModule;
 		fragShaderStageInfo.pName = "main";
+		fragShaderStageInfo.pSpecializationInfo = mapEntries.empty() ? nullptr : &specialization;
 
-		VkPipelineShaderStageCreateInfo shaderStages[] = { vertShaderStageInfo, fragShaderStageInfo };
+		PipelineCreateInfos infos;
+		infos.shaderStages = { vertShaderStageInfo, fragShaderStageInfo };
 
-		//after write model class, re-write;
-		VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
-		vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-		auto bindingDescription = Vertex::GetBindingDescription();
-		auto attributeDescription = Vertex::GetAttributeDescriptons();
-		vertexInputInfo.vertexBindingDescriptionCount = 1;
-		vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
-		vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescription.size());
-		vertexInputInfo.pVertexAttributeDescriptions = attributeDescription.data();
+		infos.vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+		infos.vertexInputInfo.vertexBindingDescriptionCount = static_cast<uint32_t>(state.bindings.size());
+		infos.vertexInputInfo.pVertexBindingDescriptions = state.bindings.data();
+		infos.vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(state.attributes.size());
+		infos.vertexInputInfo.pVertexAttributeDescriptions = state.attributes.data();
 
-		VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
-		inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-		inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
-		inputAssembly.primitiveRestartEnable = VK_FALSE;
+		infos.inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+		infos.inputAssembly.topology = state.topology;
+		infos.inputAssembly.primitiveRestartEnable = VK_FALSE;
 
 		std::vector<VkDynamicState> dynamicStates = {
 			VK_DYNAMIC_STATE_VIEWPORT,
 			VK_DYNAMIC_STATE_SCISSOR
 		};
+		infos.dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+		infos.dynamicState.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
+		infos.dynamicState.pDynamicStates = dynamicStates.data();
 
-		VkPipelineDynamicStateCreateInfo dynamicStae{};
-		dynamicStae.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
-		dynamicStae.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
-		dynamicStae.pDynamicStates = dynamicStates.data();
+		infos.vieportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+		infos.vieportState.viewportCount = 1;
+		infos.vieportState.scissorCount = 1;
 
-		VkPipelineViewportStateCreateInfo viewportState{};
-		viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-		viewportState.viewportCount = 1;
-		viewportState.scissorCount = 1;
+		infos.rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+		infos.rasterizer.depthClampEnable = VK_FALSE;
+		infos.rasterizer.rasterizerDiscardEnable = VK_FALSE;
+		infos.rasterizer.polygonMode = state.polygonMode;
+		infos.rasterizer.lineWidth = 1.0f;
+		infos.rasterizer.cullMode = state.cullMode;
+		infos.rasterizer.frontFace = state.frontFace;
+		infos.rasterizer.depthBiasEnable = VK_FALSE;
 
-		VkPipelineRasterizationStateCreateInfo rasterizer{};
-		rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
-		rasterizer.depthClampEnable = VK_FALSE;
-		rasterizer.rasterizerDiscardEnable = VK_FALSE;
-		rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
-		rasterizer.lineWidth = 1.0f;
-		rasterizer.cullMode = VK_CULL_MODE_BACK_BIT;
-		rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
-		rasterizer.depthBiasEnable = VK_FALSE;
-		rasterizer.depthBiasConstantFactor = 0.0f;
-		rasterizer.depthBiasClamp = 0.0f;
-		rasterizer.depthBiasSlopeFactor = 0.0f;
+		infos.depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+		infos.depthStencil.depthTestEnable = state.depthTest ? VK_TRUE : VK_FALSE;
+		infos.depthStencil.depthWriteEnable = state.depthWrite ? VK_TRUE : VK_FALSE;
+		infos.depthStencil.depthCompareOp = state.depthCompareOp;
+		infos.depthStencil.depthBoundsTestEnable = VK_FALSE;
+		infos.depthStencil.minDepthBounds = 0.0f;
+		infos.depthStencil.maxDepthBounds = 1.0f;
+		infos.depthStencil.stencilTestEnable = VK_FALSE;
 
-		VkPipelineDepthStencilStateCreateInfo depthStencil{};
-		depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
-		depthStencil.depthTestEnable = VK_TRUE;
-		depthStencil.depthWriteEnable = VK_TRUE;
-		depthStencil.depthCompareOp = VK_COMPARE_OP_LESS;
-		depthStencil.depthBoundsTestEnable = VK_FALSE;
-		depthStencil.minDepthBounds = 0.0f;
-		depthStencil.maxDepthBounds = 1.0f;
-		depthStencil.stencilTestEnable = VK_FALSE;
-		depthStencil.front = {};
-		depthStencil.back = {};
+		infos.multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+		infos.multisampling.sampleShadingEnable = VK_FALSE;
+		infos.multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+		infos.multisampling.minSampleShading = 1.0f;
 
-		VkPipelineMultisampleStateCreateInfo multisampling{};
-		multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-		multisampling.sampleShadingEnable = VK_FALSE;
-		multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
-		multisampling.minSampleShading = 1.0f;
-		multisampling.pSampleMask = nullptr;
-		multisampling.alphaToCoverageEnable = VK_FALSE;
-		multisampling.alphaToOneEnable = VK_FALSE;
+		infos.colorBlendAttachment = state.colorBlend;
+		infos.colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+		infos.colorBlending.logicOpEnable = VK_FALSE;
+		infos.colorBlending.logicOp = VK_LOGIC_OP_COPY;
+		infos.colorBlending.attachmentCount = 1;
+		infos.colorBlending.pAttachments = &infos.colorBlendAttachment;
 
-		VkPipelineColorBlendAttachmentState colorBlendAttachment{};
-		colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-		colorBlendAttachment.blendEnable = VK_FALSE;
-		colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
-		colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ZERO;
-		colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
-		colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
-		colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
-		colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
+		//the modules aren't needed once the pipeline exists, destroy them on failure too
+		try {
+			CreateGraphicsPipeline(out_pipeline, state.layout, state.renderPass, device, infos, state.subpass, pipelineCache);
+		}
+		catch (...) {
+			vkDestroyShaderModule(device, fragShaderModule, nullptr);
+			vkDestroyShaderModule(device, vertShaderModule, nullptr);
+			throw;
+		}
+		vkDestroyShaderModule(device, fragShaderModule, nullptr);
+		vkDestroyShaderModule(device, vertShaderModule, nullptr);
+	}
 
-		VkPipelineColorBlendStateCreateInfo colorBlending{};
-		colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
-		colorBlending.logicOpEnable = VK_FALSE;
-		colorBlending.logicOp = VK_LOGIC_OP_COPY;
-		colorBlending.attachmentCount = 1;
-		colorBlending.pAttachments = &colorBlendAttachment;
-		colorBlending.blendConstants[0] = 0.0f;
-		colorBlending.blendConstants[1] = 0.0f;
-		colorBlending.blendConstants[2] = 0.0f;
-		colorBlending.blendConstants[3] = 0.0f;
+	// instanced adds InstanceData as binding 1 of the vertex input
+	// fragmentConstants are the fragment shader's specialization constants(shader variants)
+	// creates a new pipeline every call, PipelineTable::Acquire shares pipelines of equal states
+	inline void CreateDefaultGraphicsPipeline(VkPipeline& out_pipeline, const VkPipelineLayout pipelineLayout, const VkDevice device, const std::string& vsFilename, const std::string& fsFilename, const VkRenderPass renderpass,
+		bool instanced = false, VkPipelineCache pipelineCache = VK_NULL_HANDLE, const std::vector<uint32_t>& fragmentConstants = {}) {
+		GraphicsPipelineState state = GetDefaultPipelineState(pipelineLayout, renderpass, instanced);
+		state.vertexCode = LoadShader(vsFilename);
+		state.fragmentCode = LoadShader(fsFilename);
+		state.fragmentConstants = fragmentConstants;
+		CreateGraphicsPipeline(out_pipeline, device, state, pipelineCache);
+	}
 
-		VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
-		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-		pipelineLayoutInfo.setLayoutCount = 1;
-		pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout;
-		pipelineLayoutInfo.pushConstantRangeCount = 0;
-		pipelineLayoutInfo.pPushConstantRanges = nullptr;
+	// creates the layout too
+	inline void CreateDefaultGraphicsPipeline(VkPipeline& out_pipeline, VkPipelineLayout& out_pipelineLayout, const VkDevice device, const std::string& vsFilename, const std::string& fsFilename, const VkRenderPass renderpass, const std::vector<VkDescriptorSetLayout>& descriptorSetLayouts,
+		const std::vector<VkPushConstantRange>& pushConstantRanges = {}, bool instanced = false, VkPipelineCache pipelineCache = VK_NULL_HANDLE) {
+		CreatePipelineLayout(out_pipelineLayout, device, descriptorSetLayouts, pushConstantRanges);
+		CreateDefaultGraphicsPipeline(out_pipeline, out_pipelineLayout, device, vsFilename, fsFilename, renderpass, instanced, pipelineCache);
+	}
 
-		if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &out_pipelineLayout) != VK_SUCCESS) {
-			throw std::runtime_error("failed to create pipeline layout");
-		}
+	inline void CreateComputePipeline(VkPipeline& out_pipeline, const VkDevice device, const ComputePipelineState& state, VkPipelineCache pipelineCache = VK_NULL_HANDLE) {
+		VkShaderModule compShaderModule = CreateShaderModule(device, state.computeCode);
 
-		VkGraphicsPipelineCreateInfo pipelineInfo{};
-		pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-		pipelineInfo.stageCount = 2;
-		pipelineInfo.pStages = shaderStages;
-		pipelineInfo.pVertexInputState = &vertexInputInfo;
-		pipelineInfo.pInputAssemblyState = &inputAssembly;
-		pipelineInfo.pViewportState = &viewportState;
-		pipelineInfo.pRasterizationState = &rasterizer;
-		pipelineInfo.pMultisampleState = &multisampling;
-		pipelineInfo.pDepthStencilState = &depthStencil;
-		pipelineInfo.pColorBlendState = &colorBlending;
-		pipelineInfo.pDynamicState = &dynamicStae;
-		pipelineInfo.layout = out_pipelineLayout;
-		pipelineInfo.renderPass = renderpass;
-		pipelineInfo.subpass = 0;
+		VkPipelineShaderStageCreateInfo compShaderStageInfo{};
+		compShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		compShaderStageInfo.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+		compShaderStageInfo.module = compShaderModule;
+		compShaderStageInfo.pName = "main";
+
+		VkComputePipelineCreateInfo pipelineInfo{};
+		pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+		pipelineInfo.stage = compShaderStageInfo;
+		pipelineInfo.layout = state.layout;
 		pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
 		pipelineInfo.basePipelineIndex = -1;
-
-		if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &out_pipeline) != VK_SUCCESS) {
-			throw std::runtime_error("failed to create graphicsPipeline!");
+		VkResult result = vkCreateComputePipelines(device, pipelineCache, 1, &pipelineInfo, nullptr, &out_pipeline);
+		vkDestroyShaderModule(device, compShaderModule, nullptr);
+		if (result != VK_SUCCESS) {
+			throw std::runtime_error("failed to create compute pipeline!");
 		}
-
-		vkDestroyShaderModule(device, fragShaderModule, nullptr);
-		vkDestroyShaderModule(device, vertShaderModule, nullptr);
 	}
 }
 #endif
@@ -0,0 +1,112 @@
+#include "Tools/PipelineCache.hpp"
+#include "Tools/MappedFile.hpp"
+#include <stdexcept>
+#include <fstream>
+#include <filesystem>
+#include <vector>
+#include <cstring>
+#include <cstdio>
+
+namespace {
+	uint64_t HashBytes(const char* data, size_t size) {
+		uint64_t hash = 14695981039346656037ull;
+		for (size_t i = 0; i < size; i++) {
+			hash ^= static_cast<unsigned char>(data[i]);
+			hash *= 1099511628211ull;
+		}
+		return hash;
+	}
+}
+
+void PipelineCache::Init(VkDevice _device, VkPhysicalDevice physicalDevice, const std::string& _path) {
+	device = _device;
+	path = _path;
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+	deviceHeader.vendorID = properties.vendorID;
+	deviceHeader.deviceID = properties.deviceID;
+	deviceHeader.driverVersion = properties.driverVersion;
+	memcpy(deviceHeader.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE);
+	loadedSize = 0;
+	loadedHash = 0;
+
+	VkPipelineCacheCreateInfo createInfo{};
+	createInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+	MappedFile file;
+	if (file.Open(path) && file.GetSize() >= sizeof(FileHeader)) {
+		FileHeader header;
+		memcpy(&header, file.GetData(), sizeof(FileHeader));
+		const char* data = file.GetData() + sizeof(FileHeader);
+		if (header.dataSize <= file.GetSize() - sizeof(FileHeader) && IsCompatible(header, data)) {
+			createInfo.initialDataSize = static_cast<size_t>(header.dataSize);
+			createInfo.pInitialData = data;
+			loadedSize = createInfo.initialDataSize;
+			loadedHash = header.dataHash;
+		}
+		else printf("Pipeline cache %s is from another device or driver, starting empty\n", path.c_str());
+	}
+	if (vkCreatePipelineCache(device, &createInfo, nullptr, &cache) != VK_SUCCESS) {
+		//the driver may still refuse data it wrote itself, fall back to an empty cache
+		createInfo.initialDataSize = 0;
+		createInfo.pInitialData = nullptr;
+		loadedSize = 0;
+		loadedHash = 0;
+		if (vkCreatePipelineCache(device, &createInfo, nullptr, &cache) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create pipeline cache!");
+		}
+	}
+}
+
+bool PipelineCache::IsCompatible(const FileHeader& header, const char* data) const {
+	if (header.magic != MAGIC || header.version != VERSION || header.vendorID != deviceHeader.vendorID || header.deviceID != deviceHeader.deviceID ||
+		header.driverVersion != deviceHeader.driverVersion || memcmp(header.pipelineCacheUUID, deviceHeader.pipelineCacheUUID, VK_UUID_SIZE) != 0) {
+		return false;
+	}
+	if (header.dataHash != HashBytes(data, static_cast<size_t>(header.dataSize))) return false;
+	//the driver's own header leads the data, check it too rather than trusting every driver to
+	VkPipelineCacheHeaderVersionOne driverHeader;
+	if (header.dataSize < sizeof(driverHeader)) return false;
+	memcpy(&driverHeader, data, sizeof(driverHeader));
+	return driverHeader.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE && driverHeader.vendorID == deviceHeader.vendorID &&
+		driverHeader.deviceID == deviceHeader.deviceID && memcmp(driverHeader.pipelineCacheUUID, deviceHeader.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
+
+bool PipelineCache::Save() {
+	if (cache == VK_NULL_HANDLE) return false;
+	size_t size = 0;
+	if (vkGetPipelineCacheData(device, cache, &size, nullptr) != VK_SUCCESS || size == 0) return false;
+	std::vector<char> data(size);
+	if (vkGetPipelineCacheData(device, cache, &size, data.data()) != VK_SUCCESS) return false;
+	FileHeader header = deviceHeader;
+	header.dataSize = size;
+	header.dataHash = HashBytes(data.data(), size);
+	savedSize = size;
+	if (size == loadedSize && header.dataHash == loadedHash) return true; // nothing new was compiled
+
+	std::string tempPath = path + ".tmp";
+	{
+		std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+		if (!out.is_open()) return false;
+		out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		out.write(data.data(), size);
+		if (!out.good()) return false;
+	}
+	std::error_code error;
+	std::filesystem::rename(tempPath, path, error);
+	if (error) {
+		std::filesystem::remove(tempPath, error);
+		return false;
+	}
+	loadedSize = size;
+	loadedHash = header.dataHash;
+	return true;
+}
+
+void PipelineCache::Destroy() {
+	if (cache != VK_NULL_HANDLE) vkDestroyPipelineCache(device, cache, nullptr);
+	cache = VK_NULL_HANDLE;
+}
+
+void PipelineCache::PrintStats() const {
+	printf("Pipeline cache %s : loaded %.1f KB, saved %.1f KB\n", path.c_str(), loadedSize / 1024.0, savedSize / 1024.0);
+}
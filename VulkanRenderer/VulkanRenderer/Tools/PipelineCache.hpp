@@ -0,0 +1,49 @@
+#pragma once
+#ifndef PIPELINECACHE_HPP
+#define PIPELINECACHE_HPP
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+#include <string>
+#include <cstdint>
+
+// VkPipelineCache kept on disk between runs, pass Get() to every pipeline creation.
+// the file starts with our own header(device, driver version, cache uuid, size, hash of the data).
+// a file from another gpu or driver, or a torn write, is ignored and the cache starts empty.
+// pipeline creation may use the cache from any thread, the driver synchronizes it.
+class PipelineCache {
+public:
+	void Init(VkDevice _device, VkPhysicalDevice physicalDevice, const std::string& _path);
+	// writes the cache back when it changed since it was loaded. false when the file couldn't be written
+	bool Save();
+	void Destroy();
+	VkPipelineCache Get() const { return cache; }
+	void PrintStats() const;
+
+private:
+	static const uint32_t MAGIC = 0x43504B56; // 'VKPC'
+	static const uint32_t VERSION = 1;
+	struct FileHeader {
+		uint32_t magic = MAGIC;
+		uint32_t version = VERSION;
+		uint32_t vendorID = 0;
+		uint32_t deviceID = 0;
+		uint32_t driverVersion = 0;
+		uint8_t pipelineCacheUUID[VK_UUID_SIZE] = {};
+		uint32_t reserved = 0;
+		uint64_t dataSize = 0;
+		uint64_t dataHash = 0;
+	};
+	VkDevice device = VK_NULL_HANDLE;
+	VkPipelineCache cache = VK_NULL_HANDLE;
+	std::string path;
+	FileHeader deviceHeader; // what a file has to match to be loaded
+	size_t loadedSize = 0;
+	uint64_t loadedHash = 0;
+	size_t savedSize = 0;
+
+private:
+	// false when data can't have been written by this device and driver
+	bool IsCompatible(const FileHeader& header, const char* data) const;
+};
+#endif // !PIPELINECACHE_HPP
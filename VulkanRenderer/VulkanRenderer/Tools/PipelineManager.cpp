@@ -0,0 +1,227 @@
+#include "Tools/PipelineManager.hpp"
+#include "Tools/PipelineBuilder.hpp"
+#include "Tools/ShaderCompiler.hpp"
+#include <stdexcept>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+
+void PipelineManager::Init(JobSystem& _jobSystem, PipelineTable& _pipelineTable, uint32_t _framesInFlight) {
+	jobSystem = &_jobSystem;
+	pipelineTable = &_pipelineTable;
+	framesInFlight = _framesInFlight;
+	currentFrame = 0;
+}
+
+void PipelineManager::Destroy() {
+	if (jobSystem == nullptr) return;
+	WaitAll();
+	for (Entry& entry : entries) {
+		for (VkPipeline pipeline : { entry.pipeline.load(), entry.rebuilt.load() }) {
+			pipelineTable->Release(pipeline);
+		}
+	}
+	for (const RetiredPipeline& old : retired) {
+		pipelineTable->Release(old.pipeline);
+	}
+	entries.clear();
+	retired.clear();
+	handles.clear();
+	jobSystem = nullptr;
+}
+
+std::string PipelineManager::GetKey(const GraphicsPipelineDesc& desc) {
+	std::string key = desc.vsFilename + "|" + desc.fsFilename + "|";
+	char ids[64];
+	snprintf(ids, sizeof(ids), "%llx|%llx|%d", (unsigned long long)(uintptr_t)desc.renderPass, (unsigned long long)(uintptr_t)desc.layout, desc.instanced ? 1 : 0);
+	key += ids;
+	for (uint32_t constant : desc.fragmentConstants) {
+		key += "|" + std::to_string(constant);
+	}
+	return key;
+}
+
+std::string PipelineManager::GetKey(const ComputePipelineDesc& desc) {
+	char layout[32];
+	snprintf(layout, sizeof(layout), "%llx", (unsigned long long)(uintptr_t)desc.layout);
+	return "compute|" + desc.csFilename + "|" + layout;
+}
+
+std::string PipelineManager::GetName(const Entry& entry) {
+	if (entry.compute) return entry.computeDesc.csFilename;
+	return entry.desc.vsFilename + " + " + entry.desc.fsFilename;
+}
+
+PipelineManager::Entry* PipelineManager::AddEntry(const std::string& key, PipelineHandle fallback, PipelineHandle& outHandle) {
+	if (jobSystem == nullptr) {
+		throw std::runtime_error("pipeline manager is not initialized!");
+	}
+	auto inserted = handles.emplace(key, static_cast<PipelineHandle>(entries.size()));
+	outHandle = inserted.first->second;
+	if (!inserted.second) {
+		sharedRequests++;
+		return nullptr;
+	}
+	entries.emplace_back();
+	Entry& entry = entries.back();
+	entry.fallback = fallback;
+	return &entry;
+}
+
+PipelineHandle PipelineManager::Request(const GraphicsPipelineDesc& desc, PipelineHandle fallback) {
+	PipelineHandle handle;
+	Entry* entry = AddEntry(GetKey(desc), fallback, handle);
+	if (entry == nullptr) return handle;
+	entry->desc = desc;
+	//without workers a queued job only runs when someone waits, compile right here instead
+	if (jobSystem->GetWorkerCount() == 0) CompileInitial(*entry);
+	else jobSystem->Run([this, entry]() { CompileInitial(*entry); }, &pending);
+	return handle;
+}
+
+PipelineHandle PipelineManager::RequestNow(const GraphicsPipelineDesc& desc) {
+	PipelineHandle handle;
+	Entry* entry = AddEntry(GetKey(desc), NO_PIPELINE, handle);
+	if (entry != nullptr) entry->desc = desc;
+	CompileNow(entry, handle);
+	return handle;
+}
+
+PipelineHandle PipelineManager::RequestNow(const ComputePipelineDesc& desc) {
+	PipelineHandle handle;
+	Entry* entry = AddEntry(GetKey(desc), NO_PIPELINE, handle);
+	if (entry != nullptr) {
+		entry->computeDesc = desc;
+		entry->compute = true;
+	}
+	CompileNow(entry, handle);
+	return handle;
+}
+
+void PipelineManager::CompileNow(Entry* entry, PipelineHandle handle) {
+	if (entry != nullptr) CompileInitial(*entry);
+	//an earlier Request of the same desc may still be compiling
+	if (entries[handle].state.load() == PENDING) WaitAll();
+	if (entries[handle].state.load() != READY) {
+		throw std::runtime_error(entries[handle].compute ? "failed to create compute pipeline!" : "failed to create graphicsPipeline!");
+	}
+}
+
+VkPipeline PipelineManager::Compile(Entry& entry) {
+	try {
+		if (entry.compute) {
+			ComputePipelineState state;
+			state.computeCode = PipelineBuilder::LoadShader(entry.computeDesc.csFilename);
+			state.layout = entry.computeDesc.layout;
+			return pipelineTable->Acquire(state);
+		}
+		GraphicsPipelineState state = PipelineBuilder::GetDefaultPipelineState(entry.desc.layout, entry.desc.renderPass, entry.desc.instanced);
+		state.vertexCode = PipelineBuilder::LoadShader(entry.desc.vsFilename);
+		state.fragmentCode = PipelineBuilder::LoadShader(entry.desc.fsFilename);
+		state.fragmentConstants = entry.desc.fragmentConstants;
+		//a rebuild whose shaders compiled to the same code gets the pipeline it already has
+		return pipelineTable->Acquire(state);
+	}
+	catch (const std::exception& e) {
+		printf("failed to compile pipeline %s : %s\n", GetName(entry).c_str(), e.what());
+		return VK_NULL_HANDLE;
+	}
+}
+
+void PipelineManager::CompileInitial(Entry& entry) {
+	auto begin = std::chrono::high_resolution_clock::now();
+	VkPipeline pipeline = Compile(entry);
+	std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - begin;
+	entry.compileMs = elapsed.count();
+	entry.pipeline = pipeline;
+	//draws keep using the fallback on failure
+	entry.state = pipeline != VK_NULL_HANDLE ? READY : FAILED;
+}
+
+void PipelineManager::Rebuild(Entry& entry) {
+	if (entry.rebuildState.load() == PENDING) {
+		entry.rebuildAgain = true;
+		return;
+	}
+	entry.rebuildState = PENDING;
+	entry.rebuildAgain = false;
+	auto job = [this, &entry]() {
+		VkPipeline pipeline = Compile(entry);
+		entry.rebuilt = pipeline;
+		entry.rebuildState = pipeline != VK_NULL_HANDLE ? READY : FAILED;
+	};
+	if (jobSystem->GetWorkerCount() == 0) job();
+	else jobSystem->Run(job, &pending);
+}
+
+VkPipeline PipelineManager::Get(PipelineHandle handle) const {
+	if (handle == NO_PIPELINE) return VK_NULL_HANDLE;
+	const Entry& entry = entries[handle];
+	return entry.state.load() == READY ? entry.pipeline.load() : Get(entry.fallback);
+}
+
+bool PipelineManager::IsReady(PipelineHandle handle) const {
+	return entries[handle].state.load() == READY;
+}
+
+void PipelineManager::WaitAll() {
+	if (jobSystem != nullptr) jobSystem->Wait(pending);
+}
+
+void PipelineManager::Reload(const std::vector<std::string>& changedFiles) {
+	ShaderCompiler& compiler = ShaderCompiler::GetInstance();
+	for (Entry& entry : entries) {
+		//still on its first compile, which reads the files anew anyway
+		if (entry.state.load() == PENDING) continue;
+		std::vector<std::string> files;
+		if (entry.compute) files = compiler.GetDependencies(entry.computeDesc.csFilename);
+		else {
+			files = compiler.GetDependencies(entry.desc.vsFilename);
+			std::vector<std::string> fsFiles = compiler.GetDependencies(entry.desc.fsFilename);
+			files.insert(files.end(), fsFiles.begin(), fsFiles.end());
+		}
+		bool changed = std::any_of(files.begin(), files.end(), [&changedFiles](const std::string& file) {
+			return std::find(changedFiles.begin(), changedFiles.end(), file) != changedFiles.end();
+		});
+		if (changed) Rebuild(entry);
+	}
+}
+
+void PipelineManager::Update(uint64_t frameNumber) {
+	currentFrame = frameNumber;
+	//frames up to frameNumber - framesInFlight are done once this frame's fence was waited for
+	retired.erase(std::remove_if(retired.begin(), retired.end(), [this](const RetiredPipeline& old) {
+		if (old.lastFrame + framesInFlight > currentFrame) return false;
+		pipelineTable->Release(old.pipeline);
+		return true;
+	}), retired.end());
+	for (Entry& entry : entries) {
+		uint32_t rebuildState = entry.rebuildState.load();
+		if (rebuildState == PENDING) continue;
+		VkPipeline pipeline = entry.rebuilt.exchange(VK_NULL_HANDLE);
+		if (pipeline != VK_NULL_HANDLE) {
+			//frames up to the previous one were recorded with the old pipeline
+			VkPipeline old = entry.pipeline.exchange(pipeline);
+			if (old != VK_NULL_HANDLE) retired.push_back({ old, frameNumber > 0 ? frameNumber - 1 : 0 });
+			entry.state = READY;
+			reloadCount++;
+			printf("Reloaded pipeline %s\n", GetName(entry).c_str());
+		}
+		if (entry.rebuildAgain) Rebuild(entry);
+	}
+}
+
+void PipelineManager::PrintStats() const {
+	uint32_t ready = 0, failed = 0;
+	double totalMs = 0.0;
+	for (const Entry& entry : entries) {
+		uint32_t state = entry.state.load();
+		if (state == READY) {
+			ready++;
+			totalMs += entry.compileMs;
+		}
+		else if (state == FAILED) failed++;
+	}
+	printf("Pipeline manager : %u compiled(%.2f ms on average), %u failed, %zu unique, %u shared request(s), %u reloaded\n",
+		ready, ready > 0 ? totalMs / ready : 0.0, failed, entries.size(), sharedRequests, reloadCount);
+}
@@ -0,0 +1,109 @@
+#pragma once
+#ifndef PIPELINEMANAGER_HPP
+#define PIPELINEMANAGER_HPP
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+#include <deque>
+#include <unordered_map>
+#include <vector>
+#include <string>
+#include <atomic>
+#include <cstdint>
+#include "JobSystem.hpp"
+#include "PipelineTable.hpp"
+
+// what PipelineBuilder::CreateDefaultGraphicsPipeline needs. layout and renderPass are owned by the caller
+// and must outlive the manager.
+struct GraphicsPipelineDesc {
+	std::string vsFilename;
+	std::string fsFilename;
+	VkRenderPass renderPass = VK_NULL_HANDLE;
+	VkPipelineLayout layout = VK_NULL_HANDLE;
+	bool instanced = false;
+	std::vector<uint32_t> fragmentConstants; // specialization constants of the fragment shader, constant_id i takes element i
+};
+// a compute pipeline, layout is owned by the caller
+struct ComputePipelineDesc {
+	std::string csFilename;
+	VkPipelineLayout layout = VK_NULL_HANDLE;
+};
+typedef uint32_t PipelineHandle;
+const PipelineHandle NO_PIPELINE = UINT32_MAX;
+
+// compiles pipelines as jobs and hands out handles right away. compute pipelines are only built with RequestNow.
+// until a pipeline is compiled Get returns its fallback, a generic pipeline that's already built
+// with a compatible layout(or VK_NULL_HANDLE, the caller skips or draws another way then).
+// pipelines come from the shared PipelineTable, descs that build equal states share one VkPipeline.
+// Reload rebuilds the pipelines of changed shader files in the background, Update swaps them in between frames.
+// Request, Get, Reload and Update are called by the thread that renders, workers only fill in their own entry.
+// a desc requested again returns the first handle, so variants that specialize to the same constants share one pipeline.
+class PipelineManager {
+public:
+	void Init(JobSystem& _jobSystem, PipelineTable& _pipelineTable, uint32_t _framesInFlight);
+	// waits for the pending compiles and releases every pipeline it acquired. call before JobSystem::Shutdown and PipelineTable::Destroy
+	void Destroy();
+
+	PipelineHandle Request(const GraphicsPipelineDesc& desc, PipelineHandle fallback = NO_PIPELINE);
+	// compiles on the calling thread, for the generic pipelines the others fall back to. throws on errors
+	PipelineHandle RequestNow(const GraphicsPipelineDesc& desc);
+	PipelineHandle RequestNow(const ComputePipelineDesc& desc);
+	// the compiled pipeline, the fallback's while it's compiling or when compiling failed
+	VkPipeline Get(PipelineHandle handle) const;
+	bool IsReady(PipelineHandle handle) const;
+	// blocks until every requested pipeline is compiled, helping with the jobs
+	void WaitAll();
+
+	// rebuilds every pipeline whose shaders include one of changedFiles(ShaderCompiler::GetDependencies).
+	// the old pipeline stays in use until the new one is ready, a failed rebuild keeps it
+	void Reload(const std::vector<std::string>& changedFiles);
+	// call once per frame after waiting for the frame's fence, before recording.
+	// swaps in finished rebuilds and destroys replaced pipelines no frame in flight can use anymore
+	void Update(uint64_t frameNumber);
+	void PrintStats() const;
+
+private:
+	enum State : uint32_t { PENDING, READY, FAILED };
+	struct Entry {
+		GraphicsPipelineDesc desc;
+		ComputePipelineDesc computeDesc; // used instead of desc when compute
+		bool compute = false;
+		PipelineHandle fallback = NO_PIPELINE;
+		std::atomic<VkPipeline> pipeline{ VK_NULL_HANDLE };
+		std::atomic<uint32_t> state{ PENDING };
+		double compileMs = 0.0; // written before state turns READY
+		// hot reload
+		std::atomic<VkPipeline> rebuilt{ VK_NULL_HANDLE };
+		std::atomic<uint32_t> rebuildState{ READY }; // READY : no rebuild running
+		bool rebuildAgain = false; // a file changed again while the rebuild was running
+	};
+	struct RetiredPipeline {
+		VkPipeline pipeline;
+		uint64_t lastFrame; // the last frame that may have used it
+	};
+	JobSystem* jobSystem = nullptr;
+	PipelineTable* pipelineTable = nullptr;
+	uint32_t framesInFlight = 2;
+	uint64_t currentFrame = 0;
+	std::deque<Entry> entries; // a deque so entries don't move while workers fill them in
+	std::vector<RetiredPipeline> retired;
+	std::unordered_map<std::string, PipelineHandle> handles; // [GetKey(desc)]
+	uint32_t sharedRequests = 0; // requests answered with an existing pipeline
+	JobCounter pending;
+	uint32_t reloadCount = 0;
+
+private:
+	static std::string GetKey(const GraphicsPipelineDesc& desc);
+	static std::string GetKey(const ComputePipelineDesc& desc);
+	// the shader files, for messages
+	static std::string GetName(const Entry& entry);
+	// a new entry, or null with outHandle set when key was requested before
+	Entry* AddEntry(const std::string& key, PipelineHandle fallback, PipelineHandle& outHandle);
+	// compiles a new entry on the calling thread, throws when handle isn't READY afterwards
+	void CompileNow(Entry* entry, PipelineHandle handle);
+	// VK_NULL_HANDLE on errors, they are printed
+	VkPipeline Compile(Entry& entry);
+	void CompileInitial(Entry& entry);
+	void Rebuild(Entry& entry);
+};
+#endif // !PIPELINEMANAGER_HPP
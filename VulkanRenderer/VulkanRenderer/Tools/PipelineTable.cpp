@@ -0,0 +1,161 @@
+#include "Tools/PipelineTable.hpp"
+#include "Tools/PipelineBuilder.hpp"
+#include <stdexcept>
+#include <cstdio>
+
+namespace {
+	uint64_t HashKey(const std::string& key) {
+		uint64_t hash = 14695981039346656037ull;
+		for (unsigned char byte : key) {
+			hash ^= byte;
+			hash *= 1099511628211ull;
+		}
+		return hash;
+	}
+
+	// the vulkan structs appended here are all 32 bit members, there's no padding in their bytes
+	template<typename T>
+	void Append(std::string& key, const T& value) {
+		key.append(reinterpret_cast<const char*>(&value), sizeof(T));
+	}
+
+	template<typename T>
+	void AppendArray(std::string& key, const std::vector<T>& values) {
+		Append(key, static_cast<uint64_t>(values.size()));
+		key.append(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(T));
+	}
+}
+
+void PipelineTable::Init(VkDevice _device, VkPipelineCache _pipelineCache) {
+	device = _device;
+	pipelineCache = _pipelineCache;
+}
+
+void PipelineTable::Destroy() {
+	std::lock_guard<std::mutex> lock(mutex);
+	for (const auto& pipeline : pipelines) {
+		vkDestroyPipeline(device, pipeline.first, nullptr);
+	}
+	pipelines.clear();
+	lookup.clear();
+	renderPasses.clear();
+}
+
+void PipelineTable::RegisterRenderPass(VkRenderPass renderPass, const RenderPassFormats& formats) {
+	std::lock_guard<std::mutex> lock(mutex);
+	renderPasses[renderPass] = formats;
+}
+
+std::string PipelineTable::GetKey(const GraphicsPipelineState& state) const {
+	std::string key;
+	key.reserve(state.vertexCode.size() + state.fragmentCode.size() + 256);
+	Append(key, VK_PIPELINE_BIND_POINT_GRAPHICS);
+	AppendArray(key, state.vertexCode);
+	AppendArray(key, state.fragmentCode);
+	AppendArray(key, state.fragmentConstants);
+	AppendArray(key, state.bindings);
+	AppendArray(key, state.attributes);
+	Append(key, state.topology);
+	Append(key, state.polygonMode);
+	Append(key, state.cullMode);
+	Append(key, state.frontFace);
+	Append(key, static_cast<uint32_t>(state.depthTest));
+	Append(key, static_cast<uint32_t>(state.depthWrite));
+	Append(key, state.depthCompareOp);
+	Append(key, state.colorBlend);
+	Append(key, state.layout);
+	//compatible render passes share pipelines, an unknown one is only compatible with itself
+	auto renderPass = renderPasses.find(state.renderPass);
+	if (renderPass != renderPasses.end()) {
+		Append(key, renderPass->second.colorFormat);
+		Append(key, renderPass->second.depthFormat);
+		Append(key, renderPass->second.samples);
+	}
+	else Append(key, state.renderPass);
+	Append(key, state.subpass);
+	return key;
+}
+
+std::string PipelineTable::GetKey(const ComputePipelineState& state) const {
+	std::string key;
+	key.reserve(state.computeCode.size() + 32);
+	Append(key, VK_PIPELINE_BIND_POINT_COMPUTE);
+	AppendArray(key, state.computeCode);
+	Append(key, state.layout);
+	return key;
+}
+
+VkPipeline PipelineTable::Find(const std::string& key, uint64_t hash) const {
+	auto range = lookup.equal_range(hash);
+	for (auto it = range.first; it != range.second; ++it) {
+		if (pipelines.at(it->second).key == key) return it->second;
+	}
+	return VK_NULL_HANDLE;
+}
+
+VkPipeline PipelineTable::Acquire(const GraphicsPipelineState& state) {
+	std::string key;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		key = GetKey(state); // reads renderPasses
+	}
+	return Acquire(std::move(key), [this, &state](VkPipeline& pipeline) { PipelineBuilder::CreateGraphicsPipeline(pipeline, device, state, pipelineCache); });
+}
+
+VkPipeline PipelineTable::Acquire(const ComputePipelineState& state) {
+	return Acquire(GetKey(state), [this, &state](VkPipeline& pipeline) { PipelineBuilder::CreateComputePipeline(pipeline, device, state, pipelineCache); });
+}
+
+VkPipeline PipelineTable::Acquire(std::string key, const std::function<void(VkPipeline&)>& create) {
+	uint64_t hash = HashKey(key);
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		VkPipeline pipeline = Find(key, hash);
+		if (pipeline != VK_NULL_HANDLE) {
+			pipelines[pipeline].refCount++;
+			sharedCount++;
+			return pipeline;
+		}
+	}
+	VkPipeline pipeline = VK_NULL_HANDLE;
+	create(pipeline);
+	std::lock_guard<std::mutex> lock(mutex);
+	//another job may have created an equal state in the meantime, keep the first one
+	VkPipeline existing = Find(key, hash);
+	if (existing != VK_NULL_HANDLE) {
+		vkDestroyPipeline(device, pipeline, nullptr);
+		pipelines[existing].refCount++;
+		sharedCount++;
+		return existing;
+	}
+	lookup.emplace(hash, pipeline);
+	Entry& entry = pipelines[pipeline];
+	entry.key = std::move(key);
+	entry.refCount = 1;
+	createdCount++;
+	return pipeline;
+}
+
+void PipelineTable::Release(VkPipeline pipeline) {
+	if (pipeline == VK_NULL_HANDLE) return;
+	std::lock_guard<std::mutex> lock(mutex);
+	auto it = pipelines.find(pipeline);
+	if (it == pipelines.end()) {
+		throw std::runtime_error("failed to release pipeline, it's not in the pipeline table!");
+	}
+	if (--it->second.refCount > 0) return;
+	auto range = lookup.equal_range(HashKey(it->second.key));
+	for (auto entry = range.first; entry != range.second; ++entry) {
+		if (entry->second == pipeline) {
+			lookup.erase(entry);
+			break;
+		}
+	}
+	pipelines.erase(it);
+	vkDestroyPipeline(device, pipeline, nullptr);
+}
+
+void PipelineTable::PrintStats() const {
+	std::lock_guard<std::mutex> lock(mutex);
+	printf("Pipeline table : %zu alive, %u created, %u shared acquire(s)\n", pipelines.size(), createdCount, sharedCount);
+}
@@ -0,0 +1,92 @@
+#pragma once
+#ifndef PIPELINETABLE_HPP
+#define PIPELINETABLE_HPP
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <mutex>
+#include <functional>
+#include <cstdint>
+
+// everything a graphics pipeline is built from(PipelineBuilder::CreateGraphicsPipeline).
+// shaders are kept as spir-v, their modules only live while the pipeline is created.
+// the defaults are the state of the default pipeline, viewport and scissor are dynamic.
+struct GraphicsPipelineState {
+	std::vector<char> vertexCode;
+	std::vector<char> fragmentCode;
+	std::vector<uint32_t> fragmentConstants; // specialization constants of the fragment shader, constant_id i takes element i
+	std::vector<VkVertexInputBindingDescription> bindings;
+	std::vector<VkVertexInputAttributeDescription> attributes;
+	VkPrimitiveTopology topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+	VkPolygonMode polygonMode = VK_POLYGON_MODE_FILL;
+	VkCullModeFlags cullMode = VK_CULL_MODE_BACK_BIT;
+	VkFrontFace frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+	bool depthTest = true;
+	bool depthWrite = true;
+	VkCompareOp depthCompareOp = VK_COMPARE_OP_LESS;
+	VkPipelineColorBlendAttachmentState colorBlend = { VK_FALSE, VK_BLEND_FACTOR_ONE, VK_BLEND_FACTOR_ZERO, VK_BLEND_OP_ADD, VK_BLEND_FACTOR_ONE, VK_BLEND_FACTOR_ZERO, VK_BLEND_OP_ADD,
+		VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT };
+	VkPipelineLayout layout = VK_NULL_HANDLE;
+	VkRenderPass renderPass = VK_NULL_HANDLE;
+	uint32_t subpass = 0;
+};
+
+// everything a compute pipeline is built from(PipelineBuilder::CreateComputePipeline)
+struct ComputePipelineState {
+	std::vector<char> computeCode;
+	VkPipelineLayout layout = VK_NULL_HANDLE;
+};
+
+// attachments of a single subpass render pass, passes with equal formats are compatible and can share pipelines
+struct RenderPassFormats {
+	VkFormat colorFormat = VK_FORMAT_UNDEFINED;
+	VkFormat depthFormat = VK_FORMAT_UNDEFINED;
+	VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT;
+};
+
+// hands out one VkPipeline per distinct GraphicsPipelineState or ComputePipelineState and counts its users.
+// states are hashed byte for byte(shader code, vertex layout, raster/depth/blend state, layout and
+// render pass compatibility), a hash hit is compared in full before it's shared.
+// thread safe, the driver compile runs outside of the lock so jobs don't wait on each other.
+class PipelineTable {
+public:
+	void Init(VkDevice _device, VkPipelineCache _pipelineCache);
+	// destroys every pipeline, released or not
+	void Destroy();
+	// render passes that were never registered only match themselves
+	void RegisterRenderPass(VkRenderPass renderPass, const RenderPassFormats& formats);
+
+	// the pipeline of an equal state with one more user, or a new one. throws on errors
+	VkPipeline Acquire(const GraphicsPipelineState& state);
+	VkPipeline Acquire(const ComputePipelineState& state);
+	// destroys the pipeline with its last user. call once no frame in flight uses it anymore
+	void Release(VkPipeline pipeline);
+	void PrintStats() const;
+
+private:
+	struct Entry {
+		std::string key;
+		uint32_t refCount = 0;
+	};
+	VkDevice device = VK_NULL_HANDLE;
+	VkPipelineCache pipelineCache = VK_NULL_HANDLE;
+	mutable std::mutex mutex;
+	std::unordered_map<VkRenderPass, RenderPassFormats> renderPasses;
+	std::unordered_multimap<uint64_t, VkPipeline> lookup; // [hash of Entry::key]
+	std::unordered_map<VkPipeline, Entry> pipelines;
+	uint32_t createdCount = 0;
+	uint32_t sharedCount = 0; // acquires answered with an existing pipeline
+
+private:
+	// the hashed bytes of state. lock mutex first
+	std::string GetKey(const GraphicsPipelineState& state) const;
+	std::string GetKey(const ComputePipelineState& state) const;
+	// shares the pipeline of key or adds the one create builds(outside of the lock)
+	VkPipeline Acquire(std::string key, const std::function<void(VkPipeline&)>& create);
+	// VK_NULL_HANDLE when no pipeline has key. lock mutex first
+	VkPipeline Find(const std::string& key, uint64_t hash) const;
+};
+#endif // !PIPELINETABLE_HPP
@@ -0,0 +1,84 @@
+#pragma once
+#ifndef RENDERTHREAD_HPP
+#define RENDERTHREAD_HPP
+#include <thread>
+#include <functional>
+#include <exception>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <cstdio>
+#include "BoundedQueue.hpp"
+
+// runs renderFunc on its own thread for every snapshot the simulation submits, in submission order.
+// a snapshot is moved into the queue and never touched by the simulation again, so both sides run without locks on frame data.
+// the queue capacity bounds how many frames the simulation may run ahead of the renderer(latency against overlap).
+template<typename Snapshot>
+class RenderThread {
+public:
+	~RenderThread() {
+		try { Stop(); }
+		catch (const std::exception& e) { printf("render thread failed : %s\n", e.what()); }
+	}
+
+	void Start(std::function<void(Snapshot&)> _renderFunc, size_t capacity = 2) {
+		if (thread.joinable()) return;
+		renderFunc = std::move(_renderFunc);
+		queue.reset(new BoundedQueue<Snapshot>(capacity));
+		error = nullptr;
+		failed = false;
+		thread = std::thread(&RenderThread::ThreadLoop, this);
+	}
+	// blocks while the queue is full. whileWaiting runs about every millisecond meanwhile,
+	// e.g. main thread jobs the render thread might be waiting on. false after the render thread failed or stopped
+	bool Submit(Snapshot&& snapshot, const std::function<void()>& whileWaiting = nullptr) {
+		if (!queue || failed) return false;
+		auto begin = std::chrono::high_resolution_clock::now();
+		bool pushed = false;
+		if (whileWaiting) {
+			while (!(pushed = queue->TryPush(snapshot, std::chrono::milliseconds(1))) && !queue->IsClosed()) whileWaiting();
+		}
+		else pushed = queue->Push(std::move(snapshot));
+		std::chrono::duration<double, std::milli> waited = std::chrono::high_resolution_clock::now() - begin;
+		submitWaitMs += waited.count();
+		submitCount++;
+		return pushed;
+	}
+	// renders what's queued, joins the thread and rethrows its error
+	void Stop() {
+		if (!thread.joinable()) return;
+		queue->Close();
+		thread.join();
+		printf("Render thread : %llu frame(s), simulation waited %.3f ms per frame on average\n",
+			static_cast<unsigned long long>(submitCount), submitCount > 0 ? submitWaitMs / submitCount : 0.0);
+		if (error) {
+			std::exception_ptr rethrown = error;
+			error = nullptr;
+			std::rethrow_exception(rethrown);
+		}
+	}
+	bool IsRunning() const { return thread.joinable() && !failed; }
+
+private:
+	std::function<void(Snapshot&)> renderFunc;
+	std::unique_ptr<BoundedQueue<Snapshot>> queue;
+	std::thread thread;
+	std::exception_ptr error;
+	std::atomic<bool> failed{ false };
+	uint64_t submitCount = 0;
+	double submitWaitMs = 0.0;
+
+private:
+	void ThreadLoop() {
+		Snapshot snapshot;
+		try {
+			while (queue->Pop(snapshot)) renderFunc(snapshot);
+		}
+		catch (...) {
+			error = std::current_exception();
+			failed = true;
+			queue->Close(); // unblocks Submit
+		}
+	}
+};
+#endif // !RENDERTHREAD_HPP
@@ -0,0 +1,210 @@
+#include "Tools/ShaderCompiler.hpp"
+#include <shaderc/shaderc.hpp>
+#include <stdexcept>
+#include <fstream>
+#include <sstream>
+#include <filesystem>
+#include <memory>
+#include <chrono>
+#include <cstring>
+#include <cstdio>
+
+namespace {
+	// bump when anything that changes the output but isn't hashed changes
+	const uint32_t CACHE_VERSION = 1;
+	const uint32_t SPIRV_MAGIC = 0x07230203;
+
+	uint64_t HashBytes(uint64_t hash, const void* data, size_t size) {
+		const unsigned char* bytes = static_cast<const unsigned char*>(data);
+		for (size_t i = 0; i < size; i++) {
+			hash ^= bytes[i];
+			hash *= 1099511628211ull;
+		}
+		return hash;
+	}
+
+	bool ReadTextFile(const std::string& fn, std::string& outText) {
+		std::ifstream file(fn, std::ios::binary);
+		if (!file.is_open()) return false;
+		std::stringstream stream;
+		stream << file.rdbuf();
+		outText = stream.str();
+		return true;
+	}
+
+	shaderc_shader_kind GetShaderKind(const std::string& fn) {
+		std::string extension = std::filesystem::path(fn).extension().string();
+		if (extension == ".vert") return shaderc_vertex_shader;
+		if (extension == ".frag") return shaderc_fragment_shader;
+		if (extension == ".comp") return shaderc_compute_shader;
+		if (extension == ".geom") return shaderc_geometry_shader;
+		if (extension == ".tesc") return shaderc_tess_control_shader;
+		if (extension == ".tese") return shaderc_tess_evaluation_shader;
+		throw std::runtime_error("unknown shader stage of " + fn + "!");
+	}
+
+	// compile calls on one compiler are thread safe
+	shaderc::Compiler& GetCompiler() {
+		static shaderc::Compiler compiler;
+		return compiler;
+	}
+
+	class FileIncluder : public shaderc::CompileOptions::IncluderInterface {
+	public:
+		// every file it opens is appended to outIncludes
+		FileIncluder(const std::string& _includeDirectory, std::vector<std::string>& outIncludes) : includeDirectory(_includeDirectory), includes(outIncludes) {}
+
+		shaderc_include_result* GetInclude(const char* requestedSource, shaderc_include_type type, const char* requestingSource, size_t includeDepth) override {
+			std::filesystem::path directory = type == shaderc_include_type_relative ? std::filesystem::path(requestingSource).parent_path() : std::filesystem::path(includeDirectory);
+			Include* include = new Include();
+			include->name = (directory / requestedSource).lexically_normal().generic_string();
+			if (!ReadTextFile(include->name, include->content)) {
+				//an empty name marks a failed include, the content is the error message
+				include->content = "can't open " + include->name;
+				include->name.clear();
+			}
+			else includes.push_back(include->name);
+			include->result.source_name = include->name.c_str();
+			include->result.source_name_length = include->name.size();
+			include->result.content = include->content.c_str();
+			include->result.content_length = include->content.size();
+			include->result.user_data = include;
+			return &include->result;
+		}
+		void ReleaseInclude(shaderc_include_result* data) override {
+			delete static_cast<Include*>(data->user_data);
+		}
+
+	private:
+		struct Include {
+			shaderc_include_result result;
+			std::string name;
+			std::string content;
+		};
+		std::string includeDirectory;
+		std::vector<std::string>& includes;
+	};
+}
+
+ShaderCompiler& ShaderCompiler::GetInstance() {
+	static ShaderCompiler instance;
+	return instance;
+}
+
+void ShaderCompiler::Init(const std::string& _cacheDirectory, const std::string& _includeDirectory) {
+	cacheDirectory = _cacheDirectory;
+	includeDirectory = _includeDirectory;
+}
+
+std::vector<char> ShaderCompiler::Compile(const std::string& fn, const Defines& defines) {
+	std::string source;
+	if (!ReadTextFile(fn, source)) {
+		throw std::runtime_error("failed to open shader " + fn + "!");
+	}
+	shaderc_shader_kind kind = GetShaderKind(fn);
+	shaderc::CompileOptions options;
+	options.SetTargetEnvironment(shaderc_target_env_vulkan, shaderc_env_version_vulkan_1_2);
+#ifdef NDEBUG
+	const uint32_t optimized = 1;
+	options.SetOptimizationLevel(shaderc_optimization_level_performance);
+#else
+	const uint32_t optimized = 0;
+	options.SetGenerateDebugInfo();
+#endif
+	for (const auto& define : defines) {
+		options.AddMacroDefinition(define.first, define.second);
+	}
+	std::vector<std::string> includes;
+	options.SetIncluder(std::make_unique<FileIncluder>(includeDirectory, includes));
+
+	//the preprocessed text already holds every include and define, it's the whole input of the compile
+	shaderc::PreprocessedSourceCompilationResult preprocessed = GetCompiler().PreprocessGlsl(source, kind, fn.c_str(), options);
+	{
+		//kept on failure too, fixing a broken include has to trigger a reload
+		std::lock_guard<std::mutex> lock(dependencyMutex);
+		dependencies[fn] = includes;
+	}
+	if (preprocessed.GetCompilationStatus() != shaderc_compilation_status_success) {
+		throw std::runtime_error("failed to preprocess shader " + fn + " :\n" + preprocessed.GetErrorMessage());
+	}
+	std::string preprocessedText(preprocessed.cbegin(), preprocessed.cend());
+	uint64_t hash = 14695981039346656037ull;
+	uint32_t keyWords[] = { CACHE_VERSION, static_cast<uint32_t>(kind), optimized };
+	hash = HashBytes(hash, keyWords, sizeof(keyWords));
+	hash = HashBytes(hash, preprocessedText.data(), preprocessedText.size());
+	char hashName[17];
+	snprintf(hashName, sizeof(hashName), "%016llx", static_cast<unsigned long long>(hash));
+	std::string cachePath = (std::filesystem::path(cacheDirectory) / (std::filesystem::path(fn).filename().string() + "." + hashName + ".spv")).string();
+
+	std::vector<char> code;
+	if (LoadCached(cachePath, code)) {
+		cacheHits++;
+		return code;
+	}
+	auto begin = std::chrono::high_resolution_clock::now();
+	shaderc::SpvCompilationResult result = GetCompiler().CompileGlslToSpv(preprocessedText, kind, fn.c_str(), options);
+	if (result.GetCompilationStatus() != shaderc_compilation_status_success) {
+		throw std::runtime_error("failed to compile shader " + fn + " :\n" + result.GetErrorMessage());
+	}
+	std::chrono::duration<double, std::micro> elapsed = std::chrono::high_resolution_clock::now() - begin;
+	compileMicroseconds += static_cast<uint64_t>(elapsed.count());
+	compiledCount++;
+	size_t size = (result.cend() - result.cbegin()) * sizeof(uint32_t);
+	code.resize(size);
+	memcpy(code.data(), result.cbegin(), size);
+	StoreCached(cachePath, code);
+	return code;
+}
+
+std::vector<std::string> ShaderCompiler::GetDependencies(const std::string& fn) {
+	std::vector<std::string> files = { fn };
+	std::lock_guard<std::mutex> lock(dependencyMutex);
+	auto it = dependencies.find(fn);
+	if (it != dependencies.end()) files.insert(files.end(), it->second.begin(), it->second.end());
+	return files;
+}
+
+std::vector<std::string> ShaderCompiler::GetSourceFiles() {
+	std::vector<std::string> files;
+	std::lock_guard<std::mutex> lock(dependencyMutex);
+	for (const auto& source : dependencies) {
+		files.push_back(source.first);
+		files.insert(files.end(), source.second.begin(), source.second.end());
+	}
+	return files;
+}
+
+bool ShaderCompiler::LoadCached(const std::string& path, std::vector<char>& outCode) const {
+	std::ifstream file(path, std::ios::ate | std::ios::binary);
+	if (!file.is_open()) return false;
+	size_t size = static_cast<size_t>(file.tellg());
+	if (size < sizeof(uint32_t) || size % sizeof(uint32_t) != 0) return false;
+	outCode.resize(size);
+	file.seekg(0);
+	file.read(outCode.data(), size);
+	uint32_t magic = 0;
+	memcpy(&magic, outCode.data(), sizeof(magic));
+	return file.good() && magic == SPIRV_MAGIC;
+}
+
+void ShaderCompiler::StoreCached(const std::string& path, const std::vector<char>& code) {
+	//two jobs may compile the same shader, they write the same bytes one after the other
+	std::lock_guard<std::mutex> lock(cacheMutex);
+	std::error_code error;
+	std::filesystem::create_directories(cacheDirectory, error);
+	std::string tempPath = path + ".tmp";
+	{
+		std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+		if (!out.is_open()) return;
+		out.write(code.data(), code.size());
+		if (!out.good()) return;
+	}
+	std::filesystem::rename(tempPath, path, error);
+	if (error) std::filesystem::remove(tempPath, error);
+}
+
+void ShaderCompiler::PrintStats() const {
+	uint32_t compiled = compiledCount.load();
+	printf("Shader compiler : %u compiled(%.2f ms on average), %u loaded from %s\n",
+		compiled, compiled > 0 ? compileMicroseconds.load() / 1000.0 / compiled : 0.0, cacheHits.load(), cacheDirectory.c_str());
+}
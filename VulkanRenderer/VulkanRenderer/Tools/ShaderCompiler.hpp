@@ -0,0 +1,48 @@
+#pragma once
+#ifndef SHADERCOMPILER_HPP
+#define SHADERCOMPILER_HPP
+#include <vector>
+#include <string>
+#include <utility>
+#include <unordered_map>
+#include <mutex>
+#include <atomic>
+#include <cstdint>
+
+// compiles glsl sources to SPIR-V in process(shaderc, the glslang front end of the Vulkan SDK).
+// a source is preprocessed first : the hash of the preprocessed text(every #include and define already expanded),
+// the stage and the compile options names the result in the cache directory, so only changed shaders compile again.
+// the stage comes from the extension : .vert .frag .comp .geom .tesc .tese
+// #include "x" is looked up next to the including file, #include <x> in the include directory.
+// thread safe, pipeline jobs compile concurrently.
+class ShaderCompiler {
+public:
+	typedef std::vector<std::pair<std::string, std::string>> Defines; // name, value
+
+	static ShaderCompiler& GetInstance();
+	void Init(const std::string& _cacheDirectory = "ShaderCache", const std::string& _includeDirectory = "");
+
+	// SPIR-V of the source file fn, in the layout FileLoader::LoadShaderfile returns. throws with the compiler log on errors
+	std::vector<char> Compile(const std::string& fn, const Defines& defines = {});
+	// fn and every file it included the last time it was compiled
+	std::vector<std::string> GetDependencies(const std::string& fn);
+	// every source and include read so far, what a ShaderWatcher should watch
+	std::vector<std::string> GetSourceFiles();
+	void PrintStats() const;
+
+private:
+	std::string cacheDirectory = "ShaderCache";
+	std::string includeDirectory;
+	std::mutex cacheMutex; // cache writes
+	std::mutex dependencyMutex;
+	std::unordered_map<std::string, std::vector<std::string>> dependencies; // [source] includes
+	std::atomic<uint32_t> cacheHits{ 0 };
+	std::atomic<uint32_t> compiledCount{ 0 };
+	std::atomic<uint64_t> compileMicroseconds{ 0 };
+
+private:
+	ShaderCompiler() {}
+	bool LoadCached(const std::string& path, std::vector<char>& outCode) const;
+	void StoreCached(const std::string& path, const std::vector<char>& code);
+};
+#endif // !SHADERCOMPILER_HPP
@@ -0,0 +1,30 @@
+#include "Tools/ShaderWatcher.hpp"
+
+void ShaderWatcher::Init(uint32_t _intervalMs) {
+	intervalMs = _intervalMs;
+	lastPoll = std::chrono::steady_clock::now();
+	writeTimes.clear();
+}
+
+bool ShaderWatcher::IsDue() const {
+	return std::chrono::steady_clock::now() - lastPoll >= std::chrono::milliseconds(intervalMs);
+}
+
+std::vector<std::string> ShaderWatcher::Poll(const std::vector<std::string>& files) {
+	lastPoll = std::chrono::steady_clock::now();
+	std::vector<std::string> changed;
+	for (const std::string& file : files) {
+		std::error_code error;
+		std::filesystem::file_time_type writeTime = std::filesystem::last_write_time(file, error);
+		if (error) continue;
+		auto it = writeTimes.find(file);
+		if (it == writeTimes.end()) {
+			writeTimes.emplace(file, writeTime);
+		}
+		else if (it->second != writeTime) {
+			it->second = writeTime;
+			changed.push_back(file);
+		}
+	}
+	return changed;
+}
@@ -0,0 +1,27 @@
+#pragma once
+#ifndef SHADERWATCHER_HPP
+#define SHADERWATCHER_HPP
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <filesystem>
+#include <chrono>
+#include <cstdint>
+
+// polls the write time of shader sources. polling a few dozen files costs microseconds
+// and behaves the same on every platform and with editors that save by replacing the file.
+class ShaderWatcher {
+public:
+	// files are looked at no more often than every intervalMs
+	void Init(uint32_t _intervalMs = 250);
+	bool IsDue() const;
+	// files whose write time changed since they were last looked at. a file seen for the first time is only remembered.
+	// files that can't be read right now(mid save) are checked again next time.
+	std::vector<std::string> Poll(const std::vector<std::string>& files);
+
+private:
+	uint32_t intervalMs = 250;
+	std::chrono::steady_clock::time_point lastPoll;
+	std::unordered_map<std::string, std::filesystem::file_time_type> writeTimes;
+};
+#endif // !SHADERWATCHER_HPP
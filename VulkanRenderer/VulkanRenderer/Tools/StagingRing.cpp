@@ -0,0 +1,155 @@
+#include "Tools/StagingRing.hpp"
+#include "Tools/Utils.hpp"
+#include <stdexcept>
+#include <algorithm>
+#include <cstring>
+
+namespace {
+	inline VkDeviceSize AlignUp(VkDeviceSize value, VkDeviceSize alignment) {
+		return alignment > 1 ? (value + alignment - 1) / alignment * alignment : value;
+	}
+	const VkDeviceSize MIN_STAGING_ALIGNMENT = 4;
+}
+
+void StagingRing::Init(VkDevice _device, MemoryAllocator& allocator, VkDeviceSize _capacity) {
+	device = _device;
+	capacity = _capacity;
+	Utils::CreateBuffer(device, allocator, capacity, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, buffer, bufferMemory);
+}
+
+void StagingRing::Destroy(MemoryAllocator& allocator) {
+	if (device == VK_NULL_HANDLE) return;
+	WaitIdle();
+	std::lock_guard<std::mutex> lock(mutex);
+	for (VkFence fence : freeFences) vkDestroyFence(device, fence, nullptr);
+	freeFences.clear();
+	Utils::DestroyBuffer(device, allocator, buffer, bufferMemory);
+	device = VK_NULL_HANDLE;
+}
+
+uint64_t StagingRing::CreateOwner() {
+	std::lock_guard<std::mutex> lock(mutex);
+	return nextOwner++;
+}
+
+bool StagingRing::Acquire(uint64_t owner, VkDeviceSize size, VkDeviceSize alignment, StagingRegion& out) {
+	if (size == 0 || size > capacity) {
+		throw std::runtime_error("staging request is larger than the staging ring!");
+	}
+	alignment = std::max(alignment, MIN_STAGING_ALIGNMENT);
+	std::unique_lock<std::mutex> lock(mutex);
+	while (true) {
+		Collect();
+		VkDeviceSize offset = UINT64_MAX;
+		if (spans.empty()) {
+			head = 0;
+			offset = 0;
+		}
+		else if (head > spans.front().begin) {
+			// live data is [front.begin, head). try the end first, then wrap around
+			VkDeviceSize candidate = AlignUp(head, alignment);
+			if (candidate + size <= capacity) offset = candidate;
+			else if (size <= spans.front().begin) offset = 0;
+		}
+		else {
+			// wrapped. live data is [front.begin, capacity) + [0, head)
+			VkDeviceSize candidate = AlignUp(head, alignment);
+			if (candidate + size <= spans.front().begin) offset = candidate;
+		}
+
+		if (offset != UINT64_MAX) {
+			spans.push_back({ offset, offset + size, 0, owner });
+			head = offset + size;
+			out.buffer = buffer;
+			out.offset = offset;
+			out.size = size;
+			out.mapped = static_cast<char*>(bufferMemory.mapped) + offset;
+			return true;
+		}
+		if (spans.front().ticket == 0) {
+			//our own oldest span is not submitted yet, nothing to wait for.
+			if (spans.front().owner == owner) return false;
+			spansSubmitted.wait(lock);
+			continue;
+		}
+		WaitLocked(lock, spans.front().ticket);
+	}
+}
+
+uint64_t StagingRing::Submit(uint64_t owner, VkQueue queue, const VkSubmitInfo& submitInfo) {
+	std::lock_guard<std::mutex> lock(mutex);
+	Submission submission;
+	submission.ticket = nextTicket++;
+	submission.fence = GetFence();
+	if (vkQueueSubmit(queue, 1, &submitInfo, submission.fence) != VK_SUCCESS) {
+		throw std::runtime_error("failed to submit upload command buffer!");
+	}
+	//spans of owners acquiring concurrently interleave, so only the ones tagged with this owner belong to the submission
+	for (Span& span : spans) {
+		if (span.ticket == 0 && span.owner == owner) span.ticket = submission.ticket;
+	}
+	submissions.push_back(submission);
+	spansSubmitted.notify_all();
+	return submission.ticket;
+}
+
+void StagingRing::Retire(Submission& submission) {
+	freeFences.push_back(submission.fence); // reset when it's reused
+	completedTicket = submission.ticket;
+}
+
+// submissions to one queue are retired in order
+void StagingRing::Collect() {
+	while (!submissions.empty() && vkGetFenceStatus(device, submissions.front().fence) == VK_SUCCESS) {
+		Retire(submissions.front());
+		submissions.pop_front();
+	}
+	while (!spans.empty() && spans.front().ticket != 0 && spans.front().ticket <= completedTicket) {
+		spans.pop_front();
+	}
+}
+
+bool StagingRing::IsComplete(uint64_t ticket) {
+	std::lock_guard<std::mutex> lock(mutex);
+	Collect();
+	return ticket <= completedTicket;
+}
+
+void StagingRing::Wait(uint64_t ticket) {
+	std::unique_lock<std::mutex> lock(mutex);
+	WaitLocked(lock, ticket);
+}
+
+void StagingRing::WaitLocked(std::unique_lock<std::mutex>& lock, uint64_t ticket) {
+	while (!submissions.empty() && submissions.front().ticket <= ticket) {
+		VkFence fence = submissions.front().fence;
+		waitingThreads++;
+		lock.unlock();
+		vkWaitForFences(device, 1, &fence, VK_TRUE, UINT64_MAX);
+		lock.lock();
+		waitingThreads--;
+		Collect();
+	}
+	Collect();
+}
+
+void StagingRing::WaitIdle() {
+	std::unique_lock<std::mutex> lock(mutex);
+	if (!submissions.empty()) WaitLocked(lock, submissions.back().ticket);
+}
+
+VkFence StagingRing::GetFence() {
+	if (!freeFences.empty() && waitingThreads == 0) {
+		VkFence fence = freeFences.back();
+		freeFences.pop_back();
+		vkResetFences(device, 1, &fence);
+		return fence;
+	}
+	VkFence fence;
+	VkFenceCreateInfo fenceInfo = Initializer::InitFenceCreateInfo(static_cast<VkFenceCreateFlagBits>(0));
+	if (vkCreateFence(device, &fenceInfo, nullptr, &fence) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create staging fence!");
+	}
+	return fence;
+}
@@ -0,0 +1,75 @@
+#pragma once
+#ifndef STAGINGRING_HPP
+#define STAGINGRING_HPP
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+#include <deque>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+#include "MemoryAllocator.hpp"
+
+struct StagingRegion {
+	VkBuffer buffer = VK_NULL_HANDLE;
+	VkDeviceSize offset = 0;
+	VkDeviceSize size = 0;
+	void* mapped = nullptr;
+};
+
+// persistently mapped host visible ring buffer that every upload streams through.
+// regions are recycled when the fence of the submission that read them is signaled.
+// commands that read the ring are recorded by UploadBatch, each batch is one owner(CreateOwner).
+// thread safe. fences are waited without holding the lock, so polling IsComplete never blocks behind a waiting loader.
+// an owner must not hold unsubmitted regions while it waits on another owner.
+class StagingRing {
+public:
+	void Init(VkDevice _device, MemoryAllocator& allocator, VkDeviceSize _capacity = 32ull * 1024 * 1024);
+	void Destroy(MemoryAllocator& allocator);
+
+	uint64_t CreateOwner();
+	// waits for in flight submissions, or for other owners to submit, if needed.
+	// returns false when the request only fits into space the owner acquired but hasn't submitted yet.
+	bool Acquire(uint64_t owner, VkDeviceSize size, VkDeviceSize alignment, StagingRegion& out);
+	// everything the owner acquired since its last Submit is read by this submission.
+	uint64_t Submit(uint64_t owner, VkQueue queue, const VkSubmitInfo& submitInfo);
+	bool IsComplete(uint64_t ticket);
+	void Wait(uint64_t ticket);
+	void WaitIdle();
+
+	VkDeviceSize GetCapacity() const { return capacity; }
+
+private:
+	struct Span {
+		VkDeviceSize begin = 0;
+		VkDeviceSize end = 0;
+		uint64_t ticket = 0; // 0 : acquired, not submitted
+		uint64_t owner = 0;
+	};
+	struct Submission {
+		uint64_t ticket = 0;
+		VkFence fence = VK_NULL_HANDLE;
+	};
+	VkDevice device = VK_NULL_HANDLE;
+	VkBuffer buffer = VK_NULL_HANDLE;
+	MemoryAllocation bufferMemory;
+	VkDeviceSize capacity = 0;
+	VkDeviceSize head = 0;
+	std::deque<Span> spans;
+	std::deque<Submission> submissions;
+	std::vector<VkFence> freeFences;
+	uint64_t nextTicket = 1;
+	uint64_t completedTicket = 0;
+	uint64_t nextOwner = 1;
+	uint32_t waitingThreads = 0; // fences can't be reset while another thread waits on them
+	std::mutex mutex;
+	std::condition_variable spansSubmitted; // an owner waits here while the oldest span belongs to another owner
+
+private:
+	void WaitLocked(std::unique_lock<std::mutex>& lock, uint64_t ticket);
+	void Collect();
+	void Retire(Submission& submission);
+	VkFence GetFence();
+};
+#endif // !STAGINGRING_HPP
@@ -0,0 +1,56 @@
+#include "Tools/UniformRing.hpp"
+#include "Tools/Utils.hpp"
+#include <stdexcept>
+#include <algorithm>
+#include <cstdio>
+
+void UniformRing::Init(VkDevice _device, VkPhysicalDevice physicalDevice, MemoryAllocator& allocator, uint32_t _frameCount, VkDeviceSize _frameSize,
+	VkBufferUsageFlags usage, const char* _name) {
+	device = _device;
+	frameCount = _frameCount;
+	name = _name;
+	alignment = 16;
+	if (usage & VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT) {
+		VkPhysicalDeviceProperties properties;
+		vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+		alignment = std::max<VkDeviceSize>(properties.limits.minUniformBufferOffsetAlignment, alignment);
+	}
+	//every frame region starts aligned, so slice offsets stay aligned
+	frameSize = (_frameSize + alignment - 1) / alignment * alignment;
+	Utils::CreateBuffer(device, allocator, frameSize * frameCount, usage,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, buffer, bufferMemory);
+	if (bufferMemory.mapped == nullptr) {
+		throw std::runtime_error("failed to map ring buffer!");
+	}
+	frameBegin = 0;
+	head = 0;
+	peakUsage = 0;
+}
+
+void UniformRing::Destroy(MemoryAllocator& allocator) {
+	if (device == VK_NULL_HANDLE) return;
+	Utils::DestroyBuffer(device, allocator, buffer, bufferMemory);
+	device = VK_NULL_HANDLE;
+}
+
+void UniformRing::BeginFrame(uint32_t frame) {
+	peakUsage = std::max(peakUsage, std::min(head.load(), frameSize));
+	frameBegin = frameSize * (frame % frameCount);
+	head = 0;
+}
+
+UniformAllocation UniformRing::Allocate(VkDeviceSize size) {
+	VkDeviceSize alignedSize = (size + alignment - 1) / alignment * alignment;
+	VkDeviceSize offset = head.fetch_add(alignedSize);
+	if (offset + alignedSize > frameSize) {
+		throw std::runtime_error("ring buffer is out of memory for this frame!");
+	}
+	UniformAllocation allocation;
+	allocation.mapped = static_cast<char*>(bufferMemory.mapped) + frameBegin + offset;
+	allocation.offset = static_cast<uint32_t>(frameBegin + offset);
+	return allocation;
+}
+
+void UniformRing::PrintStats() const {
+	printf("%s : peak %.2f / %.2f KB per frame, %u frame(s)\n", name, peakUsage / 1024.0, frameSize / 1024.0, frameCount);
+}
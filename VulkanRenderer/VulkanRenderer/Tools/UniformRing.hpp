@@ -0,0 +1,55 @@
+#pragma once
+#ifndef UNIFORMRING_HPP
+#define UNIFORMRING_HPP
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include "MemoryAllocator.hpp"
+
+struct UniformAllocation {
+	void* mapped = nullptr;
+	uint32_t offset = 0; // dynamic offset of a VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC descriptor that starts at offset 0
+};
+
+// one persistently mapped buffer split into a region per frame in flight.
+// every frame hands out aligned slices of its region linearly and forgets them on the next BeginFrame of the same frame index,
+// so per object constants need neither allocations nor descriptor writes.
+// usage other than a uniform buffer(e.g. per instance vertex data) aligns slices to 16 bytes.
+class UniformRing {
+public:
+	void Init(VkDevice _device, VkPhysicalDevice physicalDevice, MemoryAllocator& allocator, uint32_t _frameCount, VkDeviceSize _frameSize = 4ull * 1024 * 1024,
+		VkBufferUsageFlags usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, const char* _name = "Uniform ring");
+	void Destroy(MemoryAllocator& allocator);
+
+	// the gpu must be done with the previous use of frame(its in flight fence was waited).
+	void BeginFrame(uint32_t frame);
+	// thread safe. aligned to minUniformBufferOffsetAlignment. throws when the frame region is full
+	UniformAllocation Allocate(VkDeviceSize size);
+	template<typename T>
+	uint32_t Push(const T& data) {
+		UniformAllocation allocation = Allocate(sizeof(T));
+		memcpy(allocation.mapped, &data, sizeof(T));
+		return allocation.offset;
+	}
+
+	VkBuffer GetBuffer() const { return buffer; }
+	VkDeviceSize GetAlignment() const { return alignment; }
+	VkDeviceSize GetFrameSize() const { return frameSize; }
+	void PrintStats() const;
+
+private:
+	VkDevice device = VK_NULL_HANDLE;
+	VkBuffer buffer = VK_NULL_HANDLE;
+	MemoryAllocation bufferMemory;
+	VkDeviceSize alignment = 256;
+	VkDeviceSize frameSize = 0;
+	uint32_t frameCount = 0;
+	VkDeviceSize frameBegin = 0;
+	std::atomic<VkDeviceSize> head{ 0 }; // bytes used in the current frame region
+	VkDeviceSize peakUsage = 0;
+	const char* name = "Uniform ring";
+};
+#endif // !UNIFORMRING_HPP
@@ -0,0 +1,307 @@
+#include "Tools/UploadBatch.hpp"
+#include "Tools/Utils.hpp"
+#include "Renderer.h"
+#include <stdexcept>
+#include <algorithm>
+#include <cstring>
+
+UploadBatch::UploadBatch(Renderer* renderer) {
+	device = renderer->device;
+	physicalDevice = renderer->physicalDevice;
+	graphicsQueue = renderer->graphicsQueue;
+	transferQueue = renderer->transferQueue;
+	graphicsFamily = renderer->queueFamilies.graphicsFamily.value();
+	transferFamily = renderer->queueFamilies.transferFamily.value();
+	dedicatedTransfer = transferFamily != graphicsFamily;
+	//graphics families always copy at texel granularity, transfer only families may not
+	if (dedicatedTransfer) {
+		uint32_t familyCount = 0;
+		vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, nullptr);
+		std::vector<VkQueueFamilyProperties> families(familyCount);
+		vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, families.data());
+		imageGranularity = families[transferFamily].minImageTransferGranularity;
+	}
+	stagingRing = &renderer->stagingRing;
+	stagingOwner = stagingRing->CreateOwner();
+	queueMutex = &renderer->queueMutex;
+
+	graphicsPool = CreatePool(graphicsFamily);
+	transferPool = graphicsPool;
+	if (dedicatedTransfer) {
+		transferPool = CreatePool(transferFamily);
+		VkSemaphoreTypeCreateInfo typeInfo{};
+		typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+		typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+		typeInfo.initialValue = 0;
+		VkSemaphoreCreateInfo semaphoreInfo = Initializer::InitSemaphoreCreateInfo(&typeInfo);
+		if (vkCreateSemaphore(device, &semaphoreInfo, nullptr, &timeline) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create upload timeline semaphore!");
+		}
+	}
+}
+
+UploadBatch::~UploadBatch() {
+	Submit();
+	Wait();
+	// destroying a pool frees every command buffer of the batch
+	if (dedicatedTransfer) {
+		vkDestroySemaphore(device, timeline, nullptr);
+		vkDestroyCommandPool(device, transferPool, nullptr);
+	}
+	vkDestroyCommandPool(device, graphicsPool, nullptr);
+}
+
+VkCommandPool UploadBatch::CreatePool(uint32_t queueFamily) {
+	VkCommandPoolCreateInfo poolInfo{};
+	poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+	poolInfo.queueFamilyIndex = queueFamily;
+	VkCommandPool pool;
+	if (vkCreateCommandPool(device, &poolInfo, nullptr, &pool) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create upload command pool!");
+	}
+	return pool;
+}
+
+VkCommandBuffer UploadBatch::GetGraphicsCommandBuffer() {
+	if (graphicsCommandBuffer == VK_NULL_HANDLE) {
+		graphicsCommandBuffer = Utils::BeginSingleTimeCommand(device, graphicsPool);
+	}
+	return graphicsCommandBuffer;
+}
+
+VkCommandBuffer UploadBatch::GetTransferCommandBuffer() {
+	if (!dedicatedTransfer) return GetGraphicsCommandBuffer();
+	if (transferCommandBuffer == VK_NULL_HANDLE) {
+		transferCommandBuffer = Utils::BeginSingleTimeCommand(device, transferPool);
+	}
+	return transferCommandBuffer;
+}
+
+void UploadBatch::TransferOwnership(VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t mipLevels, VkPipelineStageFlags dstStage, VkAccessFlags dstAccess) {
+	VkImageMemoryBarrier barrier = Initializer::InitImageMemoryBarrier(image, oldLayout, newLayout, mipLevels, false,
+		VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_NONE, transferFamily, graphicsFamily);
+	vkCmdPipelineBarrier(GetTransferCommandBuffer(), VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+	barrier.srcAccessMask = 0;
+	barrier.dstAccessMask = dstAccess;
+	vkCmdPipelineBarrier(GetGraphicsCommandBuffer(), VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, dstStage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+}
+
+void UploadBatch::TransferOwnership(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size) {
+	VkBufferMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = 0;
+	barrier.srcQueueFamilyIndex = transferFamily;
+	barrier.dstQueueFamilyIndex = graphicsFamily;
+	barrier.buffer = buffer;
+	barrier.offset = offset;
+	barrier.size = size;
+	vkCmdPipelineBarrier(GetTransferCommandBuffer(), VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+	barrier.srcAccessMask = 0;
+	barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+	vkCmdPipelineBarrier(GetGraphicsCommandBuffer(), VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+}
+
+//when the ring is full of this batch's own data, submit what is recorded so far and let the ring recycle it.
+StagingRegion UploadBatch::AcquireStaging(VkDeviceSize size, VkDeviceSize alignment) {
+	StagingRegion region;
+	if (stagingRing->Acquire(stagingOwner, size, alignment, region)) return region;
+	Submit();
+	if (!stagingRing->Acquire(stagingOwner, size, alignment, region)) {
+		throw std::runtime_error("failed to acquire staging memory!");
+	}
+	return region;
+}
+
+void UploadBatch::UploadBuffer(const void* src, VkDeviceSize size, VkBuffer dst, VkDeviceSize dstOffset, bool concurrentSharing) {
+	const char* bytes = static_cast<const char*>(src);
+	VkDeviceSize copied = 0;
+	while (copied < size) {
+		VkDeviceSize chunkSize = std::min(size - copied, stagingRing->GetCapacity());
+		StagingRegion region = AcquireStaging(chunkSize, 4);
+		memcpy(region.mapped, bytes + copied, static_cast<size_t>(chunkSize));
+
+		VkBufferCopy copyRegion{};
+		copyRegion.srcOffset = region.offset;
+		copyRegion.dstOffset = dstOffset + copied;
+		copyRegion.size = chunkSize;
+		vkCmdCopyBuffer(GetTransferCommandBuffer(), region.buffer, dst, 1, &copyRegion);
+		copied += chunkSize;
+	}
+	if (dedicatedTransfer && !concurrentSharing) TransferOwnership(dst, dstOffset, size);
+}
+
+void UploadBatch::UploadImage(const void* src, uint32_t width, uint32_t height, uint32_t texelSize, VkImage image) {
+	const char* bytes = static_cast<const char*>(src);
+	VkDeviceSize rowPitch = static_cast<VkDeviceSize>(width) * texelSize;
+	uint32_t maxRows = static_cast<uint32_t>(std::min<VkDeviceSize>(stagingRing->GetCapacity() / rowPitch, height));
+	if (maxRows < height) {
+		//a copy that doesn't end at the image's edge must start and end on the queue's transfer granularity,
+		//(0,0,0) only allows copying whole mips
+		maxRows = imageGranularity.height == 0 ? 0 : maxRows - maxRows % imageGranularity.height;
+	}
+	if (maxRows == 0) {
+		throw std::runtime_error("image rows are larger than the staging ring!");
+	}
+	uint32_t row = 0;
+	while (row < height) {
+		uint32_t rowCount = std::min(height - row, maxRows);
+		VkDeviceSize chunkSize = rowPitch * rowCount;
+		// bufferOffset must be a multiple of 4 and of the texel size
+		StagingRegion region = AcquireStaging(chunkSize, std::max<VkDeviceSize>(texelSize, 4));
+		memcpy(region.mapped, bytes + rowPitch * row, static_cast<size_t>(chunkSize));
+
+		VkBufferImageCopy copyRegion = Initializer::InitBufferImageCopy(region.offset, 0, 0, VK_IMAGE_ASPECT_COLOR_BIT, { 0, static_cast<int32_t>(row), 0 }, { width, rowCount, 1 });
+		vkCmdCopyBufferToImage(GetTransferCommandBuffer(), region.buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copyRegion);
+		row += rowCount;
+	}
+}
+
+void UploadBatch::TransitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t mipLevels) {
+	if (newLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL) {
+		Utils::RecordImageLayoutTransition(GetTransferCommandBuffer(), image, format, oldLayout, newLayout, mipLevels);
+	}
+	else if (dedicatedTransfer && oldLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL && newLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL) {
+		TransferOwnership(image, oldLayout, newLayout, mipLevels, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+	}
+	else {
+		Utils::RecordImageLayoutTransition(GetGraphicsCommandBuffer(), image, format, oldLayout, newLayout, mipLevels);
+	}
+}
+
+void UploadBatch::GenerateMipmaps(VkImage image, VkFormat imageFormat, int32_t width, int32_t height, uint32_t mipLevels) {
+	VkFormatProperties formatProperties;
+	vkGetPhysicalDeviceFormatProperties(physicalDevice, imageFormat, &formatProperties);
+	if (!(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT)) {
+		throw std::runtime_error("texture image format dose not support linear bliting!");
+		//other way is resizing the image using stb_image_resize.
+	}
+	// blits need a graphics queue. take the uploaded image over from the transfer queue first.
+	if (dedicatedTransfer) {
+		TransferOwnership(image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, mipLevels,
+			VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT);
+	}
+	VkCommandBuffer commandBuffer = GetGraphicsCommandBuffer();
+
+	VkImageMemoryBarrier barrier = Initializer::InitImageMemoryBarrier(image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, 1);
+	int32_t mipWidth = width;
+	int32_t mipHeight = height;
+
+	for (uint32_t i = 1; i < mipLevels; i++) {
+		barrier.subresourceRange.baseMipLevel = i - 1;
+		barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+		vkCmdPipelineBarrier(
+			commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+			0, nullptr,
+			0, nullptr,
+			1, &barrier
+		);
+		VkImageBlit blit = Initializer::InitImageBlit({ 0,0,0 }, { mipWidth, mipHeight,1 }, { 0,0,0 }, { mipWidth > 1 ? mipWidth / 2 : 1, mipHeight > 1 ? mipHeight / 2 : 1 , 1 }, i - 1, i);
+		vkCmdBlitImage(commandBuffer,
+			image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+			image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			1, &blit,
+			VK_FILTER_LINEAR
+		);
+		barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+		barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		vkCmdPipelineBarrier(commandBuffer,
+			VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
+			0, nullptr,
+			0, nullptr,
+			1, &barrier
+		);
+		if (mipWidth > 1) mipWidth /= 2;
+		if (mipHeight > 1) mipHeight /= 2;
+	}
+	barrier.subresourceRange.baseMipLevel = mipLevels - 1;
+	barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	vkCmdPipelineBarrier(commandBuffer,
+		VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
+		0, nullptr,
+		0, nullptr,
+		1, &barrier
+	);
+}
+
+void UploadBatch::Submit() {
+	bool transferSubmitted = false;
+	if (dedicatedTransfer && transferCommandBuffer != VK_NULL_HANDLE) {
+		if (vkEndCommandBuffer(transferCommandBuffer) != VK_SUCCESS) {
+			throw std::runtime_error("failed to record upload command buffer!");
+		}
+		timelineValue++;
+		VkTimelineSemaphoreSubmitInfo timelineInfo{};
+		timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+		timelineInfo.signalSemaphoreValueCount = 1;
+		timelineInfo.pSignalSemaphoreValues = &timelineValue;
+		VkSubmitInfo submitInfo = Initializer::InitSubmitInfo(0, VK_NULL_HANDLE, VK_NULL_HANDLE, 1, &transferCommandBuffer, 1, &timeline);
+		submitInfo.pNext = &timelineInfo;
+		std::lock_guard<std::mutex> lock(*queueMutex);
+		lastTicket = stagingRing->Submit(stagingOwner, transferQueue, submitInfo);
+		submittedTransferCommandBuffers.push_back(transferCommandBuffer);
+		transferCommandBuffer = VK_NULL_HANDLE;
+		submitCount++;
+		transferSubmitted = true;
+	}
+	// copies into concurrent buffers need no acquire, but the graphics queue still has to wait for them once.
+	// an empty submission waiting on the timeline orders every later graphics submission after the copies.
+	if (graphicsCommandBuffer == VK_NULL_HANDLE && !transferSubmitted) return;
+	if (graphicsCommandBuffer != VK_NULL_HANDLE && !dedicatedTransfer) {
+		// nobody waits for the batch on the host before drawing, so make the copies visible to later submissions.
+		VkMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+		vkCmdPipelineBarrier(graphicsCommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+	}
+	if (graphicsCommandBuffer != VK_NULL_HANDLE && vkEndCommandBuffer(graphicsCommandBuffer) != VK_SUCCESS) {
+		throw std::runtime_error("failed to record upload command buffer!");
+	}
+	uint32_t commandBufferCount = graphicsCommandBuffer != VK_NULL_HANDLE ? 1 : 0;
+	VkSubmitInfo submitInfo = Initializer::InitSubmitInfo(0, VK_NULL_HANDLE, VK_NULL_HANDLE, commandBufferCount, &graphicsCommandBuffer, 0, VK_NULL_HANDLE);
+	// acquire barriers must execute after the matching release on the transfer queue
+	VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+	VkTimelineSemaphoreSubmitInfo timelineInfo{};
+	if (dedicatedTransfer && timelineValue > 0) {
+		timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+		timelineInfo.waitSemaphoreValueCount = 1;
+		timelineInfo.pWaitSemaphoreValues = &timelineValue;
+		submitInfo.waitSemaphoreCount = 1;
+		submitInfo.pWaitSemaphores = &timeline;
+		submitInfo.pWaitDstStageMask = &waitStage;
+		submitInfo.pNext = &timelineInfo;
+	}
+	{
+		std::lock_guard<std::mutex> lock(*queueMutex);
+		lastTicket = stagingRing->Submit(stagingOwner, graphicsQueue, submitInfo);
+	}
+	if (graphicsCommandBuffer != VK_NULL_HANDLE) submittedGraphicsCommandBuffers.push_back(graphicsCommandBuffer);
+	graphicsCommandBuffer = VK_NULL_HANDLE;
+	if (!dedicatedTransfer) submitCount++;
+}
+
+bool UploadBatch::IsComplete() {
+	return graphicsCommandBuffer == VK_NULL_HANDLE && transferCommandBuffer == VK_NULL_HANDLE && stagingRing->IsComplete(lastTicket);
+}
+
+void UploadBatch::Wait() {
+	stagingRing->Wait(lastTicket);
+	if (!submittedGraphicsCommandBuffers.empty()) {
+		vkFreeCommandBuffers(device, graphicsPool, static_cast<uint32_t>(submittedGraphicsCommandBuffers.size()), submittedGraphicsCommandBuffers.data());
+		submittedGraphicsCommandBuffers.clear();
+	}
+	if (!submittedTransferCommandBuffers.empty()) {
+		vkFreeCommandBuffers(device, transferPool, static_cast<uint32_t>(submittedTransferCommandBuffers.size()), submittedTransferCommandBuffers.data());
+		submittedTransferCommandBuffers.clear();
+	}
+}
@@ -0,0 +1,76 @@
+#pragma once
+#ifndef UPLOADBATCH_HPP
+#define UPLOADBATCH_HPP
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+#include <vector>
+#include <mutex>
+#include <cstdint>
+#include "StagingRing.hpp"
+
+class Renderer;
+
+// records copies, layout transitions and mip blits of many resources into one command buffer.
+// commands are submitted once with a fence. it is split into a few submissions only when the staging ring is full.
+// when the device has a separate transfer family, copies run on the transfer queue and
+// the resources are released to the graphics queue, which waits on a timeline semaphore before acquiring them.
+class UploadBatch {
+public:
+	explicit UploadBatch(Renderer* renderer);
+	~UploadBatch();
+	UploadBatch(const UploadBatch& rhs) = delete;
+	UploadBatch& operator=(const UploadBatch& rhs) = delete;
+
+	// concurrentSharing : dst is shared by the graphics and transfer families, no ownership transfer is recorded.
+	void UploadBuffer(const void* src, VkDeviceSize size, VkBuffer dst, VkDeviceSize dstOffset = 0, bool concurrentSharing = false);
+	// image must be in VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL.
+	// copied in row chunks that fit the staging ring, whole when the upload family only copies whole mips.
+	void UploadImage(const void* src, uint32_t width, uint32_t height, uint32_t texelSize, VkImage image);
+	void TransitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t mipLevels);
+	// every mip level ends in VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL.
+	void GenerateMipmaps(VkImage image, VkFormat imageFormat, int32_t width, int32_t height, uint32_t mipLevels);
+
+	// submit recorded commands. doesn't wait.
+	void Submit();
+	bool IsComplete();
+	void Wait();
+	uint32_t GetSubmitCount() const { return submitCount; }
+	// staging ring ticket of the last submission. everything submitted so far is done when it completes.
+	uint64_t GetLastTicket() const { return lastTicket; }
+	bool UsesTransferQueue() const { return dedicatedTransfer; }
+
+private:
+	VkDevice device = VK_NULL_HANDLE;
+	VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+	VkQueue graphicsQueue = VK_NULL_HANDLE;
+	VkQueue transferQueue = VK_NULL_HANDLE;
+	uint32_t graphicsFamily = 0;
+	uint32_t transferFamily = 0;
+	bool dedicatedTransfer = false;
+	VkExtent3D imageGranularity = { 1, 1, 1 }; // minImageTransferGranularity of the upload family, UploadImage splits rows by it
+	StagingRing* stagingRing = nullptr;
+	uint64_t stagingOwner = 0; // tags the staging regions of this batch
+	std::mutex* queueMutex = nullptr;
+
+	VkCommandPool graphicsPool = VK_NULL_HANDLE;
+	VkCommandPool transferPool = VK_NULL_HANDLE; // same as graphicsPool without a dedicated transfer queue
+	VkCommandBuffer graphicsCommandBuffer = VK_NULL_HANDLE; // recording
+	VkCommandBuffer transferCommandBuffer = VK_NULL_HANDLE; // recording
+	std::vector<VkCommandBuffer> submittedGraphicsCommandBuffers;
+	std::vector<VkCommandBuffer> submittedTransferCommandBuffers;
+	VkSemaphore timeline = VK_NULL_HANDLE; // signaled by transfer submissions, waited by graphics submissions
+	uint64_t timelineValue = 0;
+	uint64_t lastTicket = 0;
+	uint32_t submitCount = 0;
+
+private:
+	VkCommandPool CreatePool(uint32_t queueFamily);
+	VkCommandBuffer GetGraphicsCommandBuffer();
+	VkCommandBuffer GetTransferCommandBuffer();
+	StagingRegion AcquireStaging(VkDeviceSize size, VkDeviceSize alignment);
+	// release on the transfer queue + acquire on the graphics queue. layout change(if any) happens once.
+	void TransferOwnership(VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t mipLevels, VkPipelineStageFlags dstStage, VkAccessFlags dstAccess);
+	void TransferOwnership(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size);
+};
+#endif // !UPLOADBATCH_HPP
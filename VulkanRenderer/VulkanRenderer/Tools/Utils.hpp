@@ -11,7 +11,7 @@
 #include<cstring>
 #include<filesystem>
 #include<string>
-
+#include "MemoryAllocator.hpp"
 
 namespace Utils {
 
@@ -20,6 +20,7 @@ namespace Utils {
 		//supported in after c++17
 		std::optional<uint32_t> graphicsFamily; //write 2024 - 08 - 15__03:10
 		std::optional<uint32_t> presentFamily;  //write 2024 - 08 - 15__03:56
+		std::optional<uint32_t> transferFamily; // family without graphics if the device has one, graphics family otherwise
 		bool isComplete() {
 			return graphicsFamily.has_value() && presentFamily.has_value();
 		}
@@ -32,11 +33,38 @@ namespace Utils {
 	};
 
 	struct UniformBufferObject {
-		glm::mat4 model;
+		glm::mat4 model; // unused by the default shaders, the model matrix is pushed per draw
 		glm::mat4 view;
 		glm::mat4 proj;
 	};
 
+	// per draw data of the default pipelines, pushed by Mesh::Draw
+	struct DrawPushConstants {
+		glm::mat4 model;
+		uint32_t materialIndex; // material slot of Renderer::bindlessTable
+		static const VkShaderStageFlags stages = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+		static const uint32_t DRAW_FROM_INSTANCE = UINT32_MAX; // indirect draws carry a DrawData slot in firstInstance
+		static VkPushConstantRange GetRange() {
+			VkPushConstantRange range{};
+			range.stageFlags = stages;
+			range.offset = 0;
+			range.size = sizeof(DrawPushConstants);
+			return range;
+		}
+	};
+
+	// per draw record of Renderer::bindlessTable, read by indirect draws and the culling pass. same layout as the shaders
+	struct DrawData {
+		glm::mat4 transform; // node transform inside the model, the model matrix itself is pushed
+		uint32_t materialIndex;
+		uint32_t padding[3];
+	};
+
+	struct AABB {
+		glm::vec3 min = glm::vec3(0.0f);
+		glm::vec3 max = glm::vec3(0.0f);
+	};
+
 	static VKAPI_ATTR VkBool32 VKAPI_CALL debugCallback(
 		VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity,
 		VkDebugUtilsMessageTypeFlagsEXT messageType,
@@ -61,13 +89,18 @@ namespace Utils {
 	VkFormat findDepthFormat(VkPhysicalDevice physicalDevice);
 	void CreateFrameBuffer(VkFramebuffer& out, const VkDevice device, const std::vector<VkImageView>& attachments, const VkRenderPass renderpass, const VkExtent2D& swapChainExtent);
 	uint32_t findMemoryType(VkPhysicalDevice physicalDevice, uint32_t typeFilter, VkMemoryPropertyFlags properties);
-	void CreateBuffer(VkDevice device, VkPhysicalDevice physicalDevice, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory,VkSharingMode sharingMode = VK_SHARING_MODE_EXCLUSIVE, VkDeviceSize memoffset = 0);
+	void CreateBuffer(VkDevice device, MemoryAllocator& allocator, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, MemoryAllocation& bufferMemory,VkSharingMode sharingMode = VK_SHARING_MODE_EXCLUSIVE, const std::vector<uint32_t>& queueFamilyIndices = {});
+	void DestroyBuffer(VkDevice device, MemoryAllocator& allocator, VkBuffer& buffer, MemoryAllocation& bufferMemory);
 	void CopyBuffer(VkDevice device, VkCommandPool commandPool, VkQueue submitQueue, VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize _size);
-	void CreateImage(VkDevice device, VkPhysicalDevice physicalDevice, VkImage& image, VkDeviceMemory& imageMemory, VkMemoryPropertyFlags properties, VkImageCreateInfo& imageInfo, VkDeviceSize memoryOffset = 0);
+	void CreateImage(VkDevice device, MemoryAllocator& allocator, VkImage& image, MemoryAllocation& imageMemory, VkMemoryPropertyFlags properties, VkImageCreateInfo& imageInfo);
+	void DestroyImage(VkDevice device, MemoryAllocator& allocator, VkImage& image, MemoryAllocation& imageMemory);
 	VkCommandBuffer BeginSingleTimeCommand(VkDevice device, VkCommandPool commandPool);
 	void EndSingleTimeCommand(VkDevice device, VkCommandPool commandPool, VkQueue submitQueue, VkCommandBuffer commandBuffer);
 	void transitionImageLayout(VkDevice device, VkCommandPool commandPool, VkQueue submitQueue, VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout,uint32_t mipLevels);
+	void RecordImageLayoutTransition(VkCommandBuffer commandBuffer, VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t mipLevels);
 	std::string getPath(const std::string& filename);
+	// axis aligned box enclosing box after transform
+	AABB TransformAABB(const AABB& box, const glm::mat4& transform);
 }
 
 namespace Initializer {
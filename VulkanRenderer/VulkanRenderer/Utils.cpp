@@ -77,19 +77,24 @@ namespace Utils
 		vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, queueFamilies.data());
 
 		int i = 0;
+		bool transferOnly = false;
 		for (const auto& queueFamily : queueFamilies) {
-			if (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) {//write 2024 - 08 - 15__03:10
+			if (!result.graphicsFamily.has_value() && (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT)) {//write 2024 - 08 - 15__03:10
 				result.graphicsFamily = i;
 			}
 			VkBool32 presentSupport(false); //write 2024 - 08 - 15__03:56
 			vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport);
-			if (presentSupport) {
+			if (!result.presentFamily.has_value() && presentSupport) {
 				result.presentFamily = i;
 			}
-
-			if (result.isComplete()) break;
+			// prefer a pure transfer family(dma engine). a compute family without graphics is the next best.
+			if ((queueFamily.queueFlags & VK_QUEUE_TRANSFER_BIT) && !(queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) && !transferOnly) {
+				transferOnly = !(queueFamily.queueFlags & VK_QUEUE_COMPUTE_BIT);
+				result.transferFamily = i;
+			}
 			++i;
 		}
+		if (!result.transferFamily.has_value()) result.transferFamily = result.graphicsFamily;
 		return result;
 	}
 
@@ -185,19 +190,25 @@ namespace Utils
 		throw std::runtime_error("failed to find suitable memory type!");
 	}
 
-	void Utils::CreateBuffer(VkDevice device, VkPhysicalDevice physicalDevice, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory, VkSharingMode sharingMode, VkDeviceSize memoffset) {
+	void Utils::CreateBuffer(VkDevice device, MemoryAllocator& allocator, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, MemoryAllocation& bufferMemory, VkSharingMode sharingMode, const std::vector<uint32_t>& queueFamilyIndices) {
 		VkBufferCreateInfo bufferInfo = Initializer::InitBufferCreateInfo(size, usage, sharingMode);
+		if (sharingMode == VK_SHARING_MODE_CONCURRENT) {
+			bufferInfo.queueFamilyIndexCount = static_cast<uint32_t>(queueFamilyIndices.size());
+			bufferInfo.pQueueFamilyIndices = queueFamilyIndices.data();
+		}
 		if (vkCreateBuffer(device, &bufferInfo, nullptr, &buffer) != VK_SUCCESS) {
 			throw std::runtime_error("failed to create buffer!");
 		}
 		VkMemoryRequirements memRequirements;
 		vkGetBufferMemoryRequirements(device, buffer, &memRequirements);
 
-		VkMemoryAllocateInfo allocInfo = Initializer::InitMemoryAllocateInfo(memRequirements.size, findMemoryType(physicalDevice, memRequirements.memoryTypeBits, properties));
-		if (vkAllocateMemory(device, &allocInfo, nullptr, &bufferMemory) != VK_SUCCESS) {
-			throw std::runtime_error("failed to allocate vertex buffer memory!");
-		}
-		vkBindBufferMemory(device, buffer, bufferMemory, memoffset);
+		bufferMemory = allocator.Allocate(memRequirements, properties, SuballocationType::Buffer);
+		vkBindBufferMemory(device, buffer, bufferMemory.memory, bufferMemory.offset);
+	}
+	void Utils::DestroyBuffer(VkDevice device, MemoryAllocator& allocator, VkBuffer& buffer, MemoryAllocation& bufferMemory) {
+		vkDestroyBuffer(device, buffer, nullptr);
+		allocator.Free(bufferMemory);
+		buffer = VK_NULL_HANDLE;
 	}
 	void Utils::CopyBuffer(VkDevice device, VkCommandPool commandPool,VkQueue submitQueue, VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize _size) {
 		VkCommandBuffer commandBuffer = BeginSingleTimeCommand(device, commandPool);
@@ -208,18 +219,21 @@ namespace Utils
 		EndSingleTimeCommand(device, commandPool, submitQueue, commandBuffer);
 
 	}
-	void Utils::CreateImage(VkDevice device, VkPhysicalDevice physicalDevice, VkImage& image, VkDeviceMemory& imageMemory, VkMemoryPropertyFlags properties, VkImageCreateInfo& imageInfo, VkDeviceSize memoryOffset) {
+	void Utils::CreateImage(VkDevice device, MemoryAllocator& allocator, VkImage& image, MemoryAllocation& imageMemory, VkMemoryPropertyFlags properties, VkImageCreateInfo& imageInfo) {
 		if (vkCreateImage(device, &imageInfo, nullptr, &image) != VK_SUCCESS) {
 			throw std::runtime_error("failed to create image!");
 		}
 		VkMemoryRequirements memRequirements;
 		vkGetImageMemoryRequirements(device, image, &memRequirements);
 
-		VkMemoryAllocateInfo allocInfo = Initializer::InitMemoryAllocateInfo(memRequirements.size, findMemoryType(physicalDevice, memRequirements.memoryTypeBits, properties));
-		if (vkAllocateMemory(device, &allocInfo, nullptr, &imageMemory) != VK_SUCCESS) {
-			throw std::runtime_error("failed to allocate Image memory!");
-		}
-		vkBindImageMemory(device, image, imageMemory, memoryOffset);
+		SuballocationType type = imageInfo.tiling == VK_IMAGE_TILING_OPTIMAL ? SuballocationType::ImageOptimal : SuballocationType::ImageLinear;
+		imageMemory = allocator.Allocate(memRequirements, properties, type);
+		vkBindImageMemory(device, image, imageMemory.memory, imageMemory.offset);
+	}
+	void Utils::DestroyImage(VkDevice device, MemoryAllocator& allocator, VkImage& image, MemoryAllocation& imageMemory) {
+		vkDestroyImage(device, image, nullptr);
+		allocator.Free(imageMemory);
+		image = VK_NULL_HANDLE;
 	}
 	VkCommandBuffer Utils::BeginSingleTimeCommand(VkDevice device, VkCommandPool commandPool) {
 		VkCommandBufferAllocateInfo allocInfo = Initializer::InitCommandBufferAllocateInfo(commandPool, 1);
@@ -242,6 +256,10 @@ namespace Utils
 	}
 	void Utils::transitionImageLayout(VkDevice device, VkCommandPool commandPool,VkQueue submitQueue, VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t mipLevels) {
 		VkCommandBuffer commandBuffer = BeginSingleTimeCommand(device,commandPool);
+		RecordImageLayoutTransition(commandBuffer, image, format, oldLayout, newLayout, mipLevels);
+		EndSingleTimeCommand(device, commandPool, submitQueue, commandBuffer);
+	}
+	void Utils::RecordImageLayoutTransition(VkCommandBuffer commandBuffer, VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t mipLevels) {
 		bool hasStencilComponent = format == VK_FORMAT_D32_SFLOAT_S8_UINT || format == VK_FORMAT_D24_UNORM_S8_UINT ? true : false;
 		VkImageMemoryBarrier barrier = Initializer::InitImageMemoryBarrier(image,oldLayout,newLayout,mipLevels,hasStencilComponent);
 		VkPipelineStageFlagBits sourceStage;
@@ -275,7 +293,6 @@ namespace Utils
 			0, nullptr,
 			1, &barrier
 		);
-		EndSingleTimeCommand(device, commandPool, submitQueue, commandBuffer);
 	}
 
 	std::string Utils::getPath(const std::string& filename) {
@@ -284,13 +301,22 @@ namespace Utils
 		if (slashPos == filename.length() - 1) return filename;
 		return filename.substr(0, slashPos + 1);
 	}
+
+	Utils::AABB Utils::TransformAABB(const AABB& box, const glm::mat4& transform) {
+		//the extent of the transformed box is |rotation * scale| * extent
+		glm::vec3 center = glm::vec3(transform * glm::vec4((box.min + box.max) * 0.5f, 1.0f));
+		glm::vec3 extent = (box.max - box.min) * 0.5f;
+		glm::mat3 absolute = glm::mat3(glm::abs(glm::vec3(transform[0])), glm::abs(glm::vec3(transform[1])), glm::abs(glm::vec3(transform[2])));
+		glm::vec3 newExtent = absolute * extent;
+		return AABB{ center - newExtent, center + newExtent };
+	}
 }
 
 namespace Initializer {
 	VkSemaphoreCreateInfo Initializer::InitSemaphoreCreateInfo(void* next, VkSemaphoreCreateFlags flag) {
 		VkSemaphoreCreateInfo semaphoreInfo{};
 		semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
-		semaphoreInfo.pNext = NULL;
+		semaphoreInfo.pNext = next;
 		semaphoreInfo.flags = flag;
 		return semaphoreInfo;
 	}
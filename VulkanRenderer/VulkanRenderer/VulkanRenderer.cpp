@@ -2,16 +2,32 @@
 #include<GLFW/glfw3.h>
 #include <iostream>
 #include <array>
+#include <cmath>
+#include <algorithm>
 #include "Renderer.h"
 #include "Tools/Utils.hpp"
 #include <glm/gtc/matrix_transform.hpp>
 #include "Model/Model.hpp"
+#include "Tools/RenderThread.hpp"
 
 const uint32_t WIDTH = 800;
 const uint32_t HEIGHT = 600;
 
-Model model;
+// everything drawFunc reads from the simulation, built once per frame and never changed after it's handed to the renderer
+struct FrameSnapshot {
+	Utils::UniformBufferObject ubo{};
+	glm::mat4 modelMatrix = glm::mat4(1.0f);
+	std::vector<InstanceData> instances;
+};
+
+Model model; // render side : meshes, scene graph and GPU buffers are only touched by the thread that renders
+FrameSnapshot frame; // the snapshot drawFunc draws
+//simulation state
+glm::mat4 modelMatrix(1.0f);
 Utils::UniformBufferObject ubo{};
+std::vector<InstanceData> instances; // --instances N : the model N times in a grid, one instanced draw per mesh
+bool parallelRecording = false; // --parallel-recording : per mesh draws recorded on every core instead of one indirect draw
+bool renderOnThread = false; // --render-thread : Renderer::Render runs on its own thread, the main thread simulates and polls events
 
 #pragma region Renderer custom function
 
@@ -44,47 +60,114 @@ void drawFunc(VkCommandBuffer commandBuffer, VkFramebuffer framebuffer, uint32_t
 	std::array<VkClearValue, 2> clearValues{};
 	clearValues[0].color = { {0.0f, 0.0f, 0.0f, 1.0f} };
 	clearValues[1].depthStencil = {1.0f, 0};
+	//transform updates and culling are transfer/compute work, record them before the render pass
+	model.UpdateTransforms(commandBuffer);
+	if (renderer->SupportsGpuCulling()) model.Cull(commandBuffer, frame.ubo.proj * frame.ubo.view, frame.modelMatrix);
 	VkRenderPassBeginInfo renderPassInfo = 
 		Initializer::InitRenderPassBeginInfo(renderer->GetRenderPass(), framebuffer, { 0,0 }, swapChainExtent, static_cast<uint32_t>(clearValues.size()), clearValues.data());
-	vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
-	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, renderer->GetPipeline());
-	
-	VkViewport viewport = Initializer::InitViewport(0.0f, 0.0f, static_cast<float>(swapChainExtent.width), static_cast<float>(swapChainExtent.height), 0.0f, 1.0f);
-	vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
-	
-	VkRect2D scissor = Initializer::InitScissor({ 0,0 }, swapChainExtent);
-	vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+	//secondary buffers inherit no state, every recording thread sets the pipeline and dynamic state again
+	//the instanced pipeline compiles in the background, the model is drawn once the usual way until it's ready
+	VkPipeline instancedPipeline = frame.instances.empty() ? VK_NULL_HANDLE : renderer->GetInstancedPipeline();
+	bool recordInParallel = parallelRecording && renderer->IsBindless() && instancedPipeline == VK_NULL_HANDLE;
+	auto bindFrameState = [&](VkCommandBuffer cb) {
+		vkCmdBindPipeline(cb, VK_PIPELINE_BIND_POINT_GRAPHICS, renderer->GetPipeline());
+
+		VkViewport viewport = Initializer::InitViewport(0.0f, 0.0f, static_cast<float>(swapChainExtent.width), static_cast<float>(swapChainExtent.height), 0.0f, 1.0f);
+		vkCmdSetViewport(cb, 0, 1, &viewport);
+
+		VkRect2D scissor = Initializer::InitScissor({ 0,0 }, swapChainExtent);
+		vkCmdSetScissor(cb, 0, 1, &scissor);
+	};
+	vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, recordInParallel ? VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS : VK_SUBPASS_CONTENTS_INLINE);
+	if (!recordInParallel) bindFrameState(commandBuffer);
 	
 	//Write here
-	std::vector<VkWriteDescriptorSet> descriptorWrites;
-	descriptorWrites.emplace_back();
-	VkDescriptorBufferInfo bufferInfo = Initializer::InitDescriptorBufferInfo(renderer->GetUniformBuffer(currentFrame), sizeof(Utils::UniformBufferObject));
-	descriptorWrites[0] = Initializer::InitWriteDescriptorSet(renderer->GetDescriptorSet(currentFrame), 0, 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1, &bufferInfo);
-	descriptorWrites.emplace_back();
-	for (auto& mesh : model.meshes) {
-		if (mesh.material.diffTexIdx >= 0) {
-			int diffIdx = mesh.material.diffTexIdx;
-			int binding = descriptorWrites.size() - 1;
-			//mesh에서 texturebind함수 만들어서 
-			VkDescriptorImageInfo imageInfo = Initializer::InitDescriptorImageInfo(VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, model.GetTextureView(diffIdx), renderer->GetDefaultSampler());
-			descriptorWrites[binding] = Initializer::InitWriteDescriptorSet(renderer->GetDescriptorSet(currentFrame), binding, 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, nullptr, &imageInfo);
+	uint32_t uboOffset = renderer->UpdateUniformBuffer(frame.ubo);
+	if (recordInParallel) {
+		//the visible meshes are split into one contiguous chunk per thread
+		const std::vector<uint32_t>& visibleMeshes = model.CullMeshes(frame.ubo.proj * frame.ubo.view, frame.modelMatrix);
+		renderer->parallelRecorder.Record(commandBuffer, renderer->GetRenderPass(), framebuffer, static_cast<uint32_t>(visibleMeshes.size()),
+			[&](VkCommandBuffer secondary, uint32_t first, uint32_t last) {
+			bindFrameState(secondary);
+			VkDescriptorSet descriptorSets[] = { renderer->GetDescriptorSet(currentFrame), renderer->bindlessTable.GetDescriptorSet() };
+			vkCmdBindDescriptorSets(secondary, VK_PIPELINE_BIND_POINT_GRAPHICS, renderer->GetPipelineLayout(), 0, 2, descriptorSets, 1, &uboOffset);
+			renderer->geometryPool.Bind(secondary);
+			VkPipeline boundPipeline = VK_NULL_HANDLE;
+			for (uint32_t i = first; i < last; i++) {
+				uint32_t meshIdx = visibleMeshes[i];
+				model.BindMeshPipeline(secondary, meshIdx, boundPipeline);
+				model.meshes[meshIdx].Draw(secondary, renderer->GetPipelineLayout(), model.GetMeshMatrix(meshIdx, frame.modelMatrix));
+			}
+		});
+	}
+	else if (renderer->IsBindless()) {
+		//every material and texture is already in the bindless set, bind once and draw
+		VkDescriptorSet descriptorSets[] = { renderer->GetDescriptorSet(currentFrame), renderer->bindlessTable.GetDescriptorSet() };
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, renderer->GetPipelineLayout(), 0, 2, descriptorSets, 1, &uboOffset);
+		if (instancedPipeline != VK_NULL_HANDLE) {
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, instancedPipeline);
+			model.DrawInstanced(commandBuffer, renderer->GetInstancedPipelineLayout(), frame.modelMatrix, frame.instances.data(), static_cast<uint32_t>(frame.instances.size()));
+		}
+		else if (renderer->SupportsIndirectDraw()) model.DrawIndirect(commandBuffer, renderer->GetPipelineLayout(), frame.modelMatrix);
+		else model.Draw(commandBuffer, renderer->GetPipelineLayout(), frame.modelMatrix, frame.ubo.proj * frame.ubo.view);
+	}
+	else {
+		renderer->geometryPool.Bind(commandBuffer); // every mesh lives in the shared vertex/index buffers
+		VkPipeline boundPipeline = VK_NULL_HANDLE;
+		for (uint32_t meshIdx : model.CullMeshes(frame.ubo.proj * frame.ubo.view, frame.modelMatrix)) {
+			Mesh& mesh = model.meshes[meshIdx];
+			model.BindMeshPipeline(commandBuffer, meshIdx, boundPipeline);
+			VkDescriptorSet descriptorSet = renderer->GetDescriptorSet(currentFrame);
+			if (mesh.material.diffTexIdx >= 0) {
+				int diffIdx = mesh.material.diffTexIdx;
+				//mesh에서 texturebind함수 만들어서 
+				VkDescriptorImageInfo imageInfo = Initializer::InitDescriptorImageInfo(VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, model.GetTextureView(diffIdx), renderer->GetDefaultSampler());
+				VkWriteDescriptorSet descriptorWrite = Initializer::InitWriteDescriptorSet(descriptorSet, 1, 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, nullptr, &imageInfo);
+				vkUpdateDescriptorSets(renderer->device, 1, &descriptorWrite, 0, nullptr);
+			}
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, renderer->GetPipelineLayout(), 0, 1, &descriptorSet, 1, &uboOffset);
+			mesh.Draw(commandBuffer, renderer->GetPipelineLayout(), model.GetMeshMatrix(meshIdx, frame.modelMatrix));
 		}
-		VkDescriptorSet descriptorSet = renderer->GetDescriptorSet(currentFrame);
-		vkUpdateDescriptorSets(renderer->device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
-		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, renderer->GetPipelineLayout(), 0, 1, &descriptorSet, 0, nullptr);
-		mesh.Draw(commandBuffer);
 	}
 	//
 	
 	vkCmdEndRenderPass(commandBuffer);
+	if (renderer->SupportsGpuCulling()) renderer->hiZ.Build(commandBuffer); // read by next frame's culling
 	if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
 		throw std::runtime_error("failed to record command buffer!");
 	}
 }
 #pragma endregion
 
-int main()
+FrameSnapshot BuildSnapshot() {
+	FrameSnapshot snapshot;
+	snapshot.ubo = ubo;
+	snapshot.modelMatrix = modelMatrix;
+	snapshot.instances = instances;
+	return snapshot;
+}
+
+void RenderSnapshot(FrameSnapshot& snapshot) {
+	Renderer* renderer = Renderer::GetInstance();
+	frame = std::move(snapshot);
+	model.PollLoadedMeshes();
+	renderer->Render();
+}
+
+int main(int argc, char** argv)
 {
+	if (argc > 1 && strcmp(argv[1], "--bench-culling") == 0) {
+		FrustumCuller::RunBenchmark();
+		return 0;
+	}
+	if (argc > 1 && strcmp(argv[1], "--bench-jobs") == 0) {
+		JobSystem::RunBenchmark();
+		return 0;
+	}
+	if (argc > 1 && strcmp(argv[1], "--bench-scene") == 0) {
+		SceneGraph::RunBenchmark();
+		return 0;
+	}
 	if (!glfwInit()) {
 		printf("Fail glfwInit\n");
 		exit(EXIT_FAILURE);
@@ -101,19 +184,63 @@ int main()
 	funcs.checkSwapSurfaceFormatFunc = CheckSwapSurfaceSupport;
 	funcs.checkSwapPresentModeFunc = CheckSwapPresentMode;
 	funcs.renderFunc = drawFunc;
+	funcs.enableBindless = true;
+	funcs.enableGpuCulling = true;
+	funcs.enableShaderHotReload = true;
+	funcs.enableInstancing = argc > 2 && strcmp(argv[1], "--instances") == 0;
 	Renderer* renderer = Renderer::GetInstance(window, &funcs);
-	model.LoadModel(renderer, "Assets/Camera_01_4k.gltf/Camera_01_4k.gltf");
-	ubo.model = glm::scale(glm::mat4(1.0f), glm::vec3(10.0f));
+	if (argc > 1 && strcmp(argv[1], "--parallel-recording") == 0) {
+		parallelRecording = true;
+		printf("Recording draws as jobs on %u thread(s)\n", renderer->parallelRecorder.GetThreadCount());
+	}
+	if (argc > 1 && strcmp(argv[1], "--render-thread") == 0) {
+		renderOnThread = true;
+		printf("Rendering on a separate thread\n");
+	}
+	if (argc > 2 && strcmp(argv[1], "--instances") == 0) {
+		//instanced draws don't bind per mesh textures, so the demo needs bindless materials
+		if (renderer->IsBindless()) {
+			uint32_t count = static_cast<uint32_t>(std::max(atoi(argv[2]), 0));
+			uint32_t side = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<float>(count))));
+			const float spacing = 0.5f;
+			instances.resize(count);
+			for (uint32_t i = 0; i < count; i++) {
+				glm::vec3 offset((i % side - side * 0.5f) * spacing, (i / side - side * 0.5f) * spacing, 0.0f);
+				instances[i].transform = glm::translate(glm::mat4(1.0f), offset);
+			}
+			printf("Drawing %u instance(s) of the model\n", count);
+		}
+		else printf("--instances needs bindless materials, drawing one model\n");
+	}
+	model.LoadModelAsync(renderer, "Assets/Camera_01_4k.gltf/Camera_01_4k.gltf");
+	modelMatrix = glm::scale(glm::mat4(1.0f), glm::vec3(10.0f));
+	ubo.model = modelMatrix;
 	ubo.view = glm::lookAt(glm::vec3(2.0f, 2.0f, 2.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
 	ubo.proj = glm::perspective(glm::radians(45.0f), WIDTH / (float)HEIGHT, 0.1f, 10.0f);
 	ubo.proj[1][1] = -1;
-	renderer->UpdateUniformBuffer(0, ubo);
-	renderer->UpdateUniformBuffer(1, ubo);
 
-	while (!glfwWindowShouldClose(window)) {
-		glfwPollEvents();
-		renderer->Render();
+	if (renderOnThread) {
+		//GLFW stays on the main thread. while the queue is full it keeps running main thread jobs,
+		//the render thread may be waiting on them
+		RenderThread<FrameSnapshot> renderThread;
+		renderThread.Start(RenderSnapshot, 2);
+		while (!glfwWindowShouldClose(window) && renderThread.IsRunning()) {
+			glfwPollEvents();
+			renderer->jobSystem.RunMainThreadJobs();
+			renderThread.Submit(BuildSnapshot(), [renderer]() { renderer->jobSystem.RunMainThreadJobs(); });
+		}
+		renderThread.Stop();
+	}
+	else {
+		while (!glfwWindowShouldClose(window)) {
+			glfwPollEvents();
+			renderer->jobSystem.RunMainThreadJobs();
+			FrameSnapshot snapshot = BuildSnapshot();
+			RenderSnapshot(snapshot);
+		}
 	}
+	model.WaitForLoad();
+	model.Destroy();
 	renderer->Clean();
 	glfwDestroyWindow(window);
 	glfwTerminate();